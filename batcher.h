@@ -0,0 +1,185 @@
+#ifndef BATCHER_H
+#define BATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Collects items and hands them to a flush function in groups.
+//
+// A group is flushed when it reaches max_items, or max_delay after its first
+// item arrived, whichever comes first; with idle set, max_delay counts from
+// the latest item instead, so a burst is collected until it pauses. Flushes
+// run on the batcher's own thread; items added after stop() are flushed one
+// by one on the caller.
+template <typename Item>
+class Batcher {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(std::vector<Item>&&)> FlushFn;
+
+    Batcher(size_t max_items, std::chrono::milliseconds max_delay, FlushFn flush, bool idle = false)
+        : max_items_(max_items > 0 ? max_items : 1), max_delay_(max_delay), idle_(idle),
+          flush_(std::move(flush)) {
+    }
+
+    ~Batcher() {
+        stop();
+    }
+
+    Batcher(const Batcher&) = delete;
+    Batcher& operator=(const Batcher&) = delete;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            stopping_ = false;
+            thread_ = std::thread(&Batcher::run, this);
+        }
+    }
+
+    void add(Item&& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopping_ || !thread_.joinable()) {
+            lock.unlock();
+            std::vector<Item> single;
+            single.push_back(std::move(item));
+            flushGroup(std::move(single));
+            return;
+        }
+
+        if (items_.empty() || idle_) {
+            last_ = Clock::now();
+            if (items_.empty()) {
+                first_ = last_;
+            }
+        }
+        items_.push_back(std::move(item));
+        // The thread only needs waking to arm the timer or to flush a full group.
+        bool wake = items_.size() == 1 || items_.size() >= max_items_;
+        lock.unlock();
+        if (wake) {
+            cv_.notify_one();
+        }
+    }
+
+    // Take the collected items pred selects back out, so they are never flushed
+    template <typename Pred>
+    std::vector<Item> take(Pred pred) {
+        std::vector<Item> taken;
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t kept = 0;
+        for (size_t i = 0; i < items_.size(); ++i) {
+            if (pred(static_cast<const Item&>(items_[i]))) {
+                taken.push_back(std::move(items_[i]));
+            } else if (kept++ != i) {
+                items_[kept - 1] = std::move(items_[i]);
+            }
+        }
+        items_.resize(kept);
+        return taken;
+    }
+
+    // Stop the thread and flush whatever is still collected
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        std::vector<Item> rest;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rest.swap(items_);
+        }
+        while (!rest.empty()) {
+            std::vector<Item> group;
+            size_t n = rest.size() < max_items_ ? rest.size() : max_items_;
+            for (size_t i = 0; i < n; ++i) {
+                group.push_back(std::move(rest[i]));
+            }
+            rest.erase(rest.begin(), rest.begin() + n);
+            flushGroup(std::move(group));
+        }
+    }
+
+    uint64_t batches() const { return batches_.load(std::memory_order_relaxed); }
+    uint64_t items() const { return flushed_items_.load(std::memory_order_relaxed); }
+
+private:
+    void flushGroup(std::vector<Item>&& group) {
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        flushed_items_.fetch_add(group.size(), std::memory_order_relaxed);
+        try {
+            flush_(std::move(group));
+        } catch (...) {
+            // A failing flush must not take the batcher thread down.
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return stopping_ || !items_.empty(); });
+            if (stopping_) {
+                return;
+            }
+
+            // An idle deadline moves with every item, so it is re-read after each wakeup.
+            while (!stopping_ && items_.size() < max_items_) {
+                Clock::time_point deadline = (idle_ ? last_ : first_) + max_delay_;
+                if (Clock::now() >= deadline) {
+                    break;
+                }
+                cv_.wait_until(lock, deadline);
+            }
+            if (stopping_) {
+                return;
+            }
+
+            std::vector<Item> group;
+            if (items_.size() <= max_items_) {
+                group.swap(items_);
+            } else {
+                for (size_t i = 0; i < max_items_; ++i) {
+                    group.push_back(std::move(items_[i]));
+                }
+                items_.erase(items_.begin(), items_.begin() + max_items_);
+                first_ = last_ = Clock::now();
+            }
+
+            lock.unlock();
+            flushGroup(std::move(group));
+            lock.lock();
+        }
+    }
+
+    const size_t max_items_;
+    const std::chrono::milliseconds max_delay_;
+    const bool idle_;
+    FlushFn flush_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Item> items_;
+    Clock::time_point first_;
+    Clock::time_point last_;         // Latest item, when idle_
+    std::thread thread_;
+    bool stopping_{false};
+
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> flushed_items_{0};
+};
+
+#endif // BATCHER_H
@@ -0,0 +1,177 @@
+// Measures the callout side of the dispatch queue: the cost of one enqueue()
+// while many packet threads enqueue at once, with and without the intake ring.
+//
+// Build with -DPD_WEBHOOK_BUILD_BENCH=ON and run ./dispatch_queue_bench [options]:
+//   --threads N    Producer (packet) threads (default 16)
+//   --events N     Events per producer, each for its own prefix (default 2000)
+//   --senders N    Sender threads; delivery itself is a no-op (default 2)
+//   --ring N       Intake ring size, 0 for the locked queue only (default 8192)
+//
+// Each producer builds its events up front and times the enqueue() loop, so
+// the figures cover the handoff alone. Heap allocations are counted on the
+// producer threads while they enqueue.
+
+#include "dispatch_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+static thread_local bool t_counting = false;
+static std::atomic<unsigned long long> g_allocations{0};
+
+void*
+operator new(std::size_t size) {
+    if (t_counting) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct BenchConfig {
+    unsigned threads{16};
+    unsigned events{2000};
+    unsigned senders{2};
+    size_t ring{8192};
+};
+
+static BenchConfig
+parseArgs(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "usage: %s [--threads N] [--events N] [--senders N] [--ring N]\n", argv[0]);
+            std::exit(2);
+        }
+        unsigned long value = std::strtoul(argv[++i], nullptr, 10);
+        if (arg == "--threads") {
+            cfg.threads = static_cast<unsigned>(value > 0 ? value : 1);
+        } else if (arg == "--events") {
+            cfg.events = static_cast<unsigned>(value > 0 ? value : 1);
+        } else if (arg == "--senders") {
+            cfg.senders = static_cast<unsigned>(value > 0 ? value : 1);
+        } else if (arg == "--ring") {
+            cfg.ring = value;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            std::exit(2);
+        }
+    }
+    return cfg;
+}
+
+// Assignment for a /56 numbered by thread and index
+static PdEvent
+makeEvent(unsigned thread, unsigned index) {
+    PdEvent ev;
+    ev.type = PdEventType::ASSIGNED;
+    ev.msg_type = 3;
+    ev.reply_type = 7;
+    Duid::fromHex("000100012b3c4d5e001122334455", ev.data.client_duid);
+    ev.data.prefix.addr[0] = 0x20;
+    ev.data.prefix.addr[1] = 0x01;
+    ev.data.prefix.addr[2] = 0x0d;
+    ev.data.prefix.addr[3] = 0xb8;
+    ev.data.prefix.addr[4] = static_cast<uint8_t>(thread);
+    ev.data.prefix.addr[5] = static_cast<uint8_t>(index >> 8);
+    ev.data.prefix.addr[6] = static_cast<uint8_t>(index);
+    ev.data.prefix.length = 56;
+    ev.data.iaid = index;
+    ev.valid_lft = 7200;
+    ev.preferred_lft = 3600;
+    return ev;
+}
+
+int
+main(int argc, char** argv) {
+    BenchConfig cfg = parseArgs(argc, argv);
+    size_t total = static_cast<size_t>(cfg.threads) * cfg.events;
+
+    std::atomic<size_t> delivered{0};
+    PrefixTable table(total);
+    DispatchQueue queue(table, total, cfg.senders, DispatchQueue::OverflowPolicy::DROP_NEWEST,
+                        [&delivered](const PdEvent&, DispatchQueue::Completion done) {
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        done();
+    }, cfg.ring);
+    queue.start();
+
+    std::vector<double> enqueue_ns(cfg.threads);
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> producers;
+    for (unsigned t = 0; t < cfg.threads; ++t) {
+        producers.emplace_back([&, t] {
+            std::vector<PdEvent> events;
+            events.reserve(cfg.events);
+            for (unsigned i = 0; i < cfg.events; ++i) {
+                events.push_back(makeEvent(t, i));
+            }
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+
+            t_counting = true;
+            auto start = std::chrono::steady_clock::now();
+            for (PdEvent& ev : events) {
+                queue.enqueue(std::move(ev));
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            t_counting = false;
+            enqueue_ns[t] = std::chrono::duration<double, std::nano>(elapsed).count() / cfg.events;
+        });
+    }
+    while (ready.load() < cfg.threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (delivered.load() < total && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double mean = 0.0;
+    double worst = 0.0;
+    for (double ns : enqueue_ns) {
+        mean += ns / cfg.threads;
+        worst = ns > worst ? ns : worst;
+    }
+    DispatchQueue::Stats stats = queue.getStats();
+    std::printf("producers=%u events/producer=%u senders=%u ring=%zu\n", cfg.threads, cfg.events, cfg.senders,
+                cfg.ring);
+    std::printf("enqueue              %.1f ns mean per event, %.1f ns slowest producer, %.2f allocs/event\n",
+                mean, worst, static_cast<double>(g_allocations.load()) / total);
+    std::printf("delivery             %zu/%zu events in %.3fs, %.0f events/s\n", delivered.load(), total, secs,
+                delivered.load() / secs);
+    std::printf("queue                intake_batches=%llu ring_full=%llu dropped=%llu\n",
+                static_cast<unsigned long long>(stats.intake_batches),
+                static_cast<unsigned long long>(stats.ring_full),
+                static_cast<unsigned long long>(stats.dropped_newest + stats.dropped_oldest + stats.shed));
+    queue.stop();
+    return delivered.load() == total ? 0 : 1;
+}
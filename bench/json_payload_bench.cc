@@ -0,0 +1,124 @@
+// Compares the fast payload encoder with the jsoncpp fallback.
+//
+// Build with -DPD_WEBHOOK_BUILD_BENCH=ON and run ./json_payload_bench [iterations].
+// For every payload shape it checks that both encoders produce the same bytes
+// and reports the time and heap allocations per payload.
+
+#include "pd_payload.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<unsigned long long> g_allocations{0};
+
+void*
+operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+static PdEvent
+sampleEvent() {
+    PdEvent ev;
+    ev.type = PdEventType::ASSIGNED;
+    ev.msg_type = 3;
+    ev.reply_type = 7;
+    Duid::fromHex("000100012b3c4d5e001122334455", ev.data.client_duid);
+    PrefixKey::fromText("2001:db8:1200:3400::", 56, ev.data.prefix);
+    ev.data.iaid = 3735928559u;
+    Ip6Address::fromText("fe80::211:22ff:fe33:4455", ev.data.cpe_link_local);
+    Ip6Address::fromText("2001:db8:ffff::2", ev.data.router_ip);
+    Ip6Address::fromText("2001:db8:ffff::1", ev.data.router_link_addr);
+    Ip6Address::fromText("fe80::211:22ff:fe33:4455", ev.peer_addr);
+    ev.subnet_id = 42;
+    ev.valid_lft = 7200;
+    ev.preferred_lft = 3600;
+    ev.cltt = 1760000000;
+    return ev;
+}
+
+static void
+run(const char* name, size_t iterations, const std::function<std::string(JsonEncoder)>& build) {
+    std::string fast = build(JsonEncoder::FAST);
+    std::string reference = build(JsonEncoder::JSONCPP);
+    if (fast != reference) {
+        std::printf("%-16s MISMATCH\n  fast:    %s\n  jsoncpp: %s\n", name, fast.c_str(), reference.c_str());
+        std::exit(1);
+    }
+
+    const JsonEncoder encoders[] = {JsonEncoder::FAST, JsonEncoder::JSONCPP};
+    const char* labels[] = {"fast", "jsoncpp"};
+    for (int e = 0; e < 2; ++e) {
+        size_t bytes = 0;
+        unsigned long long allocs_before = g_allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            bytes += build(encoders[e]).size();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        unsigned long long allocs = g_allocations.load() - allocs_before;
+
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        std::printf("%-16s %-8s %8.1f ns/op %6.2f allocs/op %5zu bytes\n", name, labels[e], ns,
+                    static_cast<double>(allocs) / iterations, bytes / iterations);
+    }
+}
+
+int
+main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const PdEvent ev = sampleEvent();
+    run("pd_assigned", iterations, [&ev](JsonEncoder encoder) { return buildAssignedPayload(ev, encoder); });
+    run("pd_assigned min", iterations, [&ev](JsonEncoder encoder) {
+        return buildAssignedPayload(ev, encoder, WF_PREFIX | WF_PREFIX_LENGTH | WF_DUID);
+    });
+    run("pd_assigned none", iterations, [&ev](JsonEncoder encoder) { return buildAssignedPayload(ev, encoder, 0); });
+    const std::vector<PdEvent> packet(2, ev);
+    run("pd_assigned x2", iterations, [&packet, &ev](JsonEncoder encoder) {
+        return buildAssignedPayload(packet, ev.cltt, encoder);
+    });
+    run("pd_expired", iterations, [&ev](JsonEncoder encoder) { return buildExpiredPayload(ev, encoder); });
+    const std::vector<PdEvent> sweep(100, ev);
+    run("pd_expired_batch", iterations / 100 + 1, [&sweep](JsonEncoder encoder) {
+        return buildExpiredBatchPayload(sweep, encoder);
+    });
+    run("prefix create", iterations, [&ev](JsonEncoder encoder) {
+        return buildPrefixObject(ev.data, "active", ev.cltt + ev.valid_lft, true, encoder);
+    });
+    run("prefix update", iterations, [&ev](JsonEncoder encoder) {
+        return buildPrefixObject(ev.data, "active", ev.cltt + ev.valid_lft, false, encoder);
+    });
+    run("prefix min", iterations, [&ev](JsonEncoder encoder) {
+        return buildPrefixObject(ev.data, "active", ev.cltt + ev.valid_lft, true, encoder, 0);
+    });
+    run("lease object", iterations, [&ev](JsonEncoder encoder) {
+        return buildPrefixObject(ev.data, "active", ev.cltt + ev.valid_lft, true, encoder, NF_ALL & ~NF_RELAY);
+    });
+    run("prefix status", iterations, [](JsonEncoder encoder) {
+        return buildStatusObject("deprecated", encoder);
+    });
+    return 0;
+}
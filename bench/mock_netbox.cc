@@ -0,0 +1,410 @@
+#include "mock_netbox.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace {
+
+std::string
+urlDecode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            out.push_back(static_cast<char>(std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16)));
+            i += 2;
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+// Every string value of the given key, in order of appearance
+std::vector<std::string>
+stringValues(const std::string& body, const char* key) {
+    std::vector<std::string> values;
+    std::string needle = std::string("\"") + key + "\":\"";
+    size_t pos = 0;
+    while ((pos = body.find(needle, pos)) != std::string::npos) {
+        pos += needle.size();
+        size_t end = body.find('"', pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        values.push_back(body.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return values;
+}
+
+// Every integer value of the given key, in order of appearance
+std::vector<int>
+intValues(const std::string& body, const char* key) {
+    std::vector<int> values;
+    std::string needle = std::string("\"") + key + "\":";
+    size_t pos = 0;
+    while ((pos = body.find(needle, pos)) != std::string::npos) {
+        pos += needle.size();
+        values.push_back(std::atoi(body.c_str() + pos));
+    }
+    return values;
+}
+
+bool
+sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string
+itemJson(int id, const std::string& prefix) {
+    return "{\"id\":" + std::to_string(id) + ",\"prefix\":\"" + prefix + "\"}";
+}
+
+} // namespace
+
+MockNetBox::MockNetBox(const Options& options) : options_(options) {
+}
+
+MockNetBox::~MockNetBox() {
+    stop();
+}
+
+bool
+MockNetBox::start(std::string& error) {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 512) != 0 ||
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        error = std::strerror(errno);
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    acceptor_ = std::thread(&MockNetBox::acceptLoop, this);
+    return true;
+}
+
+void
+MockNetBox::stop() {
+    if (stopping_.exchange(true)) {
+        return;
+    }
+    if (listen_fd_ >= 0) {
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        ::close(listen_fd_);
+    }
+    if (acceptor_.joinable()) {
+        acceptor_.join();
+    }
+
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        for (int fd : conn_fds_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(conn_threads_);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+MockNetBox::Stats
+MockNetBox::getStats() const {
+    Stats stats;
+    stats.requests = requests_.load();
+    stats.lookups = lookups_.load();
+    stats.creates = creates_.load();
+    stats.updates = updates_.load();
+    stats.webhooks = webhooks_.load();
+    stats.errors = errors_.load();
+    stats.connections = connections_.load();
+    return stats;
+}
+
+void
+MockNetBox::acceptLoop() {
+    while (!stopping_) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        connections_.fetch_add(1);
+
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        if (stopping_) {
+            ::close(fd);
+            return;
+        }
+        conn_fds_.push_back(fd);
+        conn_threads_.emplace_back(&MockNetBox::serve, this, fd);
+    }
+}
+
+// Read requests off one keep-alive connection until the client closes it
+void
+MockNetBox::serve(int fd) {
+    std::string buffer;
+    char chunk[16384];
+
+    for (;;) {
+        size_t header_end;
+        while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                goto done;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+
+        {
+            std::string head = buffer.substr(0, header_end);
+            size_t line_end = head.find("\r\n");
+            std::string request_line = head.substr(0, line_end);
+            size_t sp1 = request_line.find(' ');
+            size_t sp2 = request_line.find(' ', sp1 + 1);
+            if (sp1 == std::string::npos || sp2 == std::string::npos) {
+                goto done;
+            }
+            std::string method = request_line.substr(0, sp1);
+            std::string target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+            size_t content_length = 0;
+            bool expect_continue = false;
+            size_t pos = line_end;
+            while (pos != std::string::npos && pos < head.size()) {
+                size_t next = head.find("\r\n", pos + 2);
+                std::string line = head.substr(pos + 2, (next == std::string::npos ? head.size() : next) - pos - 2);
+                if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+                    content_length = std::strtoul(line.c_str() + 15, nullptr, 10);
+                } else if (strncasecmp(line.c_str(), "Expect:", 7) == 0 &&
+                           line.find("100-continue") != std::string::npos) {
+                    expect_continue = true;
+                }
+                pos = next;
+            }
+            buffer.erase(0, header_end + 4);
+
+            if (expect_continue && buffer.size() < content_length &&
+                !sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+                goto done;
+            }
+            while (buffer.size() < content_length) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    goto done;
+                }
+                buffer.append(chunk, static_cast<size_t>(n));
+            }
+            std::string body = buffer.substr(0, content_length);
+            buffer.erase(0, content_length);
+
+            requests_.fetch_add(1, std::memory_order_relaxed);
+            if (options_.latency_us > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(options_.latency_us));
+            }
+
+            int status = 200;
+            std::string answer;
+            if (injectError()) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+                status = 503;
+                answer = "{\"detail\":\"mock error\"}";
+            } else {
+                answer = handle(method, target, body, status);
+            }
+
+            const char* reason = status == 200 ? "OK" : status == 201 ? "Created" : status == 404
+                                 ? "Not Found" : "Service Unavailable";
+            std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                                   "\r\nContent-Type: application/json\r\nContent-Length: " +
+                                   std::to_string(answer.size()) + "\r\n\r\n" + answer;
+            if (!sendAll(fd, response)) {
+                goto done;
+            }
+        }
+    }
+
+done:
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    for (size_t i = 0; i < conn_fds_.size(); ++i) {
+        if (conn_fds_[i] == fd) {
+            conn_fds_.erase(conn_fds_.begin() + i);
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+bool
+MockNetBox::injectError() {
+    if (options_.error_rate <= 0.0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(rng_mutex_);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < options_.error_rate;
+}
+
+std::string
+MockNetBox::handle(const std::string& method, const std::string& target, const std::string& body, int& status) {
+    const std::string prefixes = "/api/ipam/prefixes/";
+    if (target.compare(0, prefixes.size(), prefixes) != 0) {
+        if (method == "POST") {
+            webhooks_.fetch_add(1, std::memory_order_relaxed);
+            return "{}";
+        }
+        status = 404;
+        return "{\"detail\":\"Not found.\"}";
+    }
+
+    if (method == "GET") {
+        lookups_.fetch_add(1, std::memory_order_relaxed);
+        size_t q = target.find('?');
+        return lookup(q == std::string::npos ? std::string() : target.substr(q + 1));
+    }
+    if (method == "POST") {
+        status = 201;
+        return create(body);
+    }
+    if (method == "PATCH") {
+        return update(target, body);
+    }
+    status = 404;
+    return "{\"detail\":\"Not found.\"}";
+}
+
+// GET ipam/prefixes/: by prefix= filters, or a page of everything
+std::string
+MockNetBox::lookup(const std::string& query) {
+    std::vector<std::string> wanted;
+    size_t limit = 50;
+    size_t offset = 0;
+    size_t pos = 0;
+    while (pos <= query.size() && !query.empty()) {
+        size_t amp = query.find('&', pos);
+        std::string param = query.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        size_t eq = param.find('=');
+        if (eq != std::string::npos) {
+            std::string key = param.substr(0, eq);
+            std::string value = urlDecode(param.substr(eq + 1));
+            if (key == "prefix") {
+                wanted.push_back(value);
+            } else if (key == "limit") {
+                limit = std::strtoul(value.c_str(), nullptr, 10);
+            } else if (key == "offset") {
+                offset = std::strtoul(value.c_str(), nullptr, 10);
+            }
+        }
+        if (amp == std::string::npos) {
+            break;
+        }
+        pos = amp + 1;
+    }
+
+    std::string results;
+    size_t count = 0;
+    bool more = false;
+    {
+        std::lock_guard<std::mutex> lock(prefix_mutex_);
+        if (!wanted.empty()) {
+            for (const std::string& prefix : wanted) {
+                auto it = prefixes_.find(prefix);
+                if (it != prefixes_.end()) {
+                    results += (count++ ? "," : "") + itemJson(it->second, prefix);
+                }
+            }
+        } else {
+            for (size_t i = offset; i < order_.size() && count < limit; ++i) {
+                results += (count++ ? "," : "") + itemJson(prefixes_[order_[i]], order_[i]);
+            }
+            more = offset + count < order_.size();
+        }
+    }
+    return "{\"count\":" + std::to_string(count) + ",\"next\":" +
+           (more ? std::string("\"http://mock/next\"") : std::string("null")) + ",\"previous\":null,\"results\":[" +
+           results + "]}";
+}
+
+// POST ipam/prefixes/ with one object or a list
+std::string
+MockNetBox::create(const std::string& body) {
+    std::vector<std::string> created = stringValues(body, "prefix");
+    std::string items;
+    {
+        std::lock_guard<std::mutex> lock(prefix_mutex_);
+        for (size_t i = 0; i < created.size(); ++i) {
+            auto inserted = prefixes_.emplace(created[i], next_id_);
+            if (inserted.second) {
+                order_.push_back(created[i]);
+                ++next_id_;
+            }
+            items += (i ? "," : "") + itemJson(inserted.first->second, created[i]);
+        }
+    }
+    creates_.fetch_add(created.size(), std::memory_order_relaxed);
+
+    bool list = body.find_first_not_of(" \t\r\n") != std::string::npos &&
+                body[body.find_first_not_of(" \t\r\n")] == '[';
+    return list ? "[" + items + "]" : items;
+}
+
+// PATCH ipam/prefixes/<id>/, or a list with ids on ipam/prefixes/
+std::string
+MockNetBox::update(const std::string& target, const std::string& body) {
+    const std::string prefixes = "/api/ipam/prefixes/";
+    std::string rest = target.substr(prefixes.size());
+    if (!rest.empty() && rest[0] != '?') {
+        updates_.fetch_add(1, std::memory_order_relaxed);
+        return itemJson(std::atoi(rest.c_str()), "");
+    }
+
+    std::vector<int> ids = intValues(body, "id");
+    std::string items;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        items += (i ? "," : "") + itemJson(ids[i], "");
+    }
+    updates_.fetch_add(ids.size(), std::memory_order_relaxed);
+    return "[" + items + "]";
+}
@@ -0,0 +1,86 @@
+#ifndef MOCK_NETBOX_H
+#define MOCK_NETBOX_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Embedded HTTP/1.1 server standing in for NetBox and the webhook receiver.
+//
+// Listens on 127.0.0.1 with one thread per connection and keep-alive, like a
+// NetBox behind a reverse proxy. It implements just enough of the prefix API
+// for the hook: lookups by prefix= (repeatable) or by page, single and bulk
+// creates, and single and bulk PATCHes. Any other POST counts as a webhook.
+// Every answer can be delayed, and a fraction of them fail with 503.
+class MockNetBox {
+public:
+    struct Options {
+        unsigned latency_us{0};      // Added before every answer
+        double error_rate{0.0};      // Fraction of requests answered with 503
+    };
+
+    struct Stats {
+        uint64_t requests;
+        uint64_t lookups;
+        uint64_t creates;            // Prefixes, not requests
+        uint64_t updates;
+        uint64_t webhooks;
+        uint64_t errors;             // Injected 503s
+        uint64_t connections;
+    };
+
+    explicit MockNetBox(const Options& options);
+    ~MockNetBox();
+
+    MockNetBox(const MockNetBox&) = delete;
+    MockNetBox& operator=(const MockNetBox&) = delete;
+
+    // Bind to an ephemeral port and start accepting; false with error set on failure
+    bool start(std::string& error);
+    void stop();
+
+    uint16_t port() const { return port_; }
+    Stats getStats() const;
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+    std::string handle(const std::string& method, const std::string& target, const std::string& body, int& status);
+    std::string lookup(const std::string& query);
+    std::string create(const std::string& body);
+    std::string update(const std::string& target, const std::string& body);
+    bool injectError();
+
+    const Options options_;
+    int listen_fd_{-1};
+    uint16_t port_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread acceptor_;
+
+    std::mutex conn_mutex_;
+    std::vector<int> conn_fds_;
+    std::vector<std::thread> conn_threads_;
+
+    mutable std::mutex prefix_mutex_;
+    std::unordered_map<std::string, int> prefixes_;    // "addr/len" -> id
+    std::vector<std::string> order_;                   // Creation order for paging
+    int next_id_{1};
+
+    std::mutex rng_mutex_;
+    std::mt19937 rng_{12345};
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> lookups_{0};
+    std::atomic<uint64_t> creates_{0};
+    std::atomic<uint64_t> updates_{0};
+    std::atomic<uint64_t> webhooks_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> connections_{0};
+};
+
+#endif // MOCK_NETBOX_H
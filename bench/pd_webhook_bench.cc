@@ -0,0 +1,501 @@
+// Replays synthetic PD lease storms through the hook's callouts.
+//
+// Build with -DPD_WEBHOOK_BUILD_BENCH=ON and run ./pd_webhook_bench [options].
+// The hook library is loaded through Kea's HooksManager, as kea-dhcp6 would,
+// with NetBox and the webhook receiver both served by an embedded mock. N
+// threads build relayed Pkt6/Lease6 sets and call leases6_committed (and
+// optionally lease6_expire) at a fixed rate; the bench then waits for the
+// hook to finish delivering and reports callout latency percentiles,
+// throughput and heap allocations per event.
+//
+// Options:
+//   --threads N        Callout threads (default 4)
+//   --packets N        Packets per thread (default 10000)
+//   --rate N           Packets per second per thread, 0 = unlimited (default 0)
+//   --hops N           Relay hops per packet (default 2)
+//   --ia-pd N          IA_PD leases per packet (default 2)
+//   --renew F          Fraction of packets sent as RENEW instead of REQUEST
+//                      (default 0)
+//   --expire           Expire every committed lease afterwards
+//   --latency-us N     Mock NetBox latency per request (default 0)
+//   --backends N       Serve "netbox-backends" nb0..nbN-1 from N more mocks
+//                      (default 0, one NetBox at netbox-url)
+//   --slow-backend-us N  Latency of nb0 instead of --latency-us (default 0)
+//   --error-rate F     Fraction of mock requests answered with 503 (default 0)
+//   --drain-ms N       Longest wait for deliveries to finish (default 60000)
+//   --library PATH     Hook library (default: the one built alongside)
+//   --param KEY=VALUE  Extra hook parameter, repeatable; numbers and booleans
+//                      are passed as such, lists and maps as JSON
+
+#include "hook_stats.h"
+#include "mock_netbox.h"
+
+#include <asiolink/io_address.h>
+#include <cc/data.h>
+#include <dhcp/dhcp6.h>
+#include <dhcp/duid.h>
+#include <dhcp/option.h>
+#include <dhcp/pkt6.h>
+#include <dhcpsrv/lease.h>
+#include <hooks/hooks_manager.h>
+#include <log/logger_support.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace isc::dhcp;
+using namespace isc::hooks;
+using isc::asiolink::IOAddress;
+using isc::data::ConstElementPtr;
+using isc::data::Element;
+using isc::data::ElementPtr;
+
+#ifndef PD_WEBHOOK_LIBRARY
+#define PD_WEBHOOK_LIBRARY "libpd_webhook.so"
+#endif
+
+// Process-wide allocations, and those made by the current thread while it
+// is inside a callout
+static std::atomic<unsigned long long> g_allocations{0};
+static thread_local bool t_in_callout = false;
+static thread_local unsigned long long t_callout_allocations = 0;
+
+void*
+operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (t_in_callout) {
+        ++t_callout_allocations;
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct BenchConfig {
+    unsigned threads{4};
+    unsigned packets{10000};
+    unsigned rate{0};
+    unsigned hops{2};
+    unsigned ia_pd{2};
+    double renew{0.0};
+    bool expire{false};
+    unsigned latency_us{0};
+    unsigned backends{0};
+    unsigned slow_backend_us{0};
+    double error_rate{0.0};
+    unsigned drain_ms{60000};
+    std::string library{PD_WEBHOOK_LIBRARY};
+    std::vector<std::pair<std::string, std::string>> params;
+};
+
+struct ThreadResult {
+    unsigned long long callouts{0};
+    unsigned long long allocations{0};
+};
+
+static void
+usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--threads N] [--packets N] [--rate N] [--hops N] [--ia-pd N] [--renew F] [--expire]\n"
+                 "          [--latency-us N] [--backends N] [--slow-backend-us N] [--error-rate F]\n"
+                 "          [--drain-ms N] [--library PATH]\n"
+                 "          [--param KEY=VALUE]...\n",
+                 argv0);
+    std::exit(2);
+}
+
+static BenchConfig
+parseArgs(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            return argv[++i];
+        };
+        if (arg == "--threads") {
+            cfg.threads = std::max(1, std::atoi(value()));
+        } else if (arg == "--packets") {
+            cfg.packets = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--rate") {
+            cfg.rate = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--hops") {
+            cfg.hops = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--ia-pd") {
+            cfg.ia_pd = std::max(1, std::atoi(value()));
+        } else if (arg == "--renew") {
+            cfg.renew = std::atof(value());
+        } else if (arg == "--expire") {
+            cfg.expire = true;
+        } else if (arg == "--latency-us") {
+            cfg.latency_us = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--backends") {
+            cfg.backends = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--slow-backend-us") {
+            cfg.slow_backend_us = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--error-rate") {
+            cfg.error_rate = std::atof(value());
+        } else if (arg == "--drain-ms") {
+            cfg.drain_ms = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--library") {
+            cfg.library = value();
+        } else if (arg == "--param") {
+            std::string param = value();
+            size_t eq = param.find('=');
+            if (eq == std::string::npos) {
+                usage(argv[0]);
+            }
+            cfg.params.emplace_back(param.substr(0, eq), param.substr(eq + 1));
+        } else {
+            usage(argv[0]);
+        }
+    }
+    // Prefixes are numbered from 24 bits of packet index and 8 of IA_PD index
+    if (cfg.threads > 255 || cfg.packets > (1u << 24) || cfg.ia_pd > 256) {
+        std::fprintf(stderr, "at most 255 threads, 16M packets per thread and 256 IA_PDs\n");
+        std::exit(2);
+    }
+    return cfg;
+}
+
+// Hook parameters: the mock for every endpoint, then --param overrides
+static ConstElementPtr
+hookParameters(const BenchConfig& cfg, uint16_t port, const std::vector<uint16_t>& backend_ports) {
+    ElementPtr params = Element::createMap();
+    std::string base = "http://127.0.0.1:" + std::to_string(port);
+    params->set("netbox-url", Element::create(base));
+    params->set("netbox-token", Element::create("bench"));
+    if (!backend_ports.empty()) {
+        ElementPtr backends = Element::createList();
+        for (size_t i = 0; i < backend_ports.size(); ++i) {
+            ElementPtr backend = Element::createMap();
+            backend->set("name", Element::create("nb" + std::to_string(i)));
+            backend->set("url", Element::create("http://127.0.0.1:" + std::to_string(backend_ports[i])));
+            backend->set("token", Element::create("bench"));
+            backends->add(backend);
+        }
+        params->set("netbox-backends", backends);
+    }
+    params->set("webhook-url", Element::create(base + "/webhook"));
+    // Only used with --param trace-sample-rate=F
+    params->set("trace-otlp-url", Element::create(base + "/v1/traces"));
+
+    for (const auto& param : cfg.params) {
+        const std::string& v = param.second;
+        char* end = nullptr;
+        if (!v.empty() && (v[0] == '{' || v[0] == '[')) {
+            params->set(param.first, Element::fromJSON(v));
+        } else if (v == "true" || v == "false") {
+            params->set(param.first, Element::create(v == "true"));
+        } else if (!v.empty() && (std::strtoll(v.c_str(), &end, 10), *end == '\0')) {
+            params->set(param.first, Element::create(static_cast<int64_t>(std::atoll(v.c_str()))));
+        } else if (!v.empty() && (std::strtod(v.c_str(), &end), *end == '\0')) {
+            params->set(param.first, Element::create(std::atof(v.c_str())));
+        } else {
+            params->set(param.first, Element::create(v));
+        }
+    }
+    return params;
+}
+
+// Delegated prefix k of packet i on thread t: 3fff:TTPP:PPPP:KK00::/56
+static IOAddress
+prefixFor(unsigned t, unsigned i, unsigned k) {
+    char text[48];
+    std::snprintf(text, sizeof(text), "3fff:%x:%x:%x00::", ((t + 1) << 8) | (i >> 16), i & 0xffff, k);
+    return IOAddress(text);
+}
+
+static OptionBuffer
+duidFor(unsigned t, unsigned i) {
+    // DUID-LLT with a MAC derived from the thread and packet
+    return OptionBuffer{0x00, 0x01, 0x00, 0x01, 0x2b, 0x3c, 0x4d, 0x5e, 0x02, static_cast<uint8_t>(t),
+                        static_cast<uint8_t>(i >> 24), static_cast<uint8_t>(i >> 16),
+                        static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
+}
+
+// A REQUEST (or, for cfg.renew of the packets, a RENEW) relayed through
+// cfg.hops relays, the innermost one next to the CPE
+static Pkt6Ptr
+buildQuery(const BenchConfig& cfg, unsigned t, unsigned i) {
+    bool renew = cfg.renew > 0.0 && (i * 997u) % 1000 < static_cast<unsigned>(cfg.renew * 1000.0);
+    Pkt6Ptr query(new Pkt6(renew ? DHCPV6_RENEW : DHCPV6_REQUEST, (t << 24) | i));
+    query->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID, duidFor(t, i))));
+
+    char text[48];
+    for (unsigned h = 0; h < cfg.hops; ++h) {
+        Pkt6::RelayInfo relay;
+        relay.msg_type_ = DHCPV6_RELAY_FORW;
+        relay.hop_count_ = static_cast<uint8_t>(cfg.hops - 1 - h);
+        if (h + 1 == cfg.hops) {
+            std::snprintf(text, sizeof(text), "2001:db8:%x:%x::1", t + 1, i & 0xff);
+            relay.linkaddr_ = IOAddress(text);
+            std::snprintf(text, sizeof(text), "fe80::2%02x:%x:%x", t, i >> 16, i & 0xffff);
+            relay.peeraddr_ = IOAddress(text);
+        } else {
+            std::snprintf(text, sizeof(text), "2001:db8:ffff:%x::1", h);
+            relay.linkaddr_ = IOAddress(text);
+            std::snprintf(text, sizeof(text), "2001:db8:ffff:%x::2", h + 1);
+            relay.peeraddr_ = IOAddress(text);
+        }
+        std::string interface_id = "ae0." + std::to_string(h * 100 + t);
+        relay.options_.insert(std::make_pair(D6O_INTERFACE_ID, OptionPtr(new Option(Option::V6, D6O_INTERFACE_ID,
+            OptionBuffer(interface_id.begin(), interface_id.end())))));
+        query->addRelayInfo(relay);
+    }
+    query->setRemoteAddr(IOAddress(cfg.hops ? "2001:db8:ffff::2" : "fe80::1"));
+    return query;
+}
+
+static Lease6CollectionPtr
+buildLeases(const BenchConfig& cfg, unsigned t, unsigned i) {
+    Lease6CollectionPtr leases(new Lease6Collection());
+    DuidPtr duid(new DUID(duidFor(t, i)));
+    for (unsigned k = 0; k < cfg.ia_pd; ++k) {
+        leases->push_back(Lease6Ptr(new Lease6(Lease::TYPE_PD, prefixFor(t, i, k), duid, 1000 + k,
+                                               1800, 3600, 1, HWAddrPtr(), 56)));
+    }
+    return leases;
+}
+
+// Call one hook point and account for its latency and allocations
+static void
+timedCallout(int hook, CalloutHandle& handle, LatencyHistogram& latency, ThreadResult& result) {
+    unsigned long long allocations = t_callout_allocations;
+    t_in_callout = true;
+    auto start = std::chrono::steady_clock::now();
+    HooksManager::callCallouts(hook, handle);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    t_in_callout = false;
+    latency.record(elapsed);
+    result.allocations += t_callout_allocations - allocations;
+    ++result.callouts;
+}
+
+static void
+runThread(const BenchConfig& cfg, unsigned t, int committed_hook, int expire_hook,
+          LatencyHistogram& committed_latency, LatencyHistogram& expire_latency,
+          ThreadResult& result) {
+    auto interval = cfg.rate ? std::chrono::nanoseconds(1000000000 / cfg.rate) : std::chrono::nanoseconds(0);
+    auto next = std::chrono::steady_clock::now();
+
+    // Packets are built outside the timed region, as Kea does before the hook
+    for (unsigned i = 0; i < cfg.packets; ++i) {
+        if (cfg.rate) {
+            std::this_thread::sleep_until(next);
+            next += interval;
+        }
+        CalloutHandlePtr handle = HooksManager::createCalloutHandle();
+        Pkt6Ptr query = buildQuery(cfg, t, i);
+        Pkt6Ptr response(new Pkt6(DHCPV6_REPLY, query->getTransid()));
+        handle->setArgument("query6", query);
+        handle->setArgument("response6", response);
+        handle->setArgument("leases6", buildLeases(cfg, t, i));
+        handle->setArgument("deleted_leases6", Lease6CollectionPtr(new Lease6Collection()));
+        timedCallout(committed_hook, *handle, committed_latency, result);
+    }
+
+    if (!cfg.expire) {
+        return;
+    }
+    next = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < cfg.packets; ++i) {
+        Lease6CollectionPtr leases = buildLeases(cfg, t, i);
+        for (const Lease6Ptr& lease : *leases) {
+            if (cfg.rate) {
+                std::this_thread::sleep_until(next);
+                next += interval;
+            }
+            CalloutHandlePtr handle = HooksManager::createCalloutHandle();
+            handle->setArgument("lease6", lease);
+            handle->setArgument("remove_lease", true);
+            timedCallout(expire_hook, *handle, expire_latency, result);
+        }
+    }
+}
+
+static ConstElementPtr
+runCommand(const std::string& name) {
+    CalloutHandlePtr handle = HooksManager::createCalloutHandle();
+    ElementPtr command = Element::createMap();
+    command->set("command", Element::create(name));
+    handle->setArgument("command", ConstElementPtr(command));
+    HooksManager::callCommandHandlers(name, *handle);
+    ConstElementPtr response;
+    try {
+        handle->getArgument("response", response);
+    } catch (...) {
+    }
+    return response;
+}
+
+static int64_t
+counter(const ConstElementPtr& stats, const char* name) {
+    if (!stats) {
+        return 0;
+    }
+    ConstElementPtr args = stats->get("arguments");
+    ConstElementPtr counters = args ? args->get("counters") : ConstElementPtr();
+    ConstElementPtr value = counters ? counters->get(name) : ConstElementPtr();
+    return value ? value->intValue() : 0;
+}
+
+static void
+printLatency(const char* name, const LatencyHistogram& histogram) {
+    LatencyHistogram::Snapshot snap = histogram.snapshot();
+    if (!snap.count) {
+        return;
+    }
+    std::printf("%-20s n=%-9llu mean=%6.1fus p50=%6lluus p99=%6lluus p999=%6lluus max=%6lluus\n", name,
+                static_cast<unsigned long long>(snap.count), snap.mean(),
+                static_cast<unsigned long long>(snap.percentile(50.0)),
+                static_cast<unsigned long long>(snap.percentile(99.0)),
+                static_cast<unsigned long long>(snap.percentile(99.9)),
+                static_cast<unsigned long long>(snap.max_us));
+}
+
+int
+main(int argc, char** argv) {
+    BenchConfig cfg = parseArgs(argc, argv);
+    isc::log::initLogger("pd-webhook-bench", isc::log::WARN);
+
+    MockNetBox::Options mock_options;
+    mock_options.latency_us = cfg.latency_us;
+    mock_options.error_rate = cfg.error_rate;
+    MockNetBox mock(mock_options);
+    std::string error;
+    if (!mock.start(error)) {
+        std::fprintf(stderr, "mock NetBox: %s\n", error.c_str());
+        return 1;
+    }
+    std::vector<std::unique_ptr<MockNetBox>> backend_mocks;
+    std::vector<uint16_t> backend_ports;
+    for (unsigned i = 0; i < cfg.backends; ++i) {
+        MockNetBox::Options backend_options = mock_options;
+        if (i == 0 && cfg.slow_backend_us > 0) {
+            backend_options.latency_us = cfg.slow_backend_us;
+        }
+        backend_mocks.emplace_back(new MockNetBox(backend_options));
+        if (!backend_mocks.back()->start(error)) {
+            std::fprintf(stderr, "mock NetBox backend: %s\n", error.c_str());
+            return 1;
+        }
+        backend_ports.push_back(backend_mocks.back()->port());
+    }
+
+    int committed_hook = HooksManager::registerHook("leases6_committed");
+    int expire_hook = HooksManager::registerHook("lease6_expire");
+    HookLibsCollection libraries;
+    libraries.push_back(std::make_pair(cfg.library, hookParameters(cfg, mock.port(), backend_ports)));
+    if (!HooksManager::loadLibraries(libraries)) {
+        std::fprintf(stderr, "failed to load %s\n", cfg.library.c_str());
+        return 1;
+    }
+
+    std::printf("threads=%u packets/thread=%u rate=%u/s hops=%u ia-pd=%u renew=%.2f expire=%s latency=%uus "
+                "error-rate=%.3f\n",
+                cfg.threads, cfg.packets, cfg.rate, cfg.hops, cfg.ia_pd, cfg.renew, cfg.expire ? "yes" : "no",
+                cfg.latency_us, cfg.error_rate);
+
+    LatencyHistogram committed_latency;
+    LatencyHistogram expire_latency;
+    std::vector<ThreadResult> results(cfg.threads);
+    std::vector<std::thread> threads;
+    unsigned long long allocations_before = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < cfg.threads; ++t) {
+        threads.emplace_back(runThread, std::cref(cfg), t, committed_hook, expire_hook,
+                             std::ref(committed_latency), std::ref(expire_latency), std::ref(results[t]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double callout_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Every event is filtered out, or ends up sent, failed, coalesced, suppressed or dropped
+    uint64_t expected = static_cast<uint64_t>(cfg.threads) * cfg.packets * cfg.ia_pd * (cfg.expire ? 2 : 1);
+    uint64_t finished = 0;
+    ConstElementPtr stats;
+    auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(cfg.drain_ms);
+    while (true) {
+        stats = runCommand("pd-webhook-stats-get");
+        finished = counter(stats, "pd-webhook.events-sent") + counter(stats, "pd-webhook.events-failed") +
+                   counter(stats, "pd-webhook.events-coalesced") + counter(stats, "pd-webhook.events-suppressed") +
+                   counter(stats, "pd-webhook.events-dropped") + counter(stats, "pd-webhook.events-filtered");
+        if (finished >= expected || std::chrono::steady_clock::now() >= drain_deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double total_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned long long allocations_total = g_allocations.load() - allocations_before;
+
+    unsigned long long callouts = 0;
+    unsigned long long callout_allocations = 0;
+    for (const ThreadResult& result : results) {
+        callouts += result.callouts;
+        callout_allocations += result.allocations;
+    }
+
+    printLatency("leases6_committed", committed_latency);
+    printLatency("lease6_expire", expire_latency);
+    std::printf("callouts             %llu in %.3fs, %.0f callouts/s, %.0f events/s offered\n", callouts,
+                callout_secs, callouts / callout_secs, expected / callout_secs);
+    std::printf("delivery             %llu/%llu events finished in %.3fs, %.0f events/s%s\n",
+                static_cast<unsigned long long>(finished), static_cast<unsigned long long>(expected), total_secs,
+                finished / total_secs, finished < expected ? " (drain timed out)" : "");
+    std::printf("allocations/event    %.1f in callouts, %.1f overall\n",
+                expected ? static_cast<double>(callout_allocations) / expected : 0.0,
+                expected ? static_cast<double>(allocations_total) / expected : 0.0);
+
+    MockNetBox::Stats mock_stats = mock.getStats();
+    std::printf("mock                 requests=%llu lookups=%llu creates=%llu updates=%llu webhooks=%llu "
+                "errors=%llu connections=%llu\n",
+                static_cast<unsigned long long>(mock_stats.requests),
+                static_cast<unsigned long long>(mock_stats.lookups),
+                static_cast<unsigned long long>(mock_stats.creates),
+                static_cast<unsigned long long>(mock_stats.updates),
+                static_cast<unsigned long long>(mock_stats.webhooks),
+                static_cast<unsigned long long>(mock_stats.errors),
+                static_cast<unsigned long long>(mock_stats.connections));
+    for (size_t i = 0; i < backend_mocks.size(); ++i) {
+        MockNetBox::Stats backend_stats = backend_mocks[i]->getStats();
+        std::printf("backend nb%-10zu requests=%llu lookups=%llu creates=%llu updates=%llu errors=%llu\n", i,
+                    static_cast<unsigned long long>(backend_stats.requests),
+                    static_cast<unsigned long long>(backend_stats.lookups),
+                    static_cast<unsigned long long>(backend_stats.creates),
+                    static_cast<unsigned long long>(backend_stats.updates),
+                    static_cast<unsigned long long>(backend_stats.errors));
+    }
+    if (stats) {
+        std::printf("hook                 %s\n", stats->str().c_str());
+    }
+
+    HooksManager::unloadLibraries();
+    mock.stop();
+    for (const auto& backend_mock : backend_mocks) {
+        backend_mock->stop();
+    }
+    return finished < expected ? 1 : 0;
+}
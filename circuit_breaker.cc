@@ -0,0 +1,93 @@
+#include "circuit_breaker.h"
+
+CircuitBreaker::CircuitBreaker(unsigned failure_threshold, std::chrono::milliseconds cooldown)
+    : failure_threshold_(failure_threshold), cooldown_(cooldown) {
+}
+
+bool
+CircuitBreaker::allow() {
+    if (failure_threshold_ == 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (state_) {
+    case State::CLOSED:
+        return true;
+
+    case State::OPEN:
+        if (Clock::now() < open_until_) {
+            ++rejected_;
+            return false;
+        }
+        state_ = State::HALF_OPEN;
+        probing_ = true;
+        return true;
+
+    case State::HALF_OPEN:
+        // Only the probe goes through until its outcome is known.
+        if (probing_) {
+            ++rejected_;
+            return false;
+        }
+        probing_ = true;
+        return true;
+    }
+    return true;
+}
+
+void
+CircuitBreaker::onSuccess() {
+    if (failure_threshold_ == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_ = State::CLOSED;
+    consecutive_ = 0;
+    probing_ = false;
+}
+
+bool
+CircuitBreaker::onFailure() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++failures_;
+    if (failure_threshold_ == 0) {
+        return false;
+    }
+
+    if (state_ == State::HALF_OPEN) {
+        state_ = State::OPEN;
+        open_until_ = Clock::now() + cooldown_;
+        probing_ = false;
+        ++opened_;
+        return true;
+    }
+
+    if (state_ == State::CLOSED && ++consecutive_ >= failure_threshold_) {
+        state_ = State::OPEN;
+        open_until_ = Clock::now() + cooldown_;
+        ++opened_;
+        return true;
+    }
+    return false;
+}
+
+CircuitBreaker::Stats
+CircuitBreaker::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{state_, failures_, opened_, rejected_};
+}
+
+const char*
+CircuitBreaker::stateName(State state) {
+    switch (state) {
+    case State::CLOSED:
+        return "closed";
+    case State::OPEN:
+        return "open";
+    case State::HALF_OPEN:
+        return "half-open";
+    }
+    return "unknown";
+}
@@ -0,0 +1,63 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Failure gate for one HTTP endpoint.
+//
+// After the configured number of consecutive failures the breaker opens and
+// requests are refused without touching the network, so callers never wait
+// out a timeout against an endpoint that is down. Once the cooldown has
+// passed a single probe request is let through (half-open); its outcome
+// closes the breaker again or restarts the cooldown.
+class CircuitBreaker {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class State {
+        CLOSED,
+        OPEN,
+        HALF_OPEN
+    };
+
+    // Snapshot of the breaker counters
+    struct Stats {
+        State state;
+        uint64_t failures;           // Failed requests seen
+        uint64_t opened;             // Transitions to open
+        uint64_t rejected;           // Requests refused while open
+    };
+
+    // A threshold of 0 disables the breaker
+    CircuitBreaker(unsigned failure_threshold, std::chrono::milliseconds cooldown);
+
+    // True if a request may be sent now
+    bool allow();
+
+    void onSuccess();
+
+    // Record a failure; returns true if this failure opened the breaker
+    bool onFailure();
+
+    Stats getStats() const;
+
+    static const char* stateName(State state);
+
+private:
+    const unsigned failure_threshold_;
+    const std::chrono::milliseconds cooldown_;
+
+    mutable std::mutex mutex_;
+    State state_{State::CLOSED};
+    unsigned consecutive_{0};
+    Clock::time_point open_until_;
+    bool probing_{false};
+
+    uint64_t failures_{0};
+    uint64_t opened_{0};
+    uint64_t rejected_{0};
+};
+
+#endif // CIRCUIT_BREAKER_H
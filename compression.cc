@@ -0,0 +1,116 @@
+#include "compression.h"
+
+#ifdef PD_WEBHOOK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PD_WEBHOOK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+#ifdef PD_WEBHOOK_HAVE_ZLIB
+// Event JSON is repetitive; the fastest level already gets most of the gain.
+const int kGzipLevel = 1;
+
+bool
+gzip(const std::string& in, std::string& out) {
+    z_stream stream{};
+    // 16 + 15: gzip wrapper around a full 32 KiB window
+    if (deflateInit2(&stream, kGzipLevel, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int rc = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return rc == Z_STREAM_END;
+}
+#endif
+
+#ifdef PD_WEBHOOK_HAVE_ZSTD
+const int kZstdLevel = 3;
+
+bool
+zstd(const std::string& in, std::string& out) {
+    out.resize(ZSTD_compressBound(in.size()));
+    size_t n = ZSTD_compress(&out[0], out.size(), in.data(), in.size(), kZstdLevel);
+    if (ZSTD_isError(n)) {
+        return false;
+    }
+    out.resize(n);
+    return true;
+}
+#endif
+
+} // namespace
+
+bool
+parseCompression(const std::string& name, Compression& compression) {
+    if (name == "none") {
+        compression = Compression::NONE;
+    } else if (name == "gzip") {
+        compression = Compression::GZIP;
+    } else if (name == "zstd") {
+        compression = Compression::ZSTD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+compressionName(Compression compression) {
+    switch (compression) {
+    case Compression::GZIP:
+        return "gzip";
+    case Compression::ZSTD:
+        return "zstd";
+    default:
+        return "";
+    }
+}
+
+bool
+compressionAvailable(Compression compression) {
+    switch (compression) {
+    case Compression::NONE:
+        return true;
+    case Compression::GZIP:
+#ifdef PD_WEBHOOK_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Compression::ZSTD:
+#ifdef PD_WEBHOOK_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+bool
+compressBody(Compression compression, const std::string& in, std::string& out) {
+    switch (compression) {
+    case Compression::NONE:
+        out = in;
+        return true;
+#ifdef PD_WEBHOOK_HAVE_ZLIB
+    case Compression::GZIP:
+        return gzip(in, out);
+#endif
+#ifdef PD_WEBHOOK_HAVE_ZSTD
+    case Compression::ZSTD:
+        return zstd(in, out);
+#endif
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+
+// Request body compression for the webhook.
+//
+// gzip needs zlib and zstd needs libzstd at build time; CMake defines
+// PD_WEBHOOK_HAVE_ZLIB and PD_WEBHOOK_HAVE_ZSTD for the ones it found.
+enum class Compression {
+    NONE,
+    GZIP,
+    ZSTD
+};
+
+// Parse "none", "gzip" or "zstd"; false for anything else
+bool parseCompression(const std::string& name, Compression& compression);
+
+// The Content-Encoding value, "" for NONE
+const char* compressionName(Compression compression);
+
+// Whether this build can produce the encoding
+bool compressionAvailable(Compression compression);
+
+// Compress in into out, replacing its contents; false if the encoding is
+// unavailable or the library failed
+bool compressBody(Compression compression, const std::string& in, std::string& out);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,182 @@
+#include "curl_multi_engine.h"
+
+#include <unordered_set>
+#include <utility>
+
+MultiTransport::MultiTransport(CurlPool& pool, size_t threads, long max_host_connections, bool http2)
+    : pool_(pool),
+      max_host_connections_(max_host_connections > 0 ? max_host_connections : 1),
+      http2_(http2) {
+    size_t count = threads > 0 ? threads : 1;
+    for (size_t i = 0; i < count; ++i) {
+        std::unique_ptr<Loop> loop(new Loop());
+        loop->multi = curl_multi_init();
+        if (loop->multi) {
+            curl_multi_setopt(loop->multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections_);
+            curl_multi_setopt(loop->multi, CURLMOPT_PIPELINING,
+                              http2_ ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+        }
+        loops_.push_back(std::move(loop));
+    }
+}
+
+MultiTransport::~MultiTransport() {
+    stop();
+    for (auto& loop : loops_) {
+        if (loop->multi) {
+            curl_multi_cleanup(loop->multi);
+        }
+    }
+}
+
+void
+MultiTransport::start() {
+    for (auto& loop : loops_) {
+        if (loop->multi && !loop->thread.joinable()) {
+            Loop* l = loop.get();
+            loop->thread = std::thread([this, l] { run(*l); });
+        }
+    }
+}
+
+void
+MultiTransport::submit(HttpRequest&& request, HttpCompletion done) {
+    std::unique_ptr<Transfer> transfer(new Transfer());
+    transfer->request = std::move(request);
+    transfer->done = std::move(done);
+
+    Loop& loop = *loops_[next_loop_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        if (!loop.stopping && loop.multi && loop.thread.joinable()) {
+            loop.incoming.push_back(std::move(transfer));
+        }
+    }
+
+    if (transfer) {
+        // Not accepted: the engine is stopped or was never started.
+        transfer->response.code = CURLE_ABORTED_BY_CALLBACK;
+        complete(std::move(transfer));
+        return;
+    }
+    curl_multi_wakeup(loop.multi);
+}
+
+void
+MultiTransport::stop() {
+    for (auto& loop : loops_) {
+        {
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            loop->stopping = true;
+        }
+        if (loop->multi) {
+            curl_multi_wakeup(loop->multi);
+        }
+    }
+    for (auto& loop : loops_) {
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+    }
+}
+
+bool
+MultiTransport::addTransfer(Loop& loop, std::unique_ptr<Transfer> transfer) {
+    transfer->handle = pool_.acquire();
+    if (!transfer->handle) {
+        transfer->response.code = CURLE_FAILED_INIT;
+        complete(std::move(transfer));
+        return false;
+    }
+
+    CURL* curl = transfer->handle.get();
+    configureCurlHandle(curl, transfer->request, &transfer->response.body);
+    if (http2_) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    }
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer.get());
+
+    if (curl_multi_add_handle(loop.multi, curl) != CURLM_OK) {
+        transfer->response.code = CURLE_FAILED_INIT;
+        complete(std::move(transfer));
+        return false;
+    }
+    transfer.release();
+    return true;
+}
+
+void
+MultiTransport::complete(std::unique_ptr<Transfer> transfer) {
+    // Return the handle to the pool before running the continuation.
+    transfer->handle = CurlPool::Handle();
+    try {
+        transfer->done(transfer->response);
+    } catch (...) {
+        // A failing continuation must not take the loop thread down.
+    }
+}
+
+// Event-loop thread body: add new transfers, drive the multi handle, finish completed ones
+void
+MultiTransport::run(Loop& loop) {
+    std::unordered_set<Transfer*> active;
+
+    for (;;) {
+        std::vector<std::unique_ptr<Transfer>> incoming;
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            incoming.swap(loop.incoming);
+            stopping = loop.stopping;
+        }
+
+        if (stopping) {
+            for (auto& transfer : incoming) {
+                transfer->response.code = CURLE_ABORTED_BY_CALLBACK;
+                complete(std::move(transfer));
+            }
+            for (Transfer* transfer : active) {
+                curl_multi_remove_handle(loop.multi, transfer->handle.get());
+                transfer->response.code = CURLE_ABORTED_BY_CALLBACK;
+                complete(std::unique_ptr<Transfer>(transfer));
+            }
+            return;
+        }
+
+        for (auto& transfer : incoming) {
+            Transfer* raw = transfer.get();
+            if (addTransfer(loop, std::move(transfer))) {
+                active.insert(raw);
+            }
+        }
+
+        int running = 0;
+        curl_multi_perform(loop.multi, &running);
+
+        CURLMsg* msg;
+        int remaining = 0;
+        while ((msg = curl_multi_info_read(loop.multi, &remaining)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            CURL* curl = msg->easy_handle;
+            char* priv = nullptr;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+            Transfer* transfer = reinterpret_cast<Transfer*>(priv);
+
+            transfer->response.code = msg->data.result;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+            if (transfer->request.trace.sampled()) {
+                readCurlTimings(curl, transfer->response.timings);
+            }
+            curl_multi_remove_handle(loop.multi, curl);
+
+            active.erase(transfer);
+            complete(std::unique_ptr<Transfer>(transfer));
+        }
+
+        curl_multi_poll(loop.multi, nullptr, 0, 1000, nullptr);
+    }
+}
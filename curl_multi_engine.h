@@ -0,0 +1,63 @@
+#ifndef CURL_MULTI_ENGINE_H
+#define CURL_MULTI_ENGINE_H
+
+#include "curl_pool.h"
+#include "http_transport.h"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Non-blocking transport built on curl_multi.
+//
+// A small number of event-loop threads each drive one multi handle, so many
+// requests can be in flight without a thread per request. Completion callbacks
+// run on the loop thread and may submit the next step of a transaction
+// directly. HTTP/2 multiplexing is used when enabled and offered by the server.
+class MultiTransport : public HttpTransport {
+public:
+    MultiTransport(CurlPool& pool, size_t threads, long max_host_connections, bool http2);
+    ~MultiTransport() override;
+
+    MultiTransport(const MultiTransport&) = delete;
+    MultiTransport& operator=(const MultiTransport&) = delete;
+
+    void start();
+
+    void submit(HttpRequest&& request, HttpCompletion done) override;
+
+    void stop() override;
+
+private:
+    struct Transfer {
+        HttpRequest request;
+        HttpCompletion done;
+        CurlPool::Handle handle;
+        HttpResponse response;
+    };
+
+    struct Loop {
+        CURLM* multi{nullptr};
+        std::thread thread;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Transfer>> incoming;
+        bool stopping{false};
+    };
+
+    void run(Loop& loop);
+    bool addTransfer(Loop& loop, std::unique_ptr<Transfer> transfer);
+    static void complete(std::unique_ptr<Transfer> transfer);
+
+    CurlPool& pool_;
+    const long max_host_connections_;
+    const bool http2_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::atomic<size_t> next_loop_{0};
+};
+
+#endif // CURL_MULTI_ENGINE_H
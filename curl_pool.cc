@@ -0,0 +1,143 @@
+#include "curl_pool.h"
+
+#include <utility>
+
+CurlPool::Handle::~Handle() {
+    release();
+}
+
+CurlPool::Handle::Handle(Handle&& other) noexcept
+    : pool_(other.pool_), curl_(other.curl_) {
+    other.pool_ = nullptr;
+    other.curl_ = nullptr;
+}
+
+CurlPool::Handle&
+CurlPool::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        curl_ = other.curl_;
+        other.pool_ = nullptr;
+        other.curl_ = nullptr;
+    }
+    return *this;
+}
+
+void
+CurlPool::Handle::release() {
+    if (pool_ && curl_) {
+        pool_->release(curl_);
+    }
+    pool_ = nullptr;
+    curl_ = nullptr;
+}
+
+CurlPool::CurlPool() {
+    share_ = curl_share_init();
+    if (share_) {
+        curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlPool::lockShare);
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlPool::unlockShare);
+        curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    webhook_headers_ = curl_slist_append(nullptr, "Content-Type: application/json");
+    trace_headers_ = curl_slist_append(nullptr, "Content-Type: application/json");
+}
+
+CurlPool::~CurlPool() {
+    for (CURL* curl : idle_) {
+        curl_easy_cleanup(curl);
+    }
+    idle_.clear();
+
+    if (share_) {
+        curl_share_cleanup(share_);
+    }
+    curl_slist_free_all(netbox_headers_);
+    curl_slist_free_all(webhook_headers_);
+    curl_slist_free_all(trace_headers_);
+    for (curl_slist* headers : backend_headers_) {
+        curl_slist_free_all(headers);
+    }
+}
+
+curl_slist*
+CurlPool::buildNetBoxHeaders(const std::string& token) {
+    std::string auth_header = "Authorization: Token " + token;
+    curl_slist* headers = curl_slist_append(nullptr, auth_header.c_str());
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    return curl_slist_append(headers, "Accept: application/json");
+}
+
+void
+CurlPool::setNetBoxToken(const std::string& token) {
+    curl_slist_free_all(netbox_headers_);
+    netbox_headers_ = buildNetBoxHeaders(token);
+}
+
+curl_slist*
+CurlPool::addNetBoxHeaders(const std::string& token) {
+    backend_headers_.push_back(buildNetBoxHeaders(token));
+    return backend_headers_.back();
+}
+
+void
+CurlPool::setWebhookContent(const std::string& content_type, const std::string& content_encoding) {
+    curl_slist_free_all(webhook_headers_);
+    std::string type_header = "Content-Type: " + content_type;
+    webhook_headers_ = curl_slist_append(nullptr, type_header.c_str());
+    if (!content_encoding.empty()) {
+        std::string encoding_header = "Content-Encoding: " + content_encoding;
+        webhook_headers_ = curl_slist_append(webhook_headers_, encoding_header.c_str());
+    }
+}
+
+CurlPool::Handle
+CurlPool::acquire() {
+    CURL* curl = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            // LIFO keeps the most recently used (warmest) connection in use.
+            curl = idle_.back();
+            idle_.pop_back();
+        }
+    }
+
+    if (curl) {
+        // Resets options only; live connections and caches are kept.
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+        if (!curl) {
+            return Handle();
+        }
+    }
+
+    if (share_) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    }
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    return Handle(this, curl);
+}
+
+void
+CurlPool::release(CURL* curl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(curl);
+}
+
+void
+CurlPool::lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<CurlPool*>(userptr)->share_locks_[data].lock();
+}
+
+void
+CurlPool::unlockShare(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<CurlPool*>(userptr)->share_locks_[data].unlock();
+}
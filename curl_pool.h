@@ -0,0 +1,85 @@
+#ifndef CURL_POOL_H
+#define CURL_POOL_H
+
+#include <curl/curl.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Pool of reusable libcurl easy handles.
+//
+// An easy handle keeps its connection cache between transfers, so returning it
+// to the pool instead of cleaning it up keeps the TCP/TLS connection to NetBox
+// and the webhook endpoint alive for the next request. All handles are
+// attached to one share object for the DNS cache and TLS session IDs; the
+// connection cache itself stays per handle because libcurl does not support
+// sharing connections between concurrently running threads.
+class CurlPool {
+public:
+    // Exclusive use of one pooled handle; returned to the pool on destruction
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(CurlPool* pool, CURL* curl) : pool_(pool), curl_(curl) {}
+        ~Handle();
+
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        CURL* get() const { return curl_; }
+        explicit operator bool() const { return curl_ != nullptr; }
+
+    private:
+        void release();
+
+        CurlPool* pool_{nullptr};
+        CURL* curl_{nullptr};
+    };
+
+    CurlPool();
+    ~CurlPool();
+
+    CurlPool(const CurlPool&) = delete;
+    CurlPool& operator=(const CurlPool&) = delete;
+
+    // Build the header lists used for every NetBox and webhook request
+    void setNetBoxToken(const std::string& token);
+
+    // Header list for one more NetBox instance, with its own token; owned by the pool
+    curl_slist* addNetBoxHeaders(const std::string& token);
+
+    // Rebuild the webhook header list for the body format; no Content-Encoding
+    // header when content_encoding is empty
+    void setWebhookContent(const std::string& content_type, const std::string& content_encoding);
+
+    // Take a handle from the pool (or create one); options are reset, connections kept
+    Handle acquire();
+
+    curl_slist* netboxHeaders() const { return netbox_headers_; }
+    curl_slist* webhookHeaders() const { return webhook_headers_; }
+    curl_slist* traceHeaders() const { return trace_headers_; }
+
+private:
+    void release(CURL* curl);
+
+    static curl_slist* buildNetBoxHeaders(const std::string& token);
+
+    static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+
+    CURLSH* share_{nullptr};
+    std::mutex share_locks_[CURL_LOCK_DATA_LAST];
+
+    std::mutex mutex_;
+    std::vector<CURL*> idle_;
+
+    curl_slist* netbox_headers_{nullptr};
+    curl_slist* webhook_headers_{nullptr};
+    curl_slist* trace_headers_{nullptr};     // OTLP export
+    std::vector<curl_slist*> backend_headers_;  // "netbox-backends"
+};
+
+#endif // CURL_POOL_H
@@ -0,0 +1,434 @@
+#include "dispatch_queue.h"
+
+#include <utility>
+
+// Events the intake thread moves from the ring per lock acquisition
+static const size_t kIntakeBatch = 256;
+
+DispatchQueue::DispatchQueue(PrefixTable& table, size_t capacity, size_t threads, OverflowPolicy policy,
+                             Handler handler, size_t ring_size)
+    : capacity_(capacity > 0 ? capacity : 1),
+      thread_count_(threads > 0 ? threads : 1),
+      policy_(policy),
+      handler_(std::move(handler)),
+      table_(table),
+      ring_(ring_size > 0 ? new EventRing(ring_size) : nullptr) {
+}
+
+DispatchQueue::~DispatchQueue() {
+    stop();
+}
+
+void
+DispatchQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!threads_.empty()) {
+        return;
+    }
+    stopping_ = false;
+    for (size_t i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back(&DispatchQueue::run, this);
+    }
+    if (ring_) {
+        intake_open_.store(true, std::memory_order_release);
+        intake_thread_ = std::thread(&DispatchQueue::runIntake, this);
+    }
+}
+
+size_t
+DispatchQueue::stop() {
+    // The intake moves the ring's events into the queue before it exits; the
+    // rest is moved here, and discarded with the queue's.
+    if (intake_thread_.joinable()) {
+        // A producer that saw the intake open may still be pushing; once it
+        // is done, every pushed event is in the ring for the final move.
+        intake_open_.store(false);
+        while (producers_.load() != 0) {
+            std::this_thread::yield();
+        }
+        ring_->wake();
+        intake_thread_.join();
+        std::vector<PdEvent> batch;
+        std::lock_guard<std::mutex> intake(intake_mutex_);
+        while (moveFromRing(batch) > 0) {
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t discarded = pending_;
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].key.length == 0) {
+            continue;
+        }
+        table_.modify(slots_[i].key, [](PrefixTable::Entry& entry) { entry.flags &= ~PrefixTable::PENDING; });
+        release(i);
+    }
+    pending_ = 0;
+    order_[HIGH].clear();
+    order_[LOW].clear();
+    return discarded;
+}
+
+// Put an event into a free slot
+uint32_t
+DispatchQueue::store(PdEvent&& event, const PrefixKey& key) {
+    uint32_t slot;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    slots_[slot].event = std::move(event);
+    slots_[slot].key = key;
+    return slot;
+}
+
+// Take the event out of a slot and free it
+PdEvent
+DispatchQueue::release(uint32_t slot) {
+    PdEvent event = std::move(slots_[slot].event);
+    slots_[slot].event = PdEvent();
+    slots_[slot].key.length = 0;
+    free_slots_.push_back(slot);
+    return event;
+}
+
+bool
+DispatchQueue::enqueue(PdEvent&& event) {
+    if (event.data.prefix.length == 0) {
+        dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // The count and intake_open_ are sequentially consistent, so that stop()
+    // either sees this producer or this producer sees the intake closed.
+    if (ring_) {
+        producers_.fetch_add(1);
+    }
+    bool stored;
+    if (ring_ && intake_open_.load()) {
+        // Callouts hand events over through the ring.
+        if (ring_->push(event)) {
+            producers_.fetch_sub(1);
+            return true;
+        }
+        // It is full: move what it holds first, so the event cannot overtake
+        // an earlier one for its prefix.
+        std::vector<PdEvent> batch;
+        std::lock_guard<std::mutex> intake(intake_mutex_);
+        while (moveFromRing(batch) == kIntakeBatch) {
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stored = insert(std::move(event));
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stored = insert(std::move(event));
+    }
+    if (ring_) {
+        producers_.fetch_sub(1);
+    }
+    if (stored) {
+        cv_.notify_one();
+    }
+    return stored;
+}
+
+void
+DispatchQueue::hasPending(const std::vector<PrefixKey>& keys, std::vector<bool>& pending, bool claim) {
+    if (ring_) {
+        std::vector<PdEvent> batch;
+        std::lock_guard<std::mutex> intake(intake_mutex_);
+        while (moveFromRing(batch) == kIntakeBatch) {
+        }
+    }
+    pending.assign(keys.size(), false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto check = [&pending, i, claim](PrefixTable::Entry& entry) {
+            pending[i] = (entry.flags & (PrefixTable::PENDING | PrefixTable::BUSY)) != 0;
+            if (claim && !pending[i]) {
+                entry.flags |= PrefixTable::BUSY;
+            }
+        };
+        // Without room for the mark the prefix cannot be claimed, so it is
+        // reported pending and its event goes through the queue.
+        if (claim && !table_.update(keys[i], check)) {
+            pending[i] = true;
+        } else if (!claim) {
+            table_.modify(keys[i], check);
+        }
+    }
+}
+
+void
+DispatchQueue::unclaim(const PrefixKey& key) {
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready = release(key);
+    }
+    if (ready) {
+        cv_.notify_one();
+    }
+}
+
+// Queue an event, coalescing it with one already pending for the prefix;
+// mutex_ must be held. Returns false if the event itself was dropped.
+bool
+DispatchQueue::insert(PdEvent&& event) {
+    PrefixKey key = event.data.prefix;
+    if (stopping_) {
+        dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // A pending event for the same prefix is superseded by the newer state.
+    // It stays high priority if either was: a renewal of an assignment that
+    // has not been sent yet still carries the assignment. For the same reason
+    // it goes to every sink either event was meant for.
+    bool coalesced = false;
+    bool promoted = false;
+    bool busy = false;
+    table_.modify(key, [&](PrefixTable::Entry& entry) {
+        busy = (entry.flags & PrefixTable::BUSY) != 0;
+        if (!(entry.flags & PrefixTable::PENDING)) {
+            return;
+        }
+        PdEvent& queued = slots_[entry.pending].event;
+        promoted = queued.low_priority && !event.low_priority;
+        bool low_priority = queued.low_priority && event.low_priority;
+        uint8_t sinks = queued.sinks | event.sinks;
+        queued = std::move(event);
+        queued.low_priority = low_priority;
+        queued.sinks = sinks;
+        coalesced = true;
+    });
+    if (coalesced) {
+        if (promoted && !busy) {
+            order_[HIGH].push_back(key);
+        }
+        enqueued_.fetch_add(1, std::memory_order_relaxed);
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (pending_ >= capacity_) {
+        // Only prefixes that are ready can be evicted, low priority first;
+        // if every pending prefix is waiting for an active delivery, reject
+        // the new event. DROP_NEWEST still makes room for high priority.
+        PrefixKey victim;
+        if ((policy_ == OverflowPolicy::DROP_OLDEST || !event.low_priority) && popReady(LOW, victim)) {
+            shed_.fetch_add(1, std::memory_order_relaxed);
+        } else if (policy_ == OverflowPolicy::DROP_OLDEST && popReady(HIGH, victim)) {
+            dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        uint32_t slot = 0;
+        table_.modify(victim, [&](PrefixTable::Entry& entry) {
+            slot = entry.pending;
+            entry.flags &= ~PrefixTable::PENDING;
+        });
+        release(slot);
+        --pending_;
+    }
+
+    Lane lane = laneOf(event);
+    uint32_t slot = store(std::move(event), key);
+    bool stored = table_.update(key, [&](PrefixTable::Entry& entry) {
+        busy = (entry.flags & PrefixTable::BUSY) != 0;
+        entry.flags |= PrefixTable::PENDING;
+        entry.pending = slot;
+    });
+    if (!stored) {
+        // Every entry the prefix could take holds queued or in-flight state.
+        release(slot);
+        dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ++pending_;
+    if (!busy) {
+        order_[lane].push_back(key);
+    }
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Move a batch of events from the ring into the queue under one lock and wake
+// as many senders as there are new events; returns the number moved.
+// intake_mutex_ must be held: it makes whoever pops the ring its one consumer.
+size_t
+DispatchQueue::moveFromRing(std::vector<PdEvent>& batch) {
+    batch.clear();
+    size_t n = ring_->popBatch(batch, kIntakeBatch);
+    if (n == 0) {
+        return 0;
+    }
+    size_t stored = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (PdEvent& event : batch) {
+            if (insert(std::move(event))) {
+                ++stored;
+            }
+        }
+    }
+    intake_batches_.fetch_add(1, std::memory_order_relaxed);
+    if (stored >= thread_count_) {
+        cv_.notify_all();
+    } else {
+        for (size_t i = 0; i < stored; ++i) {
+            cv_.notify_one();
+        }
+    }
+    return n;
+}
+
+void
+DispatchQueue::runIntake() {
+    std::vector<PdEvent> batch;
+    batch.reserve(kIntakeBatch);
+    for (;;) {
+        size_t moved;
+        {
+            std::lock_guard<std::mutex> intake(intake_mutex_);
+            moved = moveFromRing(batch);
+        }
+        if (moved > 0) {
+            continue;
+        }
+        if (!intake_open_.load(std::memory_order_acquire)) {
+            return;
+        }
+        ring_->wait(std::chrono::milliseconds(100));
+    }
+}
+
+DispatchQueue::Stats
+DispatchQueue::getStats() const {
+    Stats stats;
+    stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+    stats.delivered = delivered_.load(std::memory_order_relaxed);
+    stats.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+    stats.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+    stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+    stats.shed = shed_.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.depth = pending_;
+        stats.active = active_;
+    }
+    stats.intake_batches = intake_batches_.load(std::memory_order_relaxed);
+    stats.ring_full = 0;
+    if (ring_) {
+        stats.depth += ring_->size();
+        stats.ring_full = ring_->getStats().full;
+    }
+    return stats;
+}
+
+// Delivery of a prefix finished: release it and make a newer event for it ready
+void
+DispatchQueue::finish(const PrefixKey& key) {
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --active_;
+        ready = release(key);
+    }
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+    if (ready) {
+        cv_.notify_one();
+    }
+}
+
+// Clear the BUSY mark of a delivered prefix and ready its pending event, if
+// any; mutex_ must be held. Returns whether an event became ready.
+bool
+DispatchQueue::release(const PrefixKey& key) {
+    bool ready = false;
+    Lane lane = HIGH;
+    table_.modify(key, [&](PrefixTable::Entry& entry) {
+        entry.flags &= ~PrefixTable::BUSY;
+        if (!stopping_ && (entry.flags & PrefixTable::PENDING)) {
+            lane = laneOf(slots_[entry.pending].event);
+            ready = true;
+        }
+    });
+    if (ready) {
+        order_[lane].push_back(key);
+    }
+    return ready;
+}
+
+// Take the oldest ready prefix of a lane. Lanes may hold stale entries for
+// prefixes that were promoted, evicted or are being delivered; they are skipped.
+bool
+DispatchQueue::popReady(Lane lane, PrefixKey& key) {
+    std::deque<PrefixKey>& order = order_[lane];
+    while (!order.empty()) {
+        PrefixKey candidate = order.front();
+        order.pop_front();
+        bool ready = false;
+        table_.modify(candidate, [&](PrefixTable::Entry& entry) {
+            ready = (entry.flags & PrefixTable::PENDING) && !(entry.flags & PrefixTable::BUSY) &&
+                    laneOf(slots_[entry.pending].event) == lane;
+        });
+        if (ready) {
+            key = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sender thread body: take the oldest ready prefix, high priority first, and
+// hand its event to the handler
+void
+DispatchQueue::run() {
+    for (;;) {
+        PdEvent event;
+        PrefixKey key;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !order_[HIGH].empty() || !order_[LOW].empty(); });
+            if (stopping_) {
+                return;
+            }
+            if (!popReady(HIGH, key) && !popReady(LOW, key)) {
+                continue;
+            }
+            uint32_t slot = 0;
+            table_.modify(key, [&](PrefixTable::Entry& entry) {
+                slot = entry.pending;
+                entry.flags = (entry.flags & ~PrefixTable::PENDING) | PrefixTable::BUSY;
+            });
+            event = release(slot);
+            --pending_;
+            ++active_;
+        }
+
+        try {
+            handler_(event, [this, key] { finish(key); });
+        } catch (...) {
+            // A failing delivery must not take the sender thread down.
+            finish(key);
+        }
+    }
+}
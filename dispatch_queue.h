@@ -0,0 +1,151 @@
+#ifndef DISPATCH_QUEUE_H
+#define DISPATCH_QUEUE_H
+
+#include "event_ring.h"
+#include "pd_types.h"
+#include "prefix_table.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded event queue between the Kea callouts and the HTTP sender threads.
+//
+// Callouts only enqueue and return; a fixed pool of sender threads drains the
+// queue and runs the webhook and NetBox requests. When the queue is full the
+// configured overflow policy decides which event is discarded.
+//
+// The queue is keyed by (prefix, prefix length): an event for a prefix that
+// already has one pending replaces it, so only the latest state is sent
+// (assign+assign -> the later assign, assign+expire -> expire). A prefix is
+// handed to one sender at a time; events arriving while it is being delivered
+// wait until the handler reports completion, which keeps them in order.
+// Which prefixes are pending or being delivered is kept in the shared
+// PrefixTable; the events themselves sit in a slot array that is reused.
+// Memory is bounded by the number of distinct pending prefixes.
+//
+// Ready prefixes wait in one of two lanes. Senders always take from the
+// high-priority lane first, and a full queue evicts from the low-priority
+// lane (PdEvent::low_priority) first, whatever the overflow policy.
+//
+// With a ring, callouts do not take the queue lock: enqueue() pushes into a
+// lock-free EventRing, and an intake thread moves events from it into the
+// queue in batches, one lock acquisition and one round of sender wakeups per
+// batch. A full ring makes enqueue() empty it and queue the event itself,
+// which keeps the events for a prefix in order. Overflow drops of ring
+// events happen on the intake thread, so they only show up in the counters.
+class DispatchQueue {
+public:
+    enum class OverflowPolicy {
+        DROP_OLDEST,                 // Discard the oldest queued event
+        DROP_NEWEST                  // Reject the event being enqueued
+    };
+
+    // Called by the handler once delivery of an event has finished
+    typedef std::function<void()> Completion;
+    typedef std::function<void(const PdEvent&, Completion)> Handler;
+
+    // Snapshot of the queue counters
+    struct Stats {
+        uint64_t enqueued;
+        uint64_t delivered;
+        uint64_t dropped_oldest;
+        uint64_t dropped_newest;
+        uint64_t coalesced;
+        uint64_t shed;               // Low-priority events evicted from a full queue
+        size_t depth;                // Including events still in the ring
+        size_t active;               // Handed to a sender, delivery not finished yet
+        uint64_t intake_batches;     // Batches moved from the ring
+        uint64_t ring_full;          // Events queued directly because the ring was full
+    };
+
+    // table must outlive the queue; ring_size 0 queues every event under the lock
+    DispatchQueue(PrefixTable& table, size_t capacity, size_t threads, OverflowPolicy policy, Handler handler,
+                  size_t ring_size = 0);
+    ~DispatchQueue();
+
+    DispatchQueue(const DispatchQueue&) = delete;
+    DispatchQueue& operator=(const DispatchQueue&) = delete;
+
+    // Start the sender threads
+    void start();
+
+    // Stop the sender threads; events still queued are discarded and returned
+    size_t stop();
+
+    // Queue an event, from any thread; returns false if the event itself was dropped
+    bool enqueue(PdEvent&& event);
+
+    // Whether an event for each prefix is queued or being delivered, counting
+    // events still in the ring: they are moved into the queue first, once for
+    // all keys, which are then checked under one lock. pending[i] is for keys[i].
+    // With claim, a prefix without one is marked BUSY under the same lock, for
+    // delivery outside the queue: its later events wait until unclaim().
+    void hasPending(const std::vector<PrefixKey>& keys, std::vector<bool>& pending, bool claim = false);
+
+    // End the delivery of a claimed prefix; as when a sender finishes, an
+    // event that waited for it becomes ready
+    void unclaim(const PrefixKey& key);
+
+    Stats getStats() const;
+
+private:
+    enum Lane { HIGH = 0, LOW = 1, LANES = 2 };
+
+    // A queued event and the prefix it belongs to; key.length is 0 while the slot is free
+    struct Slot {
+        PdEvent event;
+        PrefixKey key;
+    };
+
+    static Lane laneOf(const PdEvent& event) { return event.low_priority ? LOW : HIGH; }
+
+    bool insert(PdEvent&& event);
+    size_t moveFromRing(std::vector<PdEvent>& batch);
+    void runIntake();
+    uint32_t store(PdEvent&& event, const PrefixKey& key);
+    PdEvent release(uint32_t slot);
+    bool popReady(Lane lane, PrefixKey& key);
+    void run();
+    void finish(const PrefixKey& key);
+    bool release(const PrefixKey& key);
+
+    const size_t capacity_;
+    const size_t thread_count_;
+    const OverflowPolicy policy_;
+    Handler handler_;
+    PrefixTable& table_;             // PENDING / BUSY flags; changed only under mutex_
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;                            // At most one event per prefix
+    std::vector<uint32_t> free_slots_;
+    size_t pending_{0};
+    size_t active_{0};
+    std::deque<PrefixKey> order_[LANES];                 // Pending prefixes ready to send, per lane
+    std::vector<std::thread> threads_;
+    bool stopping_{false};
+
+    std::unique_ptr<EventRing> ring_;                    // Null without a ring
+    std::thread intake_thread_;
+    std::mutex intake_mutex_;                            // Held by whoever pops the ring
+    std::atomic<bool> intake_open_{false};
+    std::atomic<size_t> producers_{0};                   // enqueue() calls that may still push to the ring
+    std::atomic<uint64_t> intake_batches_{0};
+
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> shed_{0};
+};
+
+#endif // DISPATCH_QUEUE_H
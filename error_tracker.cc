@@ -0,0 +1,100 @@
+#include "error_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+
+void
+ErrorTracker::record(ErrorCode code, const char* endpoint) {
+    size_t index = static_cast<size_t>(code);
+    if (index >= kCodes) {
+        return;
+    }
+    counts_[index].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t serial = next_.fetch_add(1, std::memory_order_relaxed) + 1;
+    Slot& slot = slots_[(serial - 1) % kRingSize];
+
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    if ((seq & 1) || !slot.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel,
+                                                       std::memory_order_relaxed)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    slot.serial.store(serial, std::memory_order_relaxed);
+    slot.time_ms.store(now_ms, std::memory_order_relaxed);
+    slot.code.store(static_cast<uint8_t>(code), std::memory_order_relaxed);
+    slot.endpoint.store(endpoint, std::memory_order_relaxed);
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+ErrorTracker::Stats
+ErrorTracker::getStats() const {
+    Stats stats;
+    stats.total = 0;
+    for (size_t i = 0; i < kCodes; ++i) {
+        stats.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        stats.total += stats.counts[i];
+    }
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::vector<ErrorTracker::Entry>
+ErrorTracker::recent() const {
+    std::vector<Entry> entries;
+    entries.reserve(kRingSize);
+
+    for (const Slot& slot : slots_) {
+        // A slot still changing after a few tries is being rewritten; skip it.
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            Entry entry;
+            entry.serial = slot.serial.load(std::memory_order_relaxed);
+            entry.time_ms = slot.time_ms.load(std::memory_order_relaxed);
+            entry.code = static_cast<ErrorCode>(slot.code.load(std::memory_order_relaxed));
+            entry.endpoint = slot.endpoint.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+            if (entry.serial != 0) {
+                entries.push_back(entry);
+            }
+            break;
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.serial > b.serial;
+    });
+    return entries;
+}
+
+const char*
+ErrorTracker::codeName(ErrorCode code) {
+    switch (code) {
+    case ErrorCode::NONE:
+        return "none";
+    case ErrorCode::CURL_INIT_FAILED:
+        return "curl-init-failed";
+    case ErrorCode::HTTP_REQUEST_FAILED:
+        return "http-request-failed";
+    case ErrorCode::JSON_PARSE_FAILED:
+        return "json-parse-failed";
+    case ErrorCode::INVALID_RESPONSE:
+        return "invalid-response";
+    case ErrorCode::CIRCUIT_OPEN:
+        return "circuit-open";
+    case ErrorCode::EVENT_DROPPED:
+        return "event-dropped";
+    case ErrorCode::SPOOL_FAILED:
+        return "spool-failed";
+    }
+    return "unknown";
+}
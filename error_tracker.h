@@ -0,0 +1,76 @@
+#ifndef ERROR_TRACKER_H
+#define ERROR_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Error codes for structured error reporting
+enum class ErrorCode : uint8_t {
+    NONE,
+    CURL_INIT_FAILED,
+    HTTP_REQUEST_FAILED,             // No usable answer once retries were used up
+    JSON_PARSE_FAILED,               // NetBox sent a malformed body
+    INVALID_RESPONSE,                // Well-formed, but not the expected answer
+    CIRCUIT_OPEN,                    // A circuit breaker opened
+    EVENT_DROPPED,                   // Dispatch queue full
+    SPOOL_FAILED
+};
+
+// Error counters and a ring of the most recent errors, written from any thread.
+//
+// record() takes no locks: the counters are relaxed atomics and each ring
+// slot is a seqlock. Two writers only meet on a slot when more errors than
+// the ring holds arrive at once; the later one then drops its entry rather
+// than wait, and the counters still include it. Readers retry a slot that
+// changes under them.
+class ErrorTracker {
+public:
+    static const size_t kCodes = static_cast<size_t>(ErrorCode::SPOOL_FAILED) + 1;
+    static const size_t kRingSize = 64;
+
+    struct Entry {
+        uint64_t serial;             // 1 for the first error recorded
+        int64_t time_ms;             // Wall clock, milliseconds since the epoch
+        ErrorCode code;
+        const char* endpoint;
+    };
+
+    struct Stats {
+        uint64_t counts[kCodes];
+        uint64_t total;
+        uint64_t dropped;            // Left out of the ring, see above
+    };
+
+    ErrorTracker() = default;
+
+    ErrorTracker(const ErrorTracker&) = delete;
+    ErrorTracker& operator=(const ErrorTracker&) = delete;
+
+    // endpoint must be a string with static storage, e.g. a literal
+    void record(ErrorCode code, const char* endpoint);
+
+    Stats getStats() const;
+
+    // Errors still in the ring, newest first
+    std::vector<Entry> recent() const;
+
+    static const char* codeName(ErrorCode code);
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq{0};    // Odd while a write is in progress
+        std::atomic<uint64_t> serial{0}; // 0 while the slot has never been written
+        std::atomic<int64_t> time_ms{0};
+        std::atomic<uint8_t> code{0};
+        std::atomic<const char*> endpoint{nullptr};
+    };
+
+    std::atomic<uint64_t> counts_[kCodes] = {};
+    std::atomic<uint64_t> next_{0};
+    std::atomic<uint64_t> dropped_{0};
+    Slot slots_[kRingSize];
+};
+
+#endif // ERROR_TRACKER_H
@@ -0,0 +1,122 @@
+#include "event_filter.h"
+
+#include <algorithm>
+
+namespace {
+
+// The 16 address bytes as two big-endian words
+void
+loadWords(const uint8_t* bytes, uint64_t words[2]) {
+    for (int w = 0; w < 2; ++w) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value = (value << 8) | bytes[w * 8 + i];
+        }
+        words[w] = value;
+    }
+}
+
+} // namespace
+
+EventFilter::EventFilter(const std::vector<Rule>& include, const std::vector<Rule>& exclude) {
+    for (const Rule& rule : include) {
+        include_.push_back(compile(rule));
+    }
+    for (const Rule& rule : exclude) {
+        exclude_.push_back(compile(rule));
+    }
+}
+
+EventFilter::CompiledRule
+EventFilter::compile(const Rule& rule) {
+    CompiledRule compiled;
+    compiled.events = rule.events;
+    compiled.msg_types = rule.msg_types;
+    compiled.min_prefix_length = rule.min_prefix_length;
+    compiled.max_prefix_length = rule.max_prefix_length;
+    compiled.subnet_ids = rule.subnet_ids;
+    std::sort(compiled.subnet_ids.begin(), compiled.subnet_ids.end());
+    compiled.subnet_ids.erase(std::unique(compiled.subnet_ids.begin(), compiled.subnet_ids.end()),
+                              compiled.subnet_ids.end());
+
+    for (const PrefixKey& prefix : rule.link_prefixes) {
+        LinkMatch link;
+        loadWords(prefix.addr, link.value);
+        for (int w = 0; w < 2; ++w) {
+            int bits = std::min(64, std::max(0, prefix.length - w * 64));
+            link.mask[w] = bits == 0 ? 0 : ~uint64_t(0) << (64 - bits);
+            link.value[w] &= link.mask[w];
+        }
+        compiled.links.push_back(link);
+    }
+    return compiled;
+}
+
+bool
+EventFilter::matchRule(const CompiledRule& rule, const Input& input) {
+    if (rule.events != 0 && !(rule.events & (1u << static_cast<unsigned>(input.type)))) {
+        return false;
+    }
+    if (rule.msg_types != 0 && (input.msg_type == 0 || input.msg_type >= 32 ||
+                                !(rule.msg_types & (1u << input.msg_type)))) {
+        return false;
+    }
+    if (input.prefix_length < rule.min_prefix_length || input.prefix_length > rule.max_prefix_length) {
+        return false;
+    }
+    if (!rule.subnet_ids.empty() &&
+        !std::binary_search(rule.subnet_ids.begin(), rule.subnet_ids.end(), input.subnet_id)) {
+        return false;
+    }
+    if (!rule.links.empty()) {
+        if (!input.link_addr || !input.link_addr->present) {
+            return false;
+        }
+        uint64_t addr[2];
+        loadWords(input.link_addr->bytes, addr);
+        bool inside = false;
+        for (const LinkMatch& link : rule.links) {
+            if ((addr[0] & link.mask[0]) == link.value[0] && (addr[1] & link.mask[1]) == link.value[1]) {
+                inside = true;
+                break;
+            }
+        }
+        if (!inside) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+EventFilter::matches(const Input& input) const {
+    if (!include_.empty()) {
+        bool included = false;
+        for (const CompiledRule& rule : include_) {
+            if (matchRule(rule, input)) {
+                included = true;
+                break;
+            }
+        }
+        if (!included) {
+            return false;
+        }
+    }
+    for (const CompiledRule& rule : exclude_) {
+        if (matchRule(rule, input)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+EventFilter::Input
+EventFilter::inputFor(const PdEvent& ev) {
+    Input input;
+    input.type = ev.type;
+    input.msg_type = ev.type == PdEventType::ASSIGNED ? ev.msg_type : 0;
+    input.subnet_id = ev.subnet_id;
+    input.prefix_length = ev.data.prefix.length;
+    input.link_addr = &ev.data.router_link_addr;
+    return input;
+}
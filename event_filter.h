@@ -0,0 +1,74 @@
+#ifndef EVENT_FILTER_H
+#define EVENT_FILTER_H
+
+#include "pd_address.h"
+#include "pd_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Include/exclude rules selecting the events one sink receives.
+//
+// Rules are compiled at load into masks and sorted arrays, and are tested
+// against values read straight from the lease and the packet, so a filtered
+// event costs a few comparisons and is dropped before anything is formatted
+// or allocated for it. An event passes when it matches any include rule (or
+// there are none) and no exclude rule.
+class EventFilter {
+public:
+    // The values a rule can test
+    struct Input {
+        PdEventType type;
+        uint8_t msg_type;            // Client message type, 0 without a packet
+        uint32_t subnet_id;
+        uint8_t prefix_length;
+        const Ip6Address* link_addr; // Relay link-address; may be absent or null
+    };
+
+    // One rule; the conditions that are set must all match
+    struct Rule {
+        uint8_t events{0};           // Bits 1 << PdEventType, 0 for any
+        uint32_t msg_types{0};       // Bits 1 << msg_type, 0 for any; never matches msg_type 0
+        std::vector<uint32_t> subnet_ids;  // Empty for any
+        uint8_t min_prefix_length{0};
+        uint8_t max_prefix_length{128};
+        std::vector<PrefixKey> link_prefixes;  // Relay link-address within one of them; empty for any
+    };
+
+    // Passes everything
+    EventFilter() = default;
+
+    EventFilter(const std::vector<Rule>& include, const std::vector<Rule>& exclude);
+
+    bool matches(const Input& input) const;
+
+    // Whether any rule is set
+    bool active() const { return !include_.empty() || !exclude_.empty(); }
+
+    // Input for an event built without packet context, e.g. one replayed from the spool
+    static Input inputFor(const PdEvent& ev);
+
+private:
+    struct LinkMatch {
+        uint64_t value[2];
+        uint64_t mask[2];
+    };
+
+    struct CompiledRule {
+        uint8_t events;
+        uint32_t msg_types;
+        uint8_t min_prefix_length;
+        uint8_t max_prefix_length;
+        std::vector<uint32_t> subnet_ids;  // Sorted
+        std::vector<LinkMatch> links;
+    };
+
+    static CompiledRule compile(const Rule& rule);
+    static bool matchRule(const CompiledRule& rule, const Input& input);
+
+    std::vector<CompiledRule> include_;
+    std::vector<CompiledRule> exclude_;
+};
+
+#endif // EVENT_FILTER_H
@@ -0,0 +1,134 @@
+#include "event_ring.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static size_t
+roundUpPow2(size_t n) {
+    size_t size = 2;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// A cell at position p is free for the producer that reserves p while its
+// sequence is p, and holds that producer's event once it is p + 1; popping
+// it makes it p + capacity, free for the next lap.
+EventRing::EventRing(size_t capacity)
+    : mask_(roundUpPow2(capacity) - 1), cells_(new Cell[mask_ + 1]),
+      eventfd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    for (size_t i = 0; i <= mask_; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+EventRing::~EventRing() {
+    if (eventfd_ >= 0) {
+        close(eventfd_);
+    }
+}
+
+bool
+EventRing::push(const PdEvent& event) {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence - pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            full_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->event = event;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in wait(): either the consumer sees the event
+    // before it sleeps, or this sees it sleeping.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_acq_rel)) {
+        signal();
+    }
+    return true;
+}
+
+size_t
+EventRing::popBatch(std::vector<PdEvent>& out, size_t max) {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    size_t n = 0;
+    for (; n < max; ++n, ++pos) {
+        Cell& cell = cells_[pos & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+        out.push_back(cell.event);
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+    }
+    head_.store(pos, std::memory_order_relaxed);
+    return n;
+}
+
+void
+EventRing::wait(std::chrono::milliseconds timeout) {
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    if (cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos + 1) {
+        sleeping_.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    if (eventfd_ >= 0) {
+        pollfd pfd{eventfd_, POLLIN, 0};
+        if (poll(&pfd, 1, static_cast<int>(timeout.count())) > 0) {
+            uint64_t count;
+            ssize_t n = read(eventfd_, &count, sizeof(count));
+            (void)n;
+        }
+    } else {
+        // No eventfd: fall back to polling the ring.
+        usleep(1000);
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+void
+EventRing::wake() {
+    signal();
+}
+
+void
+EventRing::signal() {
+    if (eventfd_ < 0) {
+        return;
+    }
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t one = 1;
+    ssize_t n = write(eventfd_, &one, sizeof(one));
+    (void)n;
+}
+
+size_t
+EventRing::size() const {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    return tail > head ? static_cast<size_t>(tail - head) : 0;
+}
+
+EventRing::Stats
+EventRing::getStats() const {
+    Stats stats;
+    stats.pushed = tail_.load(std::memory_order_relaxed);
+    stats.full = full_.load(std::memory_order_relaxed);
+    stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+    return stats;
+}
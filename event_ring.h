@@ -0,0 +1,75 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include "pd_types.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bounded lock-free ring carrying events from many producers to one consumer.
+//
+// Slots are preallocated and hold the fixed-size PdEvent by value, so a push
+// is a reservation on the shared tail, a copy into the slot and a release of
+// its sequence number; nothing is allocated and no lock is taken. A full ring
+// refuses the event instead of waiting. The consumer sleeps on an eventfd and
+// is only signalled when it is actually asleep, so a burst of pushes costs at
+// most one wakeup.
+class EventRing {
+public:
+    // Snapshot of the ring counters
+    struct Stats {
+        uint64_t pushed;
+        uint64_t full;               // Pushes refused because every slot was taken
+        uint64_t wakeups;            // Signals sent to a sleeping consumer
+    };
+
+    // capacity is rounded up to a power of two
+    explicit EventRing(size_t capacity);
+    ~EventRing();
+
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    // Any thread; false if the ring is full
+    bool push(const PdEvent& event);
+
+    // Consumer only: move up to max events to the end of out; returns how many
+    size_t popBatch(std::vector<PdEvent>& out, size_t max);
+
+    // Consumer only: sleep until an event is pushed, wake() is called or the
+    // timeout passes
+    void wait(std::chrono::milliseconds timeout);
+
+    // Wake the consumer, whether or not anything was pushed
+    void wake();
+
+    // Events pushed and not popped yet; approximate while producers are active
+    size_t size() const;
+
+    Stats getStats() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> sequence;
+        PdEvent event;
+    };
+
+    void signal();
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    int eventfd_{-1};
+
+    alignas(64) std::atomic<uint64_t> tail_{0};     // Next position to reserve
+    alignas(64) std::atomic<uint64_t> head_{0};     // Next position to pop; written by the consumer
+    std::atomic<bool> sleeping_{false};
+
+    std::atomic<uint64_t> full_{0};
+    std::atomic<uint64_t> wakeups_{0};
+};
+
+#endif // EVENT_RING_H
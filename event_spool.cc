@@ -0,0 +1,446 @@
+#include "event_spool.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'P', 'D', 'S', 'P', 'O', 'O', 'L', '1'};
+const uint32_t kVersion = 1;
+const size_t kHeaderBytes = 4096;
+const uint32_t kFree = 0;
+const uint32_t kPending = 0x444e4550;  // "PEND"
+
+// First page of the spool file
+struct SpoolHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+};
+
+// Address fields of a record, in storage order
+enum AddressField {
+    ADDR_PREFIX,
+    ADDR_CPE_LINK_LOCAL,
+    ADDR_ROUTER_IP,
+    ADDR_ROUTER_LINK_ADDR,
+    ADDR_PEER,
+    ADDR_COUNT
+};
+
+} // namespace
+
+// One spooled event; the DUID is kept in binary and addresses as 16 bytes each
+struct EventSpool::Record {
+    uint32_t state;                  // kFree or kPending, written last
+    uint32_t checksum;               // FNV-1a over everything after this field
+    uint64_t seq;
+    int64_t cltt;
+    uint32_t iaid;
+    uint32_t subnet_id;
+    uint32_t valid_lft;
+    uint32_t preferred_lft;
+    uint8_t type;
+    uint8_t msg_type;
+    uint8_t reply_type;
+    uint8_t prefix_length;
+    uint8_t duid_len;
+    uint8_t addr_present;            // Bit per AddressField
+    uint8_t reserved[2];
+    uint8_t addrs[ADDR_COUNT][16];
+    uint8_t duid[128];
+};
+
+static_assert(sizeof(EventSpool::Record) == 256, "spool records are 256 bytes");
+
+EventSpool::EventSpool(const std::string& path, size_t max_bytes, SyncPolicy policy,
+                       std::chrono::milliseconds sync_interval)
+    : path_(path), max_bytes_(max_bytes), policy_(policy), sync_interval_(sync_interval) {
+}
+
+EventSpool::~EventSpool() {
+    close();
+}
+
+EventSpool::Record*
+EventSpool::slot(uint64_t seq) const {
+    Record* records = reinterpret_cast<Record*>(base_ + kHeaderBytes);
+    return &records[(seq - 1) % capacity_];
+}
+
+uint32_t
+EventSpool::checksum(const Record& record) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&record) + offsetof(Record, seq);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(&record) + sizeof(Record);
+    uint32_t h = 2166136261u;
+    for (; p != end; ++p) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+PrefixKey
+EventSpool::recordKey(const Record& record) {
+    PrefixKey key;
+    std::memcpy(key.addr, record.addrs[ADDR_PREFIX], sizeof(key.addr));
+    key.length = record.prefix_length;
+    return key;
+}
+
+bool
+EventSpool::encode(const PdEvent& event, Record& record) {
+    std::memset(&record, 0, sizeof(record));
+    record.cltt = static_cast<int64_t>(event.cltt);
+    record.iaid = event.data.iaid;
+    record.subnet_id = event.subnet_id;
+    record.valid_lft = event.valid_lft;
+    record.preferred_lft = event.preferred_lft;
+    record.type = static_cast<uint8_t>(event.type);
+    record.msg_type = event.msg_type;
+    record.reply_type = event.reply_type;
+    if (event.data.prefix.length == 0 || event.data.prefix.length > 128) {
+        return false;
+    }
+    record.prefix_length = event.data.prefix.length;
+    std::memcpy(record.addrs[ADDR_PREFIX], event.data.prefix.addr, 16);
+    record.addr_present = static_cast<uint8_t>(1u << ADDR_PREFIX);
+
+    const Ip6Address* addrs[ADDR_COUNT] = {
+        nullptr, &event.data.cpe_link_local, &event.data.router_ip, &event.data.router_link_addr, &event.peer_addr
+    };
+    for (int i = ADDR_PREFIX + 1; i < ADDR_COUNT; ++i) {
+        if (addrs[i]->present) {
+            std::memcpy(record.addrs[i], addrs[i]->bytes, 16);
+            record.addr_present |= static_cast<uint8_t>(1u << i);
+        }
+    }
+
+    const Duid& duid = event.data.client_duid;
+    if (duid.length > sizeof(record.duid)) {
+        return false;
+    }
+    std::memcpy(record.duid, duid.bytes, duid.length);
+    record.duid_len = duid.length;
+    return true;
+}
+
+void
+EventSpool::decode(const Record& record, PdEvent& event) {
+    event = PdEvent();
+    event.type = static_cast<PdEventType>(record.type);
+    event.msg_type = record.msg_type;
+    event.reply_type = record.reply_type;
+    event.subnet_id = record.subnet_id;
+    event.valid_lft = record.valid_lft;
+    event.preferred_lft = record.preferred_lft;
+    event.cltt = static_cast<time_t>(record.cltt);
+    event.spool_seq = record.seq;
+    event.data.iaid = record.iaid;
+    event.data.prefix.length = record.prefix_length;
+    std::memcpy(event.data.prefix.addr, record.addrs[ADDR_PREFIX], 16);
+
+    Ip6Address* addrs[ADDR_COUNT] = {
+        nullptr, &event.data.cpe_link_local, &event.data.router_ip, &event.data.router_link_addr, &event.peer_addr
+    };
+    for (int i = ADDR_PREFIX + 1; i < ADDR_COUNT; ++i) {
+        if (record.addr_present & (1u << i)) {
+            addrs[i]->assign(record.addrs[i]);
+        }
+    }
+
+    event.data.client_duid.assign(record.duid, record.duid_len);
+}
+
+bool
+EventSpool::mapFile(size_t capacity, bool reset, std::string& error) {
+    size_t bytes = kHeaderBytes + capacity * sizeof(Record);
+    if (reset) {
+        if (ftruncate(fd_, 0) != 0 || ftruncate(fd_, static_cast<off_t>(bytes)) != 0) {
+            error = "cannot size spool file: " + std::string(strerror(errno));
+            return false;
+        }
+    }
+
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        error = "cannot map spool file: " + std::string(strerror(errno));
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(base);
+    mapped_bytes_ = bytes;
+    capacity_ = capacity;
+    pending_.reserve(capacity);      // At most one pending record per slot, so appends never rehash
+
+    if (reset) {
+        SpoolHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.record_size = sizeof(Record);
+        header.capacity = capacity;
+        std::memcpy(base_, &header, sizeof(header));
+    }
+    return true;
+}
+
+void
+EventSpool::unmapFile() {
+    if (base_) {
+        if (policy_ != SyncPolicy::NONE) {
+            msync(base_, mapped_bytes_, MS_SYNC);
+        }
+        munmap(base_, mapped_bytes_);
+        base_ = nullptr;
+        mapped_bytes_ = 0;
+    }
+}
+
+bool
+EventSpool::open(std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (max_bytes_ < kHeaderBytes + sizeof(Record)) {
+        error = "spool-max-size is too small";
+        return false;
+    }
+    size_t capacity = (max_bytes_ - kHeaderBytes) / sizeof(Record);
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        error = "cannot open spool file " + path_ + ": " + strerror(errno);
+        return false;
+    }
+
+    // Decide whether the existing file can be used as it is. A file written
+    // with another size is read record by record and carried over.
+    struct stat st;
+    bool reuse = false;
+    std::vector<Record> carried;
+    SpoolHeader header;
+    if (fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) >= kHeaderBytes &&
+        pread(fd_, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion &&
+        header.record_size == sizeof(Record) && header.capacity > 0 &&
+        static_cast<uint64_t>(st.st_size) >= kHeaderBytes + header.capacity * sizeof(Record)) {
+        if (header.capacity == capacity) {
+            reuse = true;
+        } else {
+            for (uint64_t i = 0; i < header.capacity; ++i) {
+                Record record;
+                off_t offset = static_cast<off_t>(kHeaderBytes + i * sizeof(Record));
+                if (pread(fd_, &record, sizeof(record), offset) == static_cast<ssize_t>(sizeof(record)) &&
+                    record.state == kPending && record.checksum == checksum(record)) {
+                    carried.push_back(record);
+                }
+            }
+        }
+    }
+
+    if (!mapFile(capacity, !reuse, error)) {
+        unmapFile();
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    // Carried records keep their order but may not all fit the new size.
+    std::sort(carried.begin(), carried.end(),
+              [](const Record& a, const Record& b) { return a.seq < b.seq; });
+    if (carried.size() > capacity_) {
+        overwritten_ += carried.size() - capacity_;
+        carried.erase(carried.begin(), carried.end() - capacity_);
+    }
+    for (size_t i = 0; i < carried.size(); ++i) {
+        Record record = carried[i];
+        record.seq = i + 1;
+        record.checksum = checksum(record);
+        std::memcpy(slot(record.seq), &record, sizeof(record));
+    }
+
+    // Collect the pending records; only the newest per prefix is replayed.
+    std::vector<Record*> pending;
+    Record* records = reinterpret_cast<Record*>(base_ + kHeaderBytes);
+    uint64_t max_seq = 0;
+    for (size_t i = 0; i < capacity_; ++i) {
+        Record& record = records[i];
+        max_seq = std::max(max_seq, record.seq);
+        if (record.state == kPending) {
+            if (record.checksum == checksum(record)) {
+                pending.push_back(&record);
+            } else {
+                record.state = kFree;
+            }
+        }
+    }
+    next_seq_ = max_seq + 1;
+
+    std::sort(pending.begin(), pending.end(),
+              [](const Record* a, const Record* b) { return a->seq < b->seq; });
+    for (Record* record : pending) {
+        auto it = pending_.find(recordKey(*record));
+        if (it != pending_.end()) {
+            slot(it->second)->state = kFree;
+            it->second = record->seq;
+        } else {
+            pending_.emplace(recordKey(*record), record->seq);
+        }
+    }
+    for (Record* record : pending) {
+        if (record->state == kPending) {
+            PdEvent event;
+            decode(*record, event);
+            backlog_.push_back(std::move(event));
+        }
+    }
+    replayed_ = backlog_.size();
+
+    if (policy_ == SyncPolicy::INTERVAL) {
+        stopping_ = false;
+        sync_thread_ = std::thread(&EventSpool::syncLoop, this);
+    }
+    return true;
+}
+
+std::vector<PdEvent>
+EventSpool::takeBacklog() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PdEvent> backlog;
+    backlog.swap(backlog_);
+    return backlog;
+}
+
+uint64_t
+EventSpool::append(const PdEvent& event) {
+    Record record;
+    bool encoded = encode(event, record);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!encoded) {
+        ++unspoolable_;
+        return 0;
+    }
+    if (!base_) {
+        return 0;
+    }
+
+    uint64_t seq = next_seq_++;
+    record.seq = seq;
+    record.checksum = checksum(record);
+    record.state = kFree;
+
+    Record* target = slot(seq);
+    if (target->state == kPending) {
+        ++overwritten_;
+        auto it = pending_.find(recordKey(*target));
+        if (it != pending_.end() && it->second == target->seq) {
+            pending_.erase(it);
+        }
+    }
+
+    PrefixKey key = recordKey(record);
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+        Record* older = slot(it->second);
+        if (older->seq == it->second) {
+            older->state = kFree;
+        }
+        it->second = seq;
+        ++superseded_;
+    } else {
+        pending_.emplace(key, seq);
+    }
+
+    // The record only counts once it is complete.
+    std::memcpy(target, &record, sizeof(record));
+    std::atomic_thread_fence(std::memory_order_release);
+    target->state = kPending;
+    ++appended_;
+    dirty_ = true;
+
+    if (policy_ == SyncPolicy::ALWAYS) {
+        static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t start = reinterpret_cast<uintptr_t>(target) & ~(page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(target) + sizeof(Record);
+        msync(reinterpret_cast<void*>(start), end - start, MS_SYNC);
+    }
+    return seq;
+}
+
+void
+EventSpool::complete(uint64_t seq) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!base_ || seq == 0) {
+        return;
+    }
+
+    Record* record = slot(seq);
+    if (record->seq != seq || record->state != kPending) {
+        return;
+    }
+    record->state = kFree;
+    auto it = pending_.find(recordKey(*record));
+    if (it != pending_.end() && it->second == seq) {
+        pending_.erase(it);
+    }
+    ++completed_;
+    dirty_ = true;
+}
+
+void
+EventSpool::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    sync_cv_.notify_all();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    unmapFile();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+EventSpool::Stats
+EventSpool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.appended = appended_;
+    stats.completed = completed_;
+    stats.superseded = superseded_;
+    stats.overwritten = overwritten_;
+    stats.unspoolable = unspoolable_;
+    stats.replayed = replayed_;
+    stats.pending = pending_.size();
+    stats.capacity = capacity_;
+    return stats;
+}
+
+// Background flush for SyncPolicy::INTERVAL
+void
+EventSpool::syncLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        sync_cv_.wait_for(lock, sync_interval_, [this] { return stopping_; });
+        if (dirty_ && base_) {
+            dirty_ = false;
+            uint8_t* base = base_;
+            size_t bytes = mapped_bytes_;
+            lock.unlock();
+            msync(base, bytes, MS_SYNC);
+            lock.lock();
+        }
+    }
+}
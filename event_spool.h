@@ -0,0 +1,114 @@
+#ifndef EVENT_SPOOL_H
+#define EVENT_SPOOL_H
+
+#include "pd_types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Write-ahead spool for events that have not been delivered yet.
+//
+// The spool file is a memory-mapped ring of fixed-size binary records behind
+// a one-page header. Every dispatched event is appended before it is queued,
+// and its record is released once delivery succeeded. Records still pending
+// when the library is unloaded, crashes or is restarted are handed back by
+// open() and replayed.
+//
+// Only the latest event per prefix is kept: appending an event releases the
+// older record of the same prefix, matching the coalescing in DispatchQueue.
+// When the ring is full the oldest slot is overwritten.
+class EventSpool {
+public:
+    enum class SyncPolicy {
+        NONE,                        // Leave write-back to the kernel (survives process crashes)
+        INTERVAL,                    // msync from a background thread every interval
+        ALWAYS                       // msync each appended record before returning
+    };
+
+    // Snapshot of the spool counters
+    struct Stats {
+        uint64_t appended;
+        uint64_t completed;
+        uint64_t superseded;         // Released by a newer event for the same prefix
+        uint64_t overwritten;        // Pending records lost to a full ring
+        uint64_t unspoolable;        // Events that do not fit the record format
+        uint64_t replayed;           // Pending records found by open()
+        size_t pending;
+        size_t capacity;
+    };
+
+    // On-disk record layout, defined in event_spool.cc
+    struct Record;
+
+    EventSpool(const std::string& path, size_t max_bytes, SyncPolicy policy,
+               std::chrono::milliseconds sync_interval);
+    ~EventSpool();
+
+    EventSpool(const EventSpool&) = delete;
+    EventSpool& operator=(const EventSpool&) = delete;
+
+    // Map the spool file, creating or resizing it as needed. Pending records
+    // are kept for takeBacklog(). Returns false with a message on failure.
+    bool open(std::string& error);
+
+    // Events found pending by open(), oldest first, with spool_seq set
+    std::vector<PdEvent> takeBacklog();
+
+    // Write an event ahead of delivery; returns its sequence number, 0 if not spooled
+    uint64_t append(const PdEvent& event);
+
+    // Release the record of a delivered event
+    void complete(uint64_t seq);
+
+    // Flush and unmap the file
+    void close();
+
+    Stats getStats() const;
+
+private:
+    Record* slot(uint64_t seq) const;
+    static bool encode(const PdEvent& event, Record& record);
+    static void decode(const Record& record, PdEvent& event);
+    static uint32_t checksum(const Record& record);
+    static PrefixKey recordKey(const Record& record);
+
+    bool mapFile(size_t capacity, bool reset, std::string& error);
+    void unmapFile();
+    void syncLoop();
+
+    const std::string path_;
+    const size_t max_bytes_;
+    const SyncPolicy policy_;
+    const std::chrono::milliseconds sync_interval_;
+
+    mutable std::mutex mutex_;
+    int fd_{-1};
+    uint8_t* base_{nullptr};
+    size_t mapped_bytes_{0};
+    size_t capacity_{0};
+    uint64_t next_seq_{1};
+    std::unordered_map<PrefixKey, uint64_t, PrefixKeyHash> pending_;  // Prefix -> latest pending seq
+    std::vector<PdEvent> backlog_;
+    bool dirty_{false};
+
+    std::thread sync_thread_;
+    std::condition_variable sync_cv_;
+    bool stopping_{false};
+
+    uint64_t appended_{0};
+    uint64_t completed_{0};
+    uint64_t superseded_{0};
+    uint64_t overwritten_{0};
+    uint64_t unspoolable_{0};
+    uint64_t replayed_{0};
+};
+
+#endif // EVENT_SPOOL_H
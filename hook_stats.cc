@@ -0,0 +1,103 @@
+#include "hook_stats.h"
+
+#include <cmath>
+
+namespace {
+
+std::atomic<size_t> g_next_shard{0};
+
+} // namespace
+
+size_t
+statShard() {
+    thread_local size_t shard = g_next_shard.fetch_add(1, std::memory_order_relaxed) % kStatShards;
+    return shard;
+}
+
+uint64_t
+ShardedCounter::value() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t
+LatencyHistogram::bucketIndex(uint64_t usec) {
+    if (usec < kSubBuckets) {
+        return static_cast<size_t>(usec);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(usec));
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    size_t sub = static_cast<size_t>(usec >> (exponent - 4)) - kSubBuckets;
+    return (exponent - 3) * kSubBuckets + sub;
+}
+
+uint64_t
+LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    size_t exponent = index / kSubBuckets + 3;
+    uint64_t sub = index % kSubBuckets;
+    uint64_t width = uint64_t(1) << (exponent - 4);
+    return (kSubBuckets + sub) * width + width - 1;
+}
+
+void
+LatencyHistogram::record(uint64_t usec) {
+    Shard& shard = shards_[statShard()];
+    shard.buckets[bucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(usec, std::memory_order_relaxed);
+
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (usec > max && !shard.max.compare_exchange_weak(max, usec, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot
+LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    snap.count = 0;
+    snap.sum_us = 0;
+    snap.max_us = 0;
+    snap.buckets.assign(kBuckets, 0);
+
+    for (const Shard& shard : shards_) {
+        snap.sum_us += shard.sum.load(std::memory_order_relaxed);
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        if (max > snap.max_us) {
+            snap.max_us = max;
+        }
+        for (size_t i = 0; i < kBuckets; ++i) {
+            snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    for (uint64_t n : snap.buckets) {
+        snap.count += n;
+    }
+    return snap;
+}
+
+uint64_t
+LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * count));
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < max_us ? bound : max_us;
+        }
+    }
+    return max_us;
+}
@@ -0,0 +1,97 @@
+#ifndef HOOK_STATS_H
+#define HOOK_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Instrumentation that threads update without contending with each other:
+// each thread is given one of kStatShards cache-line sized shards, and
+// readers add the shards up.
+
+const size_t kStatShards = 16;
+
+// Shard of the calling thread
+size_t statShard();
+
+// Event counter split across shards
+class ShardedCounter {
+public:
+    void add(uint64_t n = 1) {
+        shards_[statShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Shard shards_[kStatShards];
+};
+
+// Latency histogram in microseconds, log-linear like HDR histograms: values
+// below 16 are exact, larger ones fall into 16 sub-buckets per power of two,
+// so a reported percentile is within 1/16 of the recorded value.
+class LatencyHistogram {
+public:
+    static const size_t kSubBuckets = 16;
+    static const size_t kMaxExponent = 35;       // About 19 hours
+    static const size_t kBuckets = (kMaxExponent - 2) * kSubBuckets;
+
+    // Sum of all shards at one point in time
+    struct Snapshot {
+        uint64_t count;
+        uint64_t sum_us;
+        uint64_t max_us;
+        std::vector<uint64_t> buckets;
+
+        // Upper bound of the bucket holding the given percentile, 0 if empty
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum_us) / count : 0.0; }
+    };
+
+    void record(uint64_t usec);
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        record(us > 0 ? static_cast<uint64_t>(us) : 0);
+    }
+
+    Snapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t usec);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+    };
+
+    Shard shards_[kStatShards];
+};
+
+// Records its own lifetime into a histogram
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedLatency() {
+        histogram_.record(std::chrono::steady_clock::now() - start_);
+    }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // HOOK_STATS_H
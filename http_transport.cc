@@ -0,0 +1,134 @@
+#include "http_transport.h"
+
+#include <utility>
+
+namespace {
+
+size_t
+appendBody(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+size_t
+feedSink(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<BodySink*>(userp)->feed(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+size_t
+discardBody(void*, size_t size, size_t nmemb, void*) {
+    return size * nmemb;
+}
+
+} // namespace
+
+void
+configureCurlHandle(CURL* curl, const HttpRequest& request, std::string* response_body) {
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request.headers);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request.timeout_ms);
+
+    if (!request.verify_tls) {
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+
+    if (request.sink) {
+        request.sink->reset();
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, feedSink);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, request.sink.get());
+    } else if (request.keep_body && response_body) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendBody);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_body);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardBody);
+    }
+
+    if (request.method == "POST") {
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+    } else if (request.method == "GET") {
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+    }
+}
+
+void
+readCurlTimings(CURL* curl, HttpTimings& timings) {
+    curl_off_t value = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &value) == CURLE_OK) {
+        timings.namelookup_us = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &value) == CURLE_OK) {
+        timings.connect_us = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &value) == CURLE_OK) {
+        timings.appconnect_us = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &value) == CURLE_OK) {
+        timings.pretransfer_us = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &value) == CURLE_OK) {
+        timings.starttransfer_us = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &value) == CURLE_OK) {
+        timings.total_us = value;
+    }
+}
+
+void
+EasyTransport::submit(HttpRequest&& request, HttpCompletion done) {
+    HttpResponse response;
+
+    CurlPool::Handle handle = pool_.acquire();
+    if (!handle) {
+        response.code = CURLE_FAILED_INIT;
+        done(response);
+        return;
+    }
+
+    configureCurlHandle(handle.get(), request, &response.body);
+    response.code = curl_easy_perform(handle.get());
+    curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &response.status);
+    if (request.trace.sampled()) {
+        readCurlTimings(handle.get(), response.timings);
+    }
+
+    // Give the handle back before the continuation issues its next request.
+    handle = CurlPool::Handle();
+    done(response);
+}
+
+bool
+InflightLimiter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return closed_ || available_ > 0; });
+    if (closed_) {
+        return false;
+    }
+    --available_;
+    return true;
+}
+
+void
+InflightLimiter::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++available_;
+    }
+    cv_.notify_one();
+}
+
+void
+InflightLimiter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
@@ -0,0 +1,116 @@
+#ifndef HTTP_TRANSPORT_H
+#define HTTP_TRANSPORT_H
+
+#include "curl_pool.h"
+#include "trace_context.h"
+
+#include <curl/curl.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Consumer of a response body as it arrives
+class BodySink {
+public:
+    virtual ~BodySink() = default;
+
+    // Called before each transfer, including retries
+    virtual void reset() = 0;
+    virtual void feed(const char* data, size_t len) = 0;
+};
+
+// One outbound HTTP request
+struct HttpRequest {
+    std::string method;              // GET, POST or PATCH
+    std::string url;
+    std::string body;
+    curl_slist* headers{nullptr};    // Owned by the CurlPool
+    long timeout_ms{2000};
+    bool verify_tls{true};
+    bool keep_body{true};            // False: response body is discarded
+    bool idempotent{true};           // False: only retried when it never reached the server
+    std::shared_ptr<BodySink> sink;  // Receives the body instead of HttpResponse::body
+    TraceContext trace;              // Sampled requests get HttpResponse::timings
+};
+
+// Phases of a transfer from curl, in microseconds since it started; each is
+// cumulative, and 0 for a phase that did not happen (e.g. connect on a reused connection)
+struct HttpTimings {
+    int64_t namelookup_us{0};
+    int64_t connect_us{0};
+    int64_t appconnect_us{0};        // TLS handshake done
+    int64_t pretransfer_us{0};
+    int64_t starttransfer_us{0};     // First response byte
+    int64_t total_us{0};
+};
+
+// Outcome of an HTTP request
+struct HttpResponse {
+    CURLcode code{CURLE_OK};
+    long status{0};                  // HTTP status, 0 if no response was received
+    std::string body;
+    bool rejected{false};            // Refused locally without being sent (circuit breaker open)
+    HttpTimings timings;             // Only filled in for traced requests
+
+    bool ok() const { return code == CURLE_OK; }
+};
+
+typedef std::function<void(const HttpResponse&)> HttpCompletion;
+
+// Request execution engine.
+//
+// Every request completes exactly once through its completion callback. A
+// blocking transport calls it before submit() returns; an asynchronous one
+// calls it later from its own thread, and the callback may submit follow-up
+// requests from there.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+
+    virtual void submit(HttpRequest&& request, HttpCompletion done) = 0;
+
+    // Abort outstanding requests (completing them with an error) and stop
+    virtual void stop() {}
+};
+
+// Apply a request to an easy handle; the handle must outlive the transfer
+void configureCurlHandle(CURL* curl, const HttpRequest& request, std::string* response_body);
+
+// Read the phase timings of a finished transfer
+void readCurlTimings(CURL* curl, HttpTimings& timings);
+
+// Blocking transport: runs each request with curl_easy_perform on the calling thread
+class EasyTransport : public HttpTransport {
+public:
+    explicit EasyTransport(CurlPool& pool) : pool_(pool) {}
+
+    void submit(HttpRequest&& request, HttpCompletion done) override;
+
+private:
+    CurlPool& pool_;
+};
+
+// Counting limit on concurrently outstanding work
+class InflightLimiter {
+public:
+    explicit InflightLimiter(size_t capacity) : available_(capacity > 0 ? capacity : 1) {}
+
+    // Wait for a free slot; returns false once the limiter is closed
+    bool acquire();
+    void release();
+
+    // Wake all waiters and refuse further acquisitions
+    void close();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t available_;
+    bool closed_{false};
+};
+
+#endif // HTTP_TRANSPORT_H
@@ -0,0 +1,167 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+// Minimal streaming JSON writer for payloads of a known shape.
+//
+// Appends straight into a caller-owned string, so a reused buffer costs no
+// allocations once it has grown to the payload size. Keys are string
+// literals and are written as they are; string values are escaped. No
+// structure is validated: callers emit well-formed sequences.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void beginObject() {
+        separator();
+        out_.push_back('{');
+        need_comma_ = false;
+    }
+
+    void endObject() {
+        out_.push_back('}');
+        need_comma_ = true;
+    }
+
+    void beginArray() {
+        separator();
+        out_.push_back('[');
+        need_comma_ = false;
+    }
+
+    void endArray() {
+        out_.push_back(']');
+        need_comma_ = true;
+    }
+
+    // Object key; the length of the literal is known at compile time
+    template <size_t N>
+    void key(const char (&name)[N]) {
+        separator();
+        out_.push_back('"');
+        out_.append(name, N - 1);
+        out_.append("\":", 2);
+        need_comma_ = false;
+    }
+
+    void value(const std::string& s) {
+        separator();
+        writeString(s.data(), s.size());
+        need_comma_ = true;
+    }
+
+    void value(const char* s) {
+        separator();
+        writeString(s, std::char_traits<char>::length(s));
+        need_comma_ = true;
+    }
+
+    void value(bool b) {
+        separator();
+        if (b) {
+            out_.append("true", 4);
+        } else {
+            out_.append("false", 5);
+        }
+        need_comma_ = true;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+    value(T v) {
+        separator();
+        char buf[24];
+        std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, r.ptr - buf);
+        need_comma_ = true;
+    }
+
+    // String value assembled from several pieces, e.g. "2001:db8::/56"
+    void beginString() {
+        separator();
+        out_.push_back('"');
+    }
+
+    void appendString(const std::string& s) {
+        escape(s.data(), s.size());
+    }
+
+    void appendString(const char* s) {
+        escape(s, std::char_traits<char>::length(s));
+    }
+
+    // Characters known to need no escaping, e.g. formatted addresses
+    void appendPlain(const char* s, size_t len) {
+        out_.append(s, len);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+    appendString(T v) {
+        char buf[24];
+        std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, r.ptr - buf);
+    }
+
+    void endString() {
+        out_.push_back('"');
+        need_comma_ = true;
+    }
+
+    // Append an already serialized JSON value
+    void raw(const char* json, size_t len) {
+        separator();
+        out_.append(json, len);
+        need_comma_ = true;
+    }
+
+private:
+    void separator() {
+        if (need_comma_) {
+            out_.push_back(',');
+        }
+    }
+
+    void writeString(const char* s, size_t len) {
+        out_.push_back('"');
+        escape(s, len);
+        out_.push_back('"');
+    }
+
+    void escape(const char* s, size_t len) {
+        static const char hex[] = "0123456789abcdef";
+        size_t run = 0;
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            out_.append(s + run, i - run);
+            run = i + 1;
+            switch (c) {
+            case '"': out_.append("\\\"", 2); break;
+            case '\\': out_.append("\\\\", 2); break;
+            case '\b': out_.append("\\b", 2); break;
+            case '\f': out_.append("\\f", 2); break;
+            case '\n': out_.append("\\n", 2); break;
+            case '\r': out_.append("\\r", 2); break;
+            case '\t': out_.append("\\t", 2); break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f]};
+                out_.append(esc, sizeof(esc));
+                break;
+            }
+            }
+        }
+        out_.append(s + run, len - run);
+    }
+
+    std::string& out_;
+    bool need_comma_{false};
+};
+
+#endif // JSON_WRITER_H
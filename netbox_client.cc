@@ -1,289 +1,787 @@
 #include "netbox_client.h"
-#include <curl/curl.h>
-#include <jsoncpp/json/json.h>
-#include <iostream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <ctime>
-#include <iomanip>
 
-// Forward declarations for Kea types
-namespace isc {
-namespace dhcp {
-    class Lease6;
-    typedef std::shared_ptr<Lease6> Lease6Ptr;
-}
-}
+#include "error_tracker.h"
+#include "pd_log.h"
 
-// Forward declarations (defined in pd_webhook.cc)
-enum class ErrorCode;
-struct WebhookConfig;
-extern WebhookConfig g_cfg;
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <future>
+#include <utility>
 
-// Error logging macro
-#define ERROR_LOG(msg) do { \
-    g_cfg.last_error_msg = msg; \
-    std::cerr << "[ERROR] " << msg << std::endl; \
-} while(0)
+const char* const kNetBoxOpNames[kNetBoxOps] = {"find", "create", "update", "deprecate"};
 
-// Debug logging macro
-#define DEBUG_LOG(msg) do { if (g_cfg.debug) std::cout << msg << std::endl; } while(0)
+// True for a 2xx answer whose body was well-formed JSON
+static bool
+netboxSucceeded(const HttpResponse& response, const NetBoxResponse& parsed) {
+    return response.ok() && response.status >= 200 && response.status < 300 && parsed.valid();
+}
 
-// Hex encode helper for DUID, etc.
 static std::string
-toHex(const std::vector<uint8_t>& data) {
-    std::ostringstream os;
-    os << std::hex << std::setfill('0');
-    for (auto byte : data) {
-        os << std::setw(2) << static_cast<int>(byte);
+apiUrl(const std::string& url) {
+    std::string full_url = url;
+    if (full_url.empty() || full_url.back() != '/') {
+        full_url += "/";
     }
-    return os.str();
+    return full_url + "api/";
 }
 
-// Safe integer parsing
-static int safeParseInt(const std::string& str, int default_val = -1) {
-    try {
-        size_t pos = 0;
-        int val = std::stoi(str, &pos);
-        if (pos != str.size()) {
-            return default_val;  // Trailing characters
-        }
-        return val;
-    } catch (const std::exception& e) {
-        DEBUG_LOG("PD_WEBHOOK: Failed to parse int: " << e.what());
-        return default_val;
+HttpNetBoxClient::HttpNetBoxClient(const Config& config, Sender send, ErrorTracker* errors,
+                                   LatencyHistogram* latency)
+    : config_(config), api_url_(apiUrl(config.url)), send_(std::move(send)), errors_(errors),
+      latency_(latency) {
+    if (config_.prefix_table) {
+        cache_.reset(new PrefixIdCache(*config_.prefix_table, std::chrono::seconds(config_.prefix_cache_ttl)));
+    }
+
+    if (config_.bulk_max_items > 1) {
+        write_batcher_.reset(new Batcher<PendingWrite>(config_.bulk_max_items,
+                                                       std::chrono::milliseconds(config_.bulk_max_delay_ms),
+                                                       [this](std::vector<PendingWrite>&& batch) {
+            flushWrites(std::move(batch));
+        }));
+        write_batcher_->start();
+    }
+
+    if (config_.lookup_max_items > 1) {
+        lookup_batcher_.reset(new Batcher<PendingLookup>(config_.lookup_max_items,
+                                                         std::chrono::milliseconds(config_.lookup_max_delay_ms),
+                                                         [this](std::vector<PendingLookup>&& batch) {
+            flushLookups(std::move(batch));
+        }));
+        lookup_batcher_->start();
     }
 }
 
-// NetBox client implementation
-class NetBoxClient : public INetBoxClient {
-public:
-    NetBoxClient() = default;
-    ~NetBoxClient() override = default;
+HttpNetBoxClient::~HttpNetBoxClient() {
+    flush();
+}
 
-    // HTTP request methods
-    std::string postWebhook(const std::string& payload) override {
-        if (!g_cfg.enabled || g_cfg.url.empty()) {
-            return "";
+// Make HTTP request to NetBox API; done receives the response once it completes
+void
+HttpNetBoxClient::request(const std::string& method, const std::string& endpoint, const std::string& data,
+                          LatencyHistogram* latency, NetBoxCompletion done) {
+    auto parsed = std::make_shared<NetBoxResponse>();
+
+    HttpRequest request;
+    request.method = method;
+    request.url = api_url_ + endpoint;
+    request.body = data;
+    request.headers = config_.headers;
+    request.timeout_ms = config_.timeout_ms;
+    request.verify_tls = false;
+    request.idempotent = method != "POST";   // A repeated POST could create the prefix twice
+    request.sink = parsed;
+
+    auto start = std::chrono::steady_clock::now();
+    ErrorTracker* errors = errors_;
+    const char* name = config_.endpoint;
+    send_(std::move(request), [done, parsed, latency, start, errors, name](const HttpResponse& response) {
+        if (latency && !response.rejected) {
+            latency->record(std::chrono::steady_clock::now() - start);
         }
+        if (response.rejected) {
+            PD_LOG_DEBUG("PD_WEBHOOK: NetBox request skipped, circuit breaker open");
+        } else if (!response.ok()) {
+            PD_LOG_ERROR("HTTP request failed: " + std::string(curl_easy_strerror(response.code)));
+        } else if (response.status >= 400 && !parsed->detail().empty()) {
+            PD_LOG_DEBUG("PD_WEBHOOK: NetBox returned HTTP " << response.status << ": " << parsed->detail());
+        } else if (!parsed->valid() && response.status >= 200 && response.status < 300 && errors) {
+            errors->record(ErrorCode::JSON_PARSE_FAILED, name);
+        }
+        done(response, *parsed);
+    });
+}
 
-        DEBUG_LOG("PD_WEBHOOK: Sending webhook payload: " << payload);
-
-        std::string response = netboxHttpRequest("POST", g_cfg.url, payload);
+LatencyHistogram*
+HttpNetBoxClient::latency(NetBoxOp op) const {
+    return latency_ ? &latency_[static_cast<size_t>(op)] : nullptr;
+}
 
-        if (response.empty()) {
-            ERROR_LOG("PD_WEBHOOK: Webhook request failed");
-        } else {
-            DEBUG_LOG("PD_WEBHOOK: Webhook response: " << response);
+// Look up a single prefix in NetBox and pass its ID to done
+void
+HttpNetBoxClient::lookupPrefixId(const PrefixKey& prefix, PrefixIdCallback done) {
+    std::string search_url = "ipam/prefixes/?prefix=" + prefix.toText();
+    request("GET", search_url, "", latency(NetBoxOp::FIND),
+            [this, prefix, done](const HttpResponse& response, const NetBoxResponse& parsed) {
+        if (!response.ok()) {
+            done(0);
+            return;
         }
 
-        return response;
-    }
+        if (!parsed.valid() || !parsed.hasResults()) {
+            PD_LOG_DEBUG("PD_WEBHOOK: Failed to parse NetBox response (HTTP " << response.status << ")");
+            done(0);
+            return;
+        }
 
-    std::string netboxHttpRequest(const std::string& method, const std::string& endpoint, const std::string& payload) override {
-        if (!g_cfg.netbox_enabled) {
-            return "";
+        if (parsed.items().empty()) {
+            done(-1);
+            return;
         }
 
-        CURL* curl = curl_easy_init();
-        if (!curl) {
-            ERROR_LOG("Failed to initialize CURL");
-            return "";
+        int id = parsed.items().front().id;
+        if (id <= 0) {
+            done(0);
+            return;
         }
+        if (cache_) {
+            cache_->put(prefix, id);
+        }
+        done(id);
+    });
+}
 
-        std::string url = g_cfg.netbox_url + endpoint;
-        std::string response;
+// Batcher flush: query all distinct prefixes with repeated prefix= filters and
+// hand each waiter the first match for its prefix. Prefixes missing from a
+// truncated answer, or every prefix when the query fails, are looked up on their own.
+void
+HttpNetBoxClient::flushLookups(std::vector<PendingLookup>&& batch) {
+    if (batch.size() == 1) {
+        lookupPrefixId(batch[0].prefix, batch[0].done);
+        return;
+    }
 
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, g_cfg.timeout_ms);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    typedef std::unordered_map<std::string, std::vector<PendingLookup>> Waiters;
+    auto waiters = std::make_shared<Waiters>();
+    std::string filters;
+    for (PendingLookup& lookup : batch) {
+        std::string key = lookup.prefix.toText();
+        std::vector<PendingLookup>& list = (*waiters)[key];
+        if (list.empty()) {
+            filters += "&prefix=" + key;
+        }
+        list.push_back(std::move(lookup));
+    }
 
-        // Set headers
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, ("Authorization: Token " + g_cfg.netbox_token).c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    auto retry = [this](const std::vector<PendingLookup>& list) {
+        lookupPrefixId(list.front().prefix, [list](int id) {
+            for (const PendingLookup& lookup : list) {
+                lookup.done(id);
+            }
+        });
+    };
+
+    std::string search_url = "ipam/prefixes/?limit=" + std::to_string(waiters->size()) + filters;
+    PD_LOG_DEBUG("PD_WEBHOOK: bulk lookup of " << waiters->size() << " prefixes");
+    request("GET", search_url, "", latency(NetBoxOp::FIND),
+            [this, waiters, retry](const HttpResponse& response, const NetBoxResponse& parsed) {
+        if (!netboxSucceeded(response, parsed) || !parsed.hasResults()) {
+            PD_LOG_DEBUG("PD_WEBHOOK: bulk lookup failed (HTTP " << response.status << "), retrying "
+                         << waiters->size() << " prefixes individually");
+            for (const auto& entry : *waiters) {
+                retry(entry.second);
+            }
+            return;
+        }
 
-        if (!payload.empty()) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
+        for (const NetBoxResponse::Item& result : parsed.items()) {
+            auto it = waiters->find(result.prefix);
+            int id = result.id;
+            if (it == waiters->end() || id <= 0) {
+                continue;
+            }
+            if (cache_) {
+                cache_->put(it->second.front().prefix, id);
+            }
+            for (const PendingLookup& lookup : it->second) {
+                lookup.done(id);
+            }
+            waiters->erase(it);
         }
 
-        CURLcode res = curl_easy_perform(curl);
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+        // Whatever is left was not found, unless the answer stopped at a page boundary.
+        bool truncated = parsed.hasNext();
+        for (const auto& entry : *waiters) {
+            if (truncated) {
+                retry(entry.second);
+            } else {
+                for (const PendingLookup& lookup : entry.second) {
+                    lookup.done(-1);
+                }
+            }
+        }
+    });
+}
 
-        if (res != CURLE_OK) {
-            ERROR_LOG("HTTP request failed: " + std::string(curl_easy_strerror(res)));
-            return "";
+// Check if prefix exists in NetBox and pass its ID to done
+void
+HttpNetBoxClient::findPrefixId(const PrefixKey& prefix, PrefixIdCallback done) {
+    if (cache_) {
+        int cached_id = cache_->get(prefix);
+        if (cached_id > 0) {
+            done(cached_id);
+            return;
         }
+    }
 
-        return response;
+    if (lookup_batcher_) {
+        lookup_batcher_->add(PendingLookup{prefix, done});
+        return;
     }
+    lookupPrefixId(prefix, done);
+}
 
-    // NetBox API operations
-    int findPrefixId(const std::string& prefix, int prefix_length) override {
-        std::string search_url = "ipam/prefixes/?prefix=" + prefix + "/" + std::to_string(prefix_length);
-        std::string response = netboxHttpRequest("GET", search_url, "");
+// Page through the prefixes in NetBox. Requests are issued one page at a time
+// and waited for, so this blocks the calling thread; it gives up on the first
+// failed page or when stop is set.
+bool
+HttpNetBoxClient::listPrefixes(const std::string& filter, size_t page_size, const std::atomic<bool>& stop,
+                               std::vector<NetBoxResponse::Item>& prefixes) {
+    size_t offset = 0;
+    for (;;) {
+        if (stop.load(std::memory_order_relaxed)) {
+            return false;
+        }
 
-        if (response.empty()) {
-            return -1;
+        std::string url = "ipam/prefixes/?limit=" + std::to_string(page_size) + "&offset=" + std::to_string(offset);
+        if (!filter.empty()) {
+            url += "&" + filter;
         }
 
-        Json::Value root;
-        Json::CharReaderBuilder builder;
-        Json::CharReader* reader = builder.newCharReader();
-        std::string errors;
-        bool success = reader->parse(response.c_str(), response.c_str() + response.size(), &root, &errors);
-        delete reader;
+        // The parser belongs to the request, so copy the page out of it.
+        std::promise<bool> page;
+        std::future<bool> pending = page.get_future();
+        NetBoxResponse parsed;
+        long status = 0;
+        request("GET", url, "", nullptr, [&page, &parsed, &status](const HttpResponse& response,
+                                                                  const NetBoxResponse& result) {
+            status = response.status;
+            bool success = netboxSucceeded(response, result) && result.hasResults();
+            if (success) {
+                parsed = result;
+            }
+            page.set_value(success);
+        });
+        if (!pending.get()) {
+            if (errors_) {
+                errors_->record(ErrorCode::INVALID_RESPONSE, config_.endpoint);
+            }
+            PD_LOG_ERROR("PD_WEBHOOK: Prefix listing stopped at offset " + std::to_string(offset) +
+                         " (HTTP " + std::to_string(status) + ")");
+            return false;
+        }
 
-        if (!success || !root.isMember("results") || !root["results"].isArray()) {
-            DEBUG_LOG("PD_WEBHOOK: Failed to parse NetBox response: " << errors);
-            return -1;
+        prefixes.insert(prefixes.end(), parsed.items().begin(), parsed.items().end());
+        offset += parsed.items().size();
+        if (parsed.items().empty() || !parsed.hasNext()) {
+            return true;
         }
+    }
+}
+
+// Fill the ID cache from the PD-managed prefixes; a partial listing still helps
+void
+HttpNetBoxClient::warmCache(const std::atomic<bool>& stop) {
+    if (!cache_) {
+        return;
+    }
 
-        if (root["results"].size() == 0) {
-            return -1;
+    std::vector<NetBoxResponse::Item> prefixes;
+    listPrefixes(config_.warmup_filter, config_.warmup_page_size, stop, prefixes);
+
+    size_t loaded = 0;
+    for (const NetBoxResponse::Item& result : prefixes) {
+        PrefixKey key;
+        if (result.id <= 0 || !PrefixKey::fromCidr(result.prefix, key)) {
+            continue;
         }
+        cache_->put(key, result.id);
+        ++loaded;
+    }
+    PD_LOG_INFO("PD_WEBHOOK: Cache warm-up loaded " << loaded << " prefix IDs");
+}
 
-        return safeParseInt(root["results"][0]["id"].asString(), -1);
+// Refresh the cache entry for a written prefix, or drop it on 404, then pass the result on
+void
+HttpNetBoxClient::finishWrite(const PrefixKey& prefix, const WriteResult& result, const ResultCallback& done) {
+    if (cache_) {
+        if (result.not_found) {
+            cache_->invalidate(prefix);
+        } else if (result.ok) {
+            cache_->put(prefix, result.id);
+        }
     }
+    done(result);
+}
 
-    bool createPrefix(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) override {
-        // Calculate expiration timestamp (current time + valid lifetime)
-        time_t now = time(nullptr);
-        time_t expires_at = now + valid_lft;
+// Completion for create/update requests: NetBox echoes the object including its id.
+HttpNetBoxClient::NetBoxCompletion
+HttpNetBoxClient::writeResult(const PrefixKey& prefix, ResultCallback done) {
+    return [this, prefix, done](const HttpResponse& response, const NetBoxResponse& parsed) {
+        WriteResult result{false, response.ok() && response.status == 404, -1};
 
-        Json::Value payload;
-        payload["prefix"] = data.prefix + "/" + std::to_string(data.prefix_length);
-        payload["status"] = "active";
-        payload["description"] = "DHCPv6 PD assignment - IAID: " + std::to_string(data.iaid);
+        if (response.ok() && parsed.valid()) {
+            result.id = parsed.id();
+            result.ok = result.id > 0;
+        }
+        finishWrite(prefix, result, done);
+    };
+}
 
-        Json::Value custom_fields;
-        custom_fields["dhcpv6_client_duid"] = data.client_duid;
-        custom_fields["dhcpv6_iaid"] = static_cast<int>(data.iaid);
-        custom_fields["dhcpv6_cpe_link_local"] = data.cpe_link_local;
-        custom_fields["dhcpv6_router_ip"] = data.router_ip;
-        custom_fields["dhcpv6_router_link_addr"] = data.router_link_addr;
-        custom_fields["dhcpv6_leasetime"] = static_cast<int>(expires_at);
-        payload["custom_fields"] = custom_fields;
+// Send one write as its own request
+void
+HttpNetBoxClient::sendSingleWrite(const PendingWrite& write) {
+    if (write.create) {
+        request("POST", "ipam/prefixes/", write.object, latency(write.op),
+                writeResult(write.prefix, write.done));
+    } else {
+        std::string endpoint = "ipam/prefixes/" + std::to_string(write.prefix_id) + "/";
+        request("PATCH", endpoint, write.object, latency(write.op),
+                writeResult(write.prefix, write.done));
+    }
+}
 
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::string payload_str = Json::writeString(builder, payload);
-        DEBUG_LOG("PD_WEBHOOK: createPrefix payload: " << payload_str);
+// Send a group of creates (POST) or updates (PATCH) as one list on ipam/prefixes/.
+// NetBox answers with the objects in request order; if the request fails or the
+// answer does not line up, every update is retried on its own so that a single
+// bad item (e.g. a deleted prefix ID) only fails itself. Creates are only resent
+// after a 4xx, which NetBox answers without creating any of them; otherwise
+// some may exist already, see recoverCreates().
+void
+HttpNetBoxClient::sendBulkWrites(bool create, std::shared_ptr<std::vector<PendingWrite>> group) {
+    if (group->size() == 1) {
+        sendSingleWrite(group->front());
+        return;
+    }
 
-        std::string response = netboxHttpRequest("POST", "ipam/prefixes/", payload_str);
+    // The objects are already serialized; updates get "id" spliced in after the brace.
+    size_t size = 2;
+    for (const PendingWrite& write : *group) {
+        size += write.object.size() + 24;
+    }
+    std::string payload_str;
+    payload_str.reserve(size);
+    payload_str.push_back('[');
+    for (const PendingWrite& write : *group) {
+        if (payload_str.size() > 1) {
+            payload_str.push_back(',');
+        }
+        if (write.create || write.object.size() < 2) {
+            payload_str.append(write.object);
+            continue;
+        }
+        payload_str.append("{\"id\":");
+        payload_str.append(std::to_string(write.prefix_id));
+        if (write.object.size() > 2) {
+            payload_str.push_back(',');
+        }
+        payload_str.append(write.object, 1, std::string::npos);
+    }
+    payload_str.push_back(']');
+    PD_LOG_DEBUG("PD_WEBHOOK: bulk " << (create ? "create" : "update") << " of " << group->size() << " prefixes");
+
+    // Each prefix in the group is timed under its own operation.
+    auto start = std::chrono::steady_clock::now();
+    request(create ? "POST" : "PATCH", "ipam/prefixes/", payload_str, nullptr,
+            [this, create, group, start](const HttpResponse& response, const NetBoxResponse& parsed) {
+        const std::vector<NetBoxResponse::Item>& items = parsed.items();
+        bool matched = netboxSucceeded(response, parsed) && parsed.isList() && items.size() == group->size();
+        for (size_t i = 0; matched && i < items.size(); ++i) {
+            matched = items[i].id > 0;
+        }
 
-        if (response.empty()) {
-            return false;
+        if (!matched) {
+            if (create && !(response.ok() && response.status >= 400 && response.status < 500)) {
+                PD_LOG_DEBUG("PD_WEBHOOK: bulk create failed (HTTP " << response.status << "), looking up "
+                             << group->size() << " prefixes again");
+                recoverCreates(group);
+                return;
+            }
+            PD_LOG_DEBUG("PD_WEBHOOK: bulk " << (create ? "create" : "update") << " failed (HTTP "
+                         << response.status << "), retrying " << group->size() << " prefixes individually");
+            for (const PendingWrite& write : *group) {
+                sendSingleWrite(write);
+            }
+            return;
         }
 
-        // Check if creation was successful
-        if (response.find("\"id\":") != std::string::npos) {
-            return true;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        for (size_t i = 0; i < items.size(); ++i) {
+            const PendingWrite& write = (*group)[i];
+            if (LatencyHistogram* histogram = latency(write.op)) {
+                histogram->record(elapsed);
+            }
+            finishWrite(write.prefix, WriteResult{true, false, items[i].id}, write.done);
         }
+    });
+}
+
+// A bulk create whose outcome is unknown (timeout, 5xx, an answer that does not
+// line up) may have created some of its prefixes. Look them up again: those
+// NetBox now has are done, those it lacks are created on their own, and those
+// whose lookup failed fail, to be looked up again by the next event.
+void
+HttpNetBoxClient::recoverCreates(std::shared_ptr<std::vector<PendingWrite>> group) {
+    std::vector<PendingLookup> batch;
+    for (size_t i = 0; i < group->size(); ++i) {
+        batch.push_back(PendingLookup{(*group)[i].prefix, [this, group, i](int id) {
+            const PendingWrite& write = (*group)[i];
+            if (id > 0) {
+                finishWrite(write.prefix, WriteResult{true, false, id}, write.done);
+            } else if (id < 0) {
+                sendSingleWrite(write);
+            } else {
+                finishWrite(write.prefix, WriteResult{false, false, -1}, write.done);
+            }
+        }});
+    }
+    flushLookups(std::move(batch));
+}
+
+// Batcher flush: split the group into creates and updates and send each as one request
+void
+HttpNetBoxClient::flushWrites(std::vector<PendingWrite>&& batch) {
+    auto creates = std::make_shared<std::vector<PendingWrite>>();
+    auto updates = std::make_shared<std::vector<PendingWrite>>();
+    for (PendingWrite& write : batch) {
+        (write.create ? creates : updates)->push_back(std::move(write));
+    }
+    if (!creates->empty()) {
+        sendBulkWrites(true, creates);
+    }
+    if (!updates->empty()) {
+        sendBulkWrites(false, updates);
+    }
+}
 
-        return false;
+// Queue a write for the next bulk request, or send it right away when batching is off
+void
+HttpNetBoxClient::submitWrite(PendingWrite&& write) {
+    if (write_batcher_) {
+        write_batcher_->add(std::move(write));
+    } else {
+        sendSingleWrite(write);
     }
+}
 
-    bool updatePrefix(int prefix_id, const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft, const std::string& status) override {
-        std::string endpoint = "ipam/prefixes/" + std::to_string(prefix_id) + "/";
+// Update existing prefix with new data
+void
+HttpNetBoxClient::updatePrefix(int prefix_id, const PdAssignmentData& data, uint32_t valid_lft,
+                               ResultCallback done) {
+    // Calculate expiration timestamp (current time + valid lifetime)
+    time_t expires_at = time(nullptr) + valid_lft;
 
-        // Calculate expiration timestamp (current time + valid lifetime)
-        time_t now = time(nullptr);
-        time_t expires_at = now + valid_lft;
+    std::string payload_str = buildPrefixObject(data, "active", expires_at, false, config_.json_encoder,
+                                                config_.fields);
+    PD_LOG_DEBUG("PD_WEBHOOK: updatePrefix payload: " << payload_str);
 
-        Json::Value payload;
-        payload["status"] = status;
-        payload["description"] = "DHCPv6 PD assignment - IAID: " + std::to_string(data.iaid);
+    submitWrite(PendingWrite{false, prefix_id, std::move(payload_str), data.prefix, done, NetBoxOp::UPDATE});
+}
+
+// Update existing prefix to mark as expired
+void
+HttpNetBoxClient::updateExpiredPrefix(int prefix_id, const PdAssignmentData& data, ResultCallback done) {
+    // Just mark as deprecated/expired
+    std::string payload_str = buildStatusObject("deprecated", config_.json_encoder);
+    PD_LOG_DEBUG("PD_WEBHOOK: updateExpiredPrefix payload: " << payload_str);
 
-        Json::Value custom_fields;
-        custom_fields["dhcpv6_client_duid"] = data.client_duid;
-        custom_fields["dhcpv6_iaid"] = static_cast<int>(data.iaid);
-        custom_fields["dhcpv6_cpe_link_local"] = data.cpe_link_local;
-        custom_fields["dhcpv6_router_ip"] = data.router_ip;
-        custom_fields["dhcpv6_router_link_addr"] = data.router_link_addr;
-        custom_fields["dhcpv6_leasetime"] = static_cast<int>(expires_at);
-        payload["custom_fields"] = custom_fields;
+    submitWrite(PendingWrite{false, prefix_id, std::move(payload_str), data.prefix, done, NetBoxOp::DEPRECATE});
+}
 
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::string payload_str = Json::writeString(builder, payload);
-        DEBUG_LOG("PD_WEBHOOK: updatePrefix payload: " << payload_str);
+// Create new prefix in NetBox
+void
+HttpNetBoxClient::createPrefix(const PdAssignmentData& data, uint32_t valid_lft, ResultCallback done) {
+    // Calculate expiration timestamp (current time + valid lifetime)
+    time_t expires_at = time(nullptr) + valid_lft;
 
-        std::string response = netboxHttpRequest("PATCH", endpoint, payload_str);
+    std::string payload_str = buildPrefixObject(data, "active", expires_at, true, config_.json_encoder,
+                                                config_.fields);
+    PD_LOG_DEBUG("PD_WEBHOOK: createPrefix payload: " << payload_str);
 
-        if (response.empty()) {
-            return false;
+    submitWrite(PendingWrite{true, -1, std::move(payload_str), data.prefix, done, NetBoxOp::CREATE});
+}
+
+// Check-then-create-or-update. Each step continues from the completion of the
+// previous one; done runs when the transaction ends.
+void
+HttpNetBoxClient::assign(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
+                         Completion done) {
+    (void)preferred_lft;
+    auto txn = std::make_shared<PdAssignmentData>(data);
+    auto finished = [done](const WriteResult& result) {
+        done(result.ok);
+    };
+
+    // Check if prefix already exists
+    findPrefixId(data.prefix, [this, txn, valid_lft, finished](int existing_prefix_id) {
+        if (existing_prefix_id > 0) {
+            // Update existing prefix; a stale cached ID (404) falls back to creating it
+            updatePrefix(existing_prefix_id, *txn, valid_lft, [this, txn, valid_lft, finished](const WriteResult& result) {
+                if (result.not_found) {
+                    createPrefix(*txn, valid_lft, finished);
+                } else {
+                    finished(result);
+                }
+            });
+        } else if (existing_prefix_id < 0) {
+            // Create new prefix
+            createPrefix(*txn, valid_lft, finished);
+        } else {
+            // The lookup failed: creating now could duplicate a prefix NetBox already has
+            finished(WriteResult{false, false, -1});
         }
+    });
+}
 
-        // Check if update was successful
-        if (response.find("\"id\":") != std::string::npos) {
-            return true;
+// Check if prefix exists in NetBox and update to expired status
+void
+HttpNetBoxClient::expire(const PdAssignmentData& data, Completion done) {
+    auto txn = std::make_shared<PdAssignmentData>(data);
+    findPrefixId(data.prefix, [this, txn, done](int existing_prefix_id) {
+        if (existing_prefix_id > 0) {
+            updateExpiredPrefix(existing_prefix_id, *txn, [done](const WriteResult& result) {
+                done(result.ok || result.not_found);
+            });
+        } else if (existing_prefix_id < 0) {
+            PD_LOG_DEBUG("PD_WEBHOOK: Prefix not found in NetBox, skipping expired update");
+            done(true);
+        } else {
+            done(false);
         }
+    });
+}
 
-        return false;
-    }
+// Prefixes per request of an expiry sweep, keeping the lookup URL reasonably short
+static const size_t kSweepRequestItems = 100;
 
-    bool updateExpiredPrefix(int prefix_id, const PdAssignmentData& data) override {
-        std::string endpoint = "ipam/prefixes/" + std::to_string(prefix_id) + "/";
+// Look up every prefix the cache does not know in multi-prefix queries, then
+// deprecate all that NetBox has in bulk PATCHes. Bypasses the batchers: the
+// sweep is already one group.
+void
+HttpNetBoxClient::expireBatch(const std::vector<PdAssignmentData>& prefixes, BatchCompletion done) {
+    if (prefixes.empty()) {
+        return;
+    }
 
-        Json::Value payload;
-        payload["status"] = "deprecated";  // Just mark as deprecated/expired
+    struct Sweep {
+        std::vector<PrefixKey> keys;
+        std::vector<int> ids;
+        std::atomic<size_t> lookups{0};
+    };
+    auto sweep = std::make_shared<Sweep>();
+    sweep->ids.assign(prefixes.size(), 0);
+    for (const PdAssignmentData& data : prefixes) {
+        sweep->keys.push_back(data.prefix);
+    }
 
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::string payload_str = Json::writeString(builder, payload);
-        DEBUG_LOG("PD_WEBHOOK: updateExpiredPrefix payload: " << payload_str);
+    // Runs once every ID is known
+    auto deprecate = [this, sweep, done] {
+        std::string object = buildStatusObject("deprecated", config_.json_encoder);
+        auto group = std::make_shared<std::vector<PendingWrite>>();
+        for (size_t i = 0; i < sweep->ids.size(); ++i) {
+            int id = sweep->ids[i];
+            if (id < 0) {
+                done(i, true);
+                continue;
+            }
+            if (id == 0) {
+                done(i, false);
+                continue;
+            }
+            group->push_back(PendingWrite{false, id, object, sweep->keys[i], [done, i](const WriteResult& result) {
+                done(i, result.ok || result.not_found);
+            }, NetBoxOp::DEPRECATE});
+            if (group->size() == kSweepRequestItems) {
+                sendBulkWrites(false, group);
+                group = std::make_shared<std::vector<PendingWrite>>();
+            }
+        }
+        if (!group->empty()) {
+            sendBulkWrites(false, group);
+        }
+    };
 
-        std::string response = netboxHttpRequest("PATCH", endpoint, payload_str);
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < sweep->keys.size(); ++i) {
+        int cached_id = cache_ ? cache_->get(sweep->keys[i]) : 0;
+        if (cached_id > 0) {
+            sweep->ids[i] = cached_id;
+        } else {
+            misses.push_back(i);
+        }
+    }
+    if (misses.empty()) {
+        deprecate();
+        return;
+    }
 
-        if (response.empty()) {
-            return false;
+    // One extra count, dropped below, keeps lookups finishing on this thread from deprecating early.
+    sweep->lookups.store(misses.size() + 1);
+    auto finished = [sweep, deprecate] {
+        if (sweep->lookups.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            deprecate();
+        }
+    };
+    for (size_t first = 0; first < misses.size(); first += kSweepRequestItems) {
+        std::vector<PendingLookup> batch;
+        for (size_t n = first; n < misses.size() && n < first + kSweepRequestItems; ++n) {
+            size_t i = misses[n];
+            batch.push_back(PendingLookup{sweep->keys[i], [sweep, finished, i](int id) {
+                sweep->ids[i] = id;
+                finished();
+            }});
         }
+        flushLookups(std::move(batch));
+    }
+    finished();
+}
 
-        // Check if update was successful
-        if (response.find("\"id\":") != std::string::npos) {
-            return true;
+size_t
+HttpNetBoxClient::applyWrites(const std::vector<PrefixWrite>& writes) {
+    if (writes.empty()) {
+        return 0;
+    }
+
+    struct Progress {
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t pending;
+        size_t accepted{0};
+    };
+    auto progress = std::make_shared<Progress>();
+    progress->pending = writes.size();
+    ResultCallback done = [progress](const WriteResult& result) {
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        if (result.ok) {
+            ++progress->accepted;
+        }
+        if (--progress->pending == 0) {
+            progress->cv.notify_all();
+        }
+    };
+
+    auto creates = std::make_shared<std::vector<PendingWrite>>();
+    auto updates = std::make_shared<std::vector<PendingWrite>>();
+    for (const PrefixWrite& write : writes) {
+        const PdAssignmentData& data = write.data;
+        switch (write.op) {
+        case NetBoxOp::CREATE: {
+            std::string object = buildPrefixObject(data, "active", write.expires_at, true, config_.json_encoder,
+                                                   config_.fields & ~NF_RELAY);
+            creates->push_back(PendingWrite{true, -1, std::move(object), data.prefix, done, write.op});
+            break;
+        }
+        case NetBoxOp::UPDATE: {
+            std::string object = buildPrefixObject(data, "active", write.expires_at, false, config_.json_encoder,
+                                                   config_.fields & ~NF_RELAY);
+            updates->push_back(PendingWrite{false, write.id, std::move(object), data.prefix, done, write.op});
+            break;
+        }
+        default:
+            updates->push_back(PendingWrite{false, write.id, buildStatusObject("deprecated", config_.json_encoder),
+                                            data.prefix, done, NetBoxOp::DEPRECATE});
+            break;
         }
+    }
+    if (!creates->empty()) {
+        sendBulkWrites(true, creates);
+    }
+    if (!updates->empty()) {
+        sendBulkWrites(false, updates);
+    }
 
-        return false;
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->cv.wait(lock, [&progress] { return progress->pending == 0; });
+    return progress->accepted;
+}
+
+// Lookups go first: their completions may still queue writes.
+void
+HttpNetBoxClient::flush() {
+    if (lookup_batcher_) {
+        lookup_batcher_->stop();
+    }
+    if (write_batcher_) {
+        write_batcher_->stop();
     }
+}
 
-    // High-level operations
-    void sendNetBoxRequest(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) override {
-        DEBUG_LOG("PD_WEBHOOK: sendNetBoxRequest called for prefix " << data.prefix << "/" << data.prefix_length
-                  << " (valid_lft=" << valid_lft << ", preferred_lft=" << preferred_lft << ")");
+INetBoxClient::Stats
+HttpNetBoxClient::getStats() const {
+    Stats stats{};
+    if (cache_) {
+        stats.cached = true;
+        stats.cache = cache_->getStats();
+    }
+    if (lookup_batcher_) {
+        stats.lookup_batches = lookup_batcher_->batches();
+        stats.lookup_items = lookup_batcher_->items();
+    }
+    if (write_batcher_) {
+        stats.write_batches = write_batcher_->batches();
+        stats.write_items = write_batcher_->items();
+    }
+    return stats;
+}
 
-        if (!g_cfg.netbox_enabled || g_cfg.netbox_url.empty() || g_cfg.netbox_token.empty()) {
-            DEBUG_LOG("PD_WEBHOOK: NetBox not properly configured");
-            return;
-        }
+void
+NullNetBoxClient::store(const PdAssignmentData& data, const char* status, time_t expires_at) {
+    std::string key = data.prefix.toText();
+    std::lock_guard<std::mutex> lock(mutex_);
+    NetBoxResponse::Item& item = prefixes_[key];
+    if (item.id <= 0) {
+        item.id = next_id_++;
+        item.prefix = key;
+    }
+    item.status = status;
+    if (expires_at != 0) {
+        item.client_duid = data.client_duid.toHex();
+        item.leasetime = expires_at;
+    }
+}
 
-        // Check if prefix already exists
-        int existing_prefix_id = findPrefixId(data.prefix, data.prefix_length);
+void
+NullNetBoxClient::assign(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
+                         Completion done) {
+    (void)preferred_lft;
+    store(data, "active", time(nullptr) + valid_lft);
+    done(true);
+}
 
-        if (existing_prefix_id > 0) {
-            // Update existing prefix
-            updatePrefix(existing_prefix_id, data, valid_lft, preferred_lft, "active");
-        } else {
-            // Create new prefix
-            createPrefix(data, valid_lft, preferred_lft);
+void
+NullNetBoxClient::expire(const PdAssignmentData& data, Completion done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = prefixes_.find(data.prefix.toText());
+        if (it != prefixes_.end()) {
+            it->second.status = "deprecated";
         }
     }
+    done(true);
+}
+
+// Every prefix it holds, whatever the filter
+bool
+NullNetBoxClient::listPrefixes(const std::string& filter, size_t page_size, const std::atomic<bool>& stop,
+                               std::vector<NetBoxResponse::Item>& prefixes) {
+    (void)filter;
+    (void)page_size;
+    (void)stop;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : prefixes_) {
+        prefixes.push_back(entry.second);
+    }
+    return true;
+}
 
-private:
-    static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-        size_t totalSize = size * nmemb;
-        static_cast<std::string*>(userp)->append(static_cast<char*>(contents), totalSize);
-        return totalSize;
+size_t
+NullNetBoxClient::applyWrites(const std::vector<PrefixWrite>& writes) {
+    for (const PrefixWrite& write : writes) {
+        if (write.op == NetBoxOp::DEPRECATE) {
+            store(write.data, "deprecated", 0);
+        } else {
+            store(write.data, "active", write.expires_at);
+        }
     }
-};
+    return writes.size();
+}
 
-// Factory function
-std::unique_ptr<INetBoxClient> createNetBoxClient() {
-    return std::make_unique<NetBoxClient>();
-}
\ No newline at end of file
+INetBoxClient::Stats
+NullNetBoxClient::getStats() const {
+    Stats stats{};
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.cached = true;
+    stats.cache.size = prefixes_.size();
+    return stats;
+}
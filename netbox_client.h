@@ -1,52 +1,241 @@
 #ifndef NETBOX_CLIENT_H
 #define NETBOX_CLIENT_H
 
+#include "batcher.h"
+#include "hook_stats.h"
+#include "http_transport.h"
+#include "netbox_response.h"
+#include "pd_payload.h"
+#include "pd_types.h"
+#include "prefix_cache.h"
+#include "prefix_table.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <memory>
 
-// Forward declarations
-struct PdAssignmentData;
+class ErrorTracker;
+
+// NetBox operations timed by the hook
+enum class NetBoxOp : uint8_t {
+    FIND,
+    CREATE,
+    UPDATE,
+    DEPRECATE
+};
 
-// Forward declarations for Kea types (typedefs defined elsewhere)
-namespace isc {
-namespace dhcp {
-    class Pkt6;
-    class Lease6;
-}
-}
+static const size_t kNetBoxOps = 4;
+extern const char* const kNetBoxOpNames[kNetBoxOps];
 
-// NetBox client interface for HTTP operations
+// The NetBox side of PD event delivery, selected by "netbox-client".
+//
+// Every operation completes exactly once through its callback: before the
+// call returns, or later from another thread. done(true) means NetBox now
+// reflects the event; false leaves the event to be replayed.
 class INetBoxClient {
 public:
+    typedef std::function<void(bool)> Completion;
+
+    // Completion of one prefix of a batch: its index and the outcome
+    typedef std::function<void(size_t, bool)> BatchCompletion;
+
+    // Counters reported at unload
+    struct Stats {
+        bool cached;                 // Prefix IDs are cached
+        PrefixIdCache::Stats cache;
+        uint64_t lookup_batches;     // Merged lookups and the prefixes in them
+        uint64_t lookup_items;
+        uint64_t write_batches;      // Bulk writes and the prefixes in them
+        uint64_t write_items;
+    };
+
+    // A write chosen by reconciliation, sent without looking the prefix up
+    struct PrefixWrite {
+        NetBoxOp op;                 // CREATE, UPDATE or DEPRECATE
+        int id;                      // Prefix ID, for UPDATE and DEPRECATE
+        PdAssignmentData data;
+        time_t expires_at;
+    };
+
     virtual ~INetBoxClient() = default;
 
-    // HTTP request methods
-    virtual std::string postWebhook(const std::string& payload) = 0;
-    virtual std::string netboxHttpRequest(const std::string& method, const std::string& endpoint, const std::string& payload = "") = 0;
+    // Create the prefix, or re-activate it with fresh data
+    virtual void assign(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
+                        Completion done) = 0;
 
-    // NetBox API operations
-    virtual int findPrefixId(const std::string& prefix, int prefix_length) = 0;
-    virtual bool createPrefix(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) = 0;
-    virtual bool updatePrefix(int prefix_id, const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft, const std::string& status = "active") = 0;
-    virtual bool updateExpiredPrefix(int prefix_id, const PdAssignmentData& data) = 0;
+    // Mark the prefix deprecated; a prefix NetBox does not have needs nothing
+    virtual void expire(const PdAssignmentData& data, Completion done) = 0;
 
-    // High-level operations
-    virtual void sendNetBoxRequest(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) = 0;
+    // expire() for many prefixes at once; done runs once for every index
+    virtual void expireBatch(const std::vector<PdAssignmentData>& prefixes, BatchCompletion done) {
+        for (size_t i = 0; i < prefixes.size(); ++i) {
+            expire(prefixes[i], [done, i](bool ok) { done(i, ok); });
+        }
+    }
+
+    // Fill the prefix ID cache from NetBox; blocks, and gives up once stop is set
+    virtual void warmCache(const std::atomic<bool>& stop) { (void)stop; }
+
+    // Append the prefixes matching filter to prefixes, page_size at a time;
+    // blocks. False if a page failed, stop was set or listing is unsupported
+    virtual bool listPrefixes(const std::string& filter, size_t page_size, const std::atomic<bool>& stop,
+                              std::vector<NetBoxResponse::Item>& prefixes) {
+        (void)filter;
+        (void)page_size;
+        (void)stop;
+        (void)prefixes;
+        return false;
+    }
+
+    // Send the writes as bulk requests, creates in one and updates in another;
+    // blocks until all have completed and returns how many NetBox accepted
+    virtual size_t applyWrites(const std::vector<PrefixWrite>& writes) {
+        (void)writes;
+        return 0;
+    }
+
+    // Send whatever is still collected; called before the transport stops
+    virtual void flush() {}
+
+    virtual Stats getStats() const = 0;
 };
 
-// Data structure for PD assignment information
-struct PdAssignmentData {
-    std::string client_duid;        // Client DUID (hex encoded)
-    std::string prefix;              // Assigned prefix (e.g., "2001:db8:56::")
-    int prefix_length;               // Prefix length (e.g., 56)
-    uint32_t iaid;                   // Identity association ID
-    std::string cpe_link_local;      // CPE's link-local address
-    std::string router_ip;           // Router's IP address
-    std::string router_link_addr;    // Router's link-address from relay packet
+// Client for the NetBox REST API over an HttpTransport.
+//
+// Looks up the prefix ID (from the cache or NetBox), then PATCHes or POSTs
+// the prefix. Lookups and writes can be merged into multi-prefix requests by
+// batchers. Requests go out through the given sender, which applies the
+// caller's retries and circuit breaking; whether they block depends on the
+// transport behind it ("http-engine").
+class HttpNetBoxClient : public INetBoxClient {
+public:
+    struct Config {
+        std::string url;             // NetBox base URL; "api/" is appended
+        curl_slist* headers{nullptr};  // Owned by the CurlPool
+        long timeout_ms{2000};
+        JsonEncoder json_encoder{JsonEncoder::FAST};
+        uint32_t fields{NF_ALL};       // NetBoxField members written
+        const char* endpoint{"NetBox"};  // Errors are recorded under it; must outlive the ErrorTracker
+
+        PrefixTable* prefix_table{nullptr};  // Holds the prefix ID cache; null disables it
+        long prefix_cache_ttl{3600};         // Seconds
+        std::string warmup_filter;     // Query filter for warmCache()
+        size_t warmup_page_size{1000};
+
+        size_t bulk_max_items{1};      // 1 sends every write on its own
+        long bulk_max_delay_ms{50};
+        size_t lookup_max_items{1};    // 1 looks up every prefix on its own
+        long lookup_max_delay_ms{10};
+    };
+
+    // Sends one request and completes it, retried or not
+    typedef std::function<void(HttpRequest&&, HttpCompletion)> Sender;
+
+    // errors and latency (kNetBoxOps histograms) may be null
+    HttpNetBoxClient(const Config& config, Sender send, ErrorTracker* errors, LatencyHistogram* latency);
+    ~HttpNetBoxClient() override;
+
+    HttpNetBoxClient(const HttpNetBoxClient&) = delete;
+    HttpNetBoxClient& operator=(const HttpNetBoxClient&) = delete;
+
+    void assign(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
+                Completion done) override;
+    void expire(const PdAssignmentData& data, Completion done) override;
+    void expireBatch(const std::vector<PdAssignmentData>& prefixes, BatchCompletion done) override;
+    void warmCache(const std::atomic<bool>& stop) override;
+    bool listPrefixes(const std::string& filter, size_t page_size, const std::atomic<bool>& stop,
+                      std::vector<NetBoxResponse::Item>& prefixes) override;
+    size_t applyWrites(const std::vector<PrefixWrite>& writes) override;
+    void flush() override;
+    Stats getStats() const override;
+
+private:
+    // Receives the prefix ID, -1 if NetBox has no such prefix, or 0 if the lookup failed
+    typedef std::function<void(int)> PrefixIdCallback;
+
+    // Outcome of a create/update request
+    struct WriteResult {
+        bool ok;                     // NetBox accepted the write
+        bool not_found;              // The prefix ID no longer exists (HTTP 404)
+        int id;                      // Object ID from the response, -1 if unknown
+    };
+    typedef std::function<void(const WriteResult&)> ResultCallback;
+
+    // Completion for NetBox requests; the body has already been parsed while it streamed in
+    typedef std::function<void(const HttpResponse&, const NetBoxResponse&)> NetBoxCompletion;
+
+    // A cache-miss lookup waiting to be merged into a multi-prefix query
+    struct PendingLookup {
+        PrefixKey prefix;
+        PrefixIdCallback done;
+    };
+
+    // A create or update waiting to go out, possibly as part of a bulk request
+    struct PendingWrite {
+        bool create;                 // POST a new prefix, otherwise PATCH prefix_id
+        int prefix_id;
+        std::string object;          // Serialized prefix object, without "id"
+        PrefixKey prefix;
+        ResultCallback done;
+        NetBoxOp op;                 // For the latency statistics
+    };
+
+    void request(const std::string& method, const std::string& endpoint, const std::string& data,
+                 LatencyHistogram* latency, NetBoxCompletion done);
+    LatencyHistogram* latency(NetBoxOp op) const;
+
+    void findPrefixId(const PrefixKey& prefix, PrefixIdCallback done);
+    void lookupPrefixId(const PrefixKey& prefix, PrefixIdCallback done);
+    void flushLookups(std::vector<PendingLookup>&& batch);
+
+    void createPrefix(const PdAssignmentData& data, uint32_t valid_lft, ResultCallback done);
+    void updatePrefix(int prefix_id, const PdAssignmentData& data, uint32_t valid_lft, ResultCallback done);
+    void updateExpiredPrefix(int prefix_id, const PdAssignmentData& data, ResultCallback done);
+    void submitWrite(PendingWrite&& write);
+    void sendSingleWrite(const PendingWrite& write);
+    void sendBulkWrites(bool create, std::shared_ptr<std::vector<PendingWrite>> group);
+    void recoverCreates(std::shared_ptr<std::vector<PendingWrite>> group);
+    void flushWrites(std::vector<PendingWrite>&& batch);
+    NetBoxCompletion writeResult(const PrefixKey& prefix, ResultCallback done);
+    void finishWrite(const PrefixKey& prefix, const WriteResult& result, const ResultCallback& done);
+
+    const Config config_;
+    const std::string api_url_;      // config_.url + "api/"
+    const Sender send_;
+    ErrorTracker* const errors_;
+    LatencyHistogram* const latency_;
+
+    std::unique_ptr<PrefixIdCache> cache_;
+    std::unique_ptr<Batcher<PendingLookup>> lookup_batcher_;
+    std::unique_ptr<Batcher<PendingWrite>> write_batcher_;
 };
 
-// Factory function to create NetBox client
-std::unique_ptr<INetBoxClient> createNetBoxClient();
+// In-memory stand-in for NetBox: every operation succeeds at once on the
+// calling thread. Isolates the cost of the hook's own dispatch from any
+// transport when benchmarking.
+class NullNetBoxClient : public INetBoxClient {
+public:
+    void assign(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
+                Completion done) override;
+    void expire(const PdAssignmentData& data, Completion done) override;
+    bool listPrefixes(const std::string& filter, size_t page_size, const std::atomic<bool>& stop,
+                      std::vector<NetBoxResponse::Item>& prefixes) override;
+    size_t applyWrites(const std::vector<PrefixWrite>& writes) override;
+    Stats getStats() const override;
+
+private:
+    void store(const PdAssignmentData& data, const char* status, time_t expires_at);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, NetBoxResponse::Item> prefixes_;  // By "addr/len"
+    int next_id_{1};
+};
 
-#endif // NETBOX_CLIENT_H
\ No newline at end of file
+#endif // NETBOX_CLIENT_H
@@ -0,0 +1,540 @@
+#include "netbox_response.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const size_t kMaxCapture = 4096;     // Longest string value kept
+const size_t kMaxNumber = 64;
+
+bool
+isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool
+isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int
+hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// JSON number grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool
+isJsonNumber(const std::string& s) {
+    size_t i = 0;
+    size_t n = s.size();
+    if (i < n && s[i] == '-') {
+        ++i;
+    }
+    if (i >= n) {
+        return false;
+    }
+    if (s[i] == '0') {
+        ++i;
+    } else if (isDigit(s[i])) {
+        while (i < n && isDigit(s[i])) {
+            ++i;
+        }
+    } else {
+        return false;
+    }
+    if (i < n && s[i] == '.') {
+        ++i;
+        if (i >= n || !isDigit(s[i])) {
+            return false;
+        }
+        while (i < n && isDigit(s[i])) {
+            ++i;
+        }
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        if (i < n && (s[i] == '+' || s[i] == '-')) {
+            ++i;
+        }
+        if (i >= n || !isDigit(s[i])) {
+            return false;
+        }
+        while (i < n && isDigit(s[i])) {
+            ++i;
+        }
+    }
+    return i == n;
+}
+
+// Integer value of a JSON number, or fallback if it is not an integer
+long long
+integerValue(const std::string& s, long long fallback) {
+    if (s.find_first_of(".eE") != std::string::npos) {
+        return fallback;
+    }
+    errno = 0;
+    long long v = std::strtoll(s.c_str(), nullptr, 10);
+    return errno == 0 ? v : fallback;
+}
+
+} // namespace
+
+NetBoxResponse::NetBoxResponse() {
+    reset();
+}
+
+void
+NetBoxResponse::reset() {
+    state_ = STATE_VALUE;
+    stack_.clear();
+    in_key_ = false;
+    key_len_ = 0;
+    key_overflow_ = false;
+    target_ = TARGET_NONE;
+    capture_.clear();
+    unicode_ = 0;
+    unicode_digits_ = 0;
+    high_surrogate_ = 0;
+    literal_ = nullptr;
+    literal_null_ = false;
+
+    list_ = false;
+    has_results_ = false;
+    has_next_ = false;
+    count_ = -1;
+    id_ = -1;
+    detail_.clear();
+    items_.clear();
+}
+
+void
+NetBoxResponse::feed(const char* data, size_t len) {
+    for (size_t i = 0; i < len && state_ != STATE_ERROR; ++i) {
+        if (!step(data[i])) {
+            state_ = STATE_ERROR;
+        }
+    }
+}
+
+bool
+NetBoxResponse::valid() const {
+    // A bare top-level number only ends with the body.
+    if (state_ == STATE_NUMBER && stack_.empty()) {
+        return isJsonNumber(capture_);
+    }
+    return state_ == STATE_DONE;
+}
+
+NetBoxResponse::Target
+NetBoxResponse::targetForKey() const {
+    if (key_overflow_ || stack_.empty()) {
+        return TARGET_NONE;
+    }
+
+    auto is = [this](const char* name) {
+        return std::strlen(name) == key_len_ && std::memcmp(key_, name, key_len_) == 0;
+    };
+    switch (stack_.back().role) {
+    case ROLE_TOP_OBJECT:
+        if (is("count")) {
+            return TARGET_COUNT;
+        }
+        if (is("next")) {
+            return TARGET_NEXT;
+        }
+        if (is("id")) {
+            return TARGET_ID;
+        }
+        if (is("detail")) {
+            return TARGET_DETAIL;
+        }
+        if (is("results")) {
+            return TARGET_RESULTS;
+        }
+        return TARGET_NONE;
+
+    case ROLE_ITEM:
+        if (is("id")) {
+            return TARGET_ITEM_ID;
+        }
+        if (is("prefix")) {
+            return TARGET_ITEM_PREFIX;
+        }
+        if (is("status")) {
+            return TARGET_ITEM_STATUS;
+        }
+        if (is("custom_fields")) {
+            return TARGET_ITEM_CUSTOM;
+        }
+        return TARGET_NONE;
+
+    case ROLE_ITEM_STATUS:
+        return is("value") ? TARGET_STATUS_VALUE : TARGET_NONE;
+
+    case ROLE_ITEM_CUSTOM:
+        if (is("dhcpv6_client_duid")) {
+            return TARGET_ITEM_DUID;
+        }
+        if (is("dhcpv6_leasetime")) {
+            return TARGET_ITEM_LEASETIME;
+        }
+        return TARGET_NONE;
+
+    default:
+        return TARGET_NONE;
+    }
+}
+
+void
+NetBoxResponse::appendCodepoint(uint32_t cp) {
+    char buf[4];
+    size_t n;
+    if (cp < 0x80) {
+        buf[0] = static_cast<char>(cp);
+        n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = static_cast<char>(0xc0 | (cp >> 6));
+        buf[1] = static_cast<char>(0x80 | (cp & 0x3f));
+        n = 2;
+    } else if (cp < 0x10000) {
+        buf[0] = static_cast<char>(0xe0 | (cp >> 12));
+        buf[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+        buf[2] = static_cast<char>(0x80 | (cp & 0x3f));
+        n = 3;
+    } else {
+        buf[0] = static_cast<char>(0xf0 | (cp >> 18));
+        buf[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+        buf[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+        buf[3] = static_cast<char>(0x80 | (cp & 0x3f));
+        n = 4;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (in_key_) {
+            if (key_len_ < kMaxKey) {
+                key_[key_len_++] = buf[i];
+            } else {
+                key_overflow_ = true;
+            }
+        } else if (capturesString() && capture_.size() < kMaxCapture) {
+            capture_.push_back(buf[i]);
+        }
+    }
+}
+
+bool
+NetBoxResponse::beginContainer(bool object) {
+    if (stack_.size() >= kMaxDepth) {
+        return false;
+    }
+
+    Role role = ROLE_OTHER;
+    if (stack_.empty()) {
+        role = object ? ROLE_TOP_OBJECT : ROLE_TOP_LIST;
+        list_ = !object;
+    } else {
+        Role parent = stack_.back().role;
+        if (!object && target_ == TARGET_RESULTS) {
+            role = ROLE_RESULTS;
+            has_results_ = true;
+        } else if (object && (parent == ROLE_RESULTS || parent == ROLE_TOP_LIST)) {
+            role = ROLE_ITEM;
+            items_.emplace_back();
+        } else if (object && target_ == TARGET_ITEM_STATUS) {
+            role = ROLE_ITEM_STATUS;
+        } else if (object && target_ == TARGET_ITEM_CUSTOM) {
+            role = ROLE_ITEM_CUSTOM;
+        }
+        if (target_ == TARGET_NEXT) {
+            has_next_ = true;
+        }
+    }
+
+    stack_.push_back(Frame{object, role});
+    target_ = TARGET_NONE;
+    state_ = object ? STATE_KEY_OR_END : STATE_VALUE_OR_END;
+    return true;
+}
+
+bool
+NetBoxResponse::endContainer(bool object) {
+    if (stack_.empty() || stack_.back().object != object) {
+        return false;
+    }
+    stack_.pop_back();
+    target_ = TARGET_NONE;
+    state_ = stack_.empty() ? STATE_DONE : STATE_AFTER_VALUE;
+    return true;
+}
+
+// String values kept; item targets are only set inside an item
+bool
+NetBoxResponse::capturesString() const {
+    switch (target_) {
+    case TARGET_DETAIL:
+    case TARGET_ITEM_PREFIX:
+    case TARGET_ITEM_STATUS:
+    case TARGET_STATUS_VALUE:
+    case TARGET_ITEM_DUID:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void
+NetBoxResponse::endScalar() {
+    switch (target_) {
+    case TARGET_DETAIL:
+        detail_ = capture_;
+        break;
+    case TARGET_ITEM_PREFIX:
+        items_.back().prefix = capture_;
+        break;
+    case TARGET_ITEM_STATUS:             // NetBox 2.x: a plain string
+    case TARGET_STATUS_VALUE:
+        items_.back().status = capture_;
+        break;
+    case TARGET_ITEM_DUID:
+        items_.back().client_duid = capture_;
+        break;
+    default:
+        break;
+    }
+    capture_.clear();
+    target_ = TARGET_NONE;
+    state_ = stack_.empty() ? STATE_DONE : STATE_AFTER_VALUE;
+}
+
+bool
+NetBoxResponse::finishNumber() {
+    if (!isJsonNumber(capture_)) {
+        return false;
+    }
+
+    if (target_ == TARGET_COUNT) {
+        count_ = static_cast<long>(integerValue(capture_, -1));
+    } else if (target_ == TARGET_ITEM_LEASETIME) {
+        items_.back().leasetime = integerValue(capture_, 0);
+    } else if (target_ == TARGET_ID || target_ == TARGET_ITEM_ID) {
+        long long v = integerValue(capture_, -1);
+        int id = (v > 0 && v <= INT_MAX) ? static_cast<int>(v) : -1;
+        if (target_ == TARGET_ID) {
+            id_ = id;
+        } else {
+            items_.back().id = id;
+        }
+    }
+    capture_.clear();
+    target_ = TARGET_NONE;
+    endScalar();
+    return true;
+}
+
+bool
+NetBoxResponse::beginValue(char c) {
+    if (c == '{') {
+        return beginContainer(true);
+    }
+    if (c == '[') {
+        return beginContainer(false);
+    }
+
+    // Any value other than null means there is another page.
+    if (target_ == TARGET_NEXT && c != 'n') {
+        has_next_ = true;
+    }
+
+    if (c == '"') {
+        in_key_ = false;
+        capture_.clear();
+        high_surrogate_ = 0;
+        state_ = STATE_STRING;
+        return true;
+    }
+    if (c == '-' || isDigit(c)) {
+        capture_.assign(1, c);
+        state_ = STATE_NUMBER;
+        return true;
+    }
+    if (c == 't') {
+        literal_ = "rue";
+        literal_null_ = false;
+    } else if (c == 'f') {
+        literal_ = "alse";
+        literal_null_ = false;
+    } else if (c == 'n') {
+        literal_ = "ull";
+        literal_null_ = true;
+    } else {
+        return false;
+    }
+    state_ = STATE_LITERAL;
+    return true;
+}
+
+// Advance the state machine by one character; false on a syntax error
+bool
+NetBoxResponse::step(char c) {
+    switch (state_) {
+    case STATE_VALUE:
+        return isSpace(c) || beginValue(c);
+
+    case STATE_VALUE_OR_END:
+        if (isSpace(c)) {
+            return true;
+        }
+        return c == ']' ? endContainer(false) : beginValue(c);
+
+    case STATE_KEY_OR_END:
+    case STATE_KEY:
+        if (isSpace(c)) {
+            return true;
+        }
+        if (c == '}' && state_ == STATE_KEY_OR_END) {
+            return endContainer(true);
+        }
+        if (c != '"') {
+            return false;
+        }
+        in_key_ = true;
+        key_len_ = 0;
+        key_overflow_ = false;
+        high_surrogate_ = 0;
+        state_ = STATE_STRING;
+        return true;
+
+    case STATE_COLON:
+        if (isSpace(c)) {
+            return true;
+        }
+        if (c != ':') {
+            return false;
+        }
+        target_ = targetForKey();
+        state_ = STATE_VALUE;
+        return true;
+
+    case STATE_AFTER_VALUE:
+        if (isSpace(c)) {
+            return true;
+        }
+        if (c == ',') {
+            target_ = TARGET_NONE;
+            state_ = stack_.back().object ? STATE_KEY : STATE_VALUE;
+            return true;
+        }
+        if (c == '}') {
+            return endContainer(true);
+        }
+        if (c == ']') {
+            return endContainer(false);
+        }
+        return false;
+
+    case STATE_STRING:
+        if (c == '"') {
+            if (in_key_) {
+                in_key_ = false;
+                state_ = STATE_COLON;
+            } else {
+                endScalar();
+            }
+            return true;
+        }
+        if (c == '\\') {
+            state_ = STATE_STRING_ESCAPE;
+            return true;
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            return false;
+        }
+        appendCodepoint(static_cast<unsigned char>(c));
+        return true;
+
+    case STATE_STRING_ESCAPE: {
+        char decoded;
+        switch (c) {
+        case '"': decoded = '"'; break;
+        case '\\': decoded = '\\'; break;
+        case '/': decoded = '/'; break;
+        case 'b': decoded = '\b'; break;
+        case 'f': decoded = '\f'; break;
+        case 'n': decoded = '\n'; break;
+        case 'r': decoded = '\r'; break;
+        case 't': decoded = '\t'; break;
+        case 'u':
+            unicode_ = 0;
+            unicode_digits_ = 0;
+            state_ = STATE_STRING_UNICODE;
+            return true;
+        default:
+            return false;
+        }
+        appendCodepoint(static_cast<unsigned char>(decoded));
+        state_ = STATE_STRING;
+        return true;
+    }
+
+    case STATE_STRING_UNICODE: {
+        int digit = hexDigit(c);
+        if (digit < 0) {
+            return false;
+        }
+        unicode_ = (unicode_ << 4) | static_cast<uint32_t>(digit);
+        if (++unicode_digits_ < 4) {
+            return true;
+        }
+        state_ = STATE_STRING;
+        if (unicode_ >= 0xd800 && unicode_ < 0xdc00) {
+            high_surrogate_ = unicode_;
+        } else if (unicode_ >= 0xdc00 && unicode_ < 0xe000 && high_surrogate_) {
+            appendCodepoint(0x10000 + ((high_surrogate_ - 0xd800) << 10) + (unicode_ - 0xdc00));
+            high_surrogate_ = 0;
+        } else {
+            appendCodepoint(unicode_);
+            high_surrogate_ = 0;
+        }
+        return true;
+    }
+
+    case STATE_NUMBER:
+        if (isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+            if (capture_.size() >= kMaxNumber) {
+                return false;
+            }
+            capture_.push_back(c);
+            return true;
+        }
+        // The character after a number belongs to what follows it.
+        return finishNumber() && step(c);
+
+    case STATE_LITERAL:
+        if (*literal_ != c) {
+            return false;
+        }
+        if (*++literal_ == '\0') {
+            endScalar();
+        }
+        return true;
+
+    case STATE_DONE:
+        return isSpace(c);
+
+    case STATE_ERROR:
+        return false;
+    }
+    return false;
+}
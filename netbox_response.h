@@ -0,0 +1,135 @@
+#ifndef NETBOX_RESPONSE_H
+#define NETBOX_RESPONSE_H
+
+#include "http_transport.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Streaming reader for NetBox API responses.
+//
+// Fed from the curl write callback, it checks the whole body against the
+// JSON grammar but keeps only the members the hook uses:
+//   - top-level object: "count", "next", "id", "detail" and "results"
+//   - each object in "results", or in a top-level list (bulk responses):
+//     "id", "prefix", "status" (its "value", or the string itself) and the
+//     custom fields "dhcpv6_client_duid" and "dhcpv6_leasetime"
+// Everything else, including nested VRF, tenant and site objects, is
+// skipped as it streams by. A body that is not a single well-formed JSON
+// value is reported as invalid.
+class NetBoxResponse : public BodySink {
+public:
+    // One entry of "results" or of a bulk response list
+    struct Item {
+        int id{-1};
+        std::string prefix;
+        std::string status;
+        std::string client_duid;
+        long long leasetime{0};      // 0 if absent or null
+    };
+
+    NetBoxResponse();
+
+    void reset() override;
+    void feed(const char* data, size_t len) override;
+
+    // True once a complete, well-formed document has been read
+    bool valid() const;
+
+    bool isList() const { return list_; }                 // Top level was an array
+    bool hasResults() const { return has_results_; }      // "results" was a list
+    bool hasNext() const { return has_next_; }            // "next" was present and not null
+    long count() const { return count_; }                 // -1 if absent
+    int id() const { return id_; }                        // Top-level "id", -1 if absent
+    const std::string& detail() const { return detail_; } // Error text, if any
+    const std::vector<Item>& items() const { return items_; }
+
+private:
+    // What a container or value means to us
+    enum Role : uint8_t {
+        ROLE_OTHER,
+        ROLE_TOP_OBJECT,
+        ROLE_TOP_LIST,
+        ROLE_RESULTS,
+        ROLE_ITEM,
+        ROLE_ITEM_STATUS,            // {"value": ..., "label": ...}
+        ROLE_ITEM_CUSTOM             // "custom_fields"
+    };
+
+    // Where a scalar value goes
+    enum Target : uint8_t {
+        TARGET_NONE,
+        TARGET_COUNT,
+        TARGET_NEXT,
+        TARGET_ID,
+        TARGET_DETAIL,
+        TARGET_ITEM_ID,
+        TARGET_ITEM_PREFIX,
+        TARGET_ITEM_STATUS,
+        TARGET_ITEM_CUSTOM,
+        TARGET_STATUS_VALUE,
+        TARGET_ITEM_DUID,
+        TARGET_ITEM_LEASETIME,
+        TARGET_RESULTS
+    };
+
+    enum State : uint8_t {
+        STATE_VALUE,                 // Expecting a value
+        STATE_KEY_OR_END,            // After '{'
+        STATE_KEY,                   // After ',' in an object
+        STATE_COLON,
+        STATE_AFTER_VALUE,           // Expecting ',' or a closing bracket
+        STATE_VALUE_OR_END,          // After '['
+        STATE_STRING,
+        STATE_STRING_ESCAPE,
+        STATE_STRING_UNICODE,
+        STATE_NUMBER,
+        STATE_LITERAL,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    struct Frame {
+        bool object;
+        Role role;
+    };
+
+    bool step(char c);
+    bool beginValue(char c);
+    bool beginContainer(bool object);
+    bool endContainer(bool object);
+    void endScalar();
+    bool finishNumber();
+    void appendCodepoint(uint32_t cp);
+    Target targetForKey() const;
+    bool capturesString() const;
+
+    static const size_t kMaxDepth = 64;
+    static const size_t kMaxKey = 24;
+
+    State state_;
+    std::vector<Frame> stack_;
+    bool in_key_;                    // The current string is an object key
+    char key_[kMaxKey];              // Last key of an interesting object
+    size_t key_len_;
+    bool key_overflow_;
+    Target target_;                  // Destination of the value being read
+    std::string capture_;            // Text of a captured string or number
+    uint32_t unicode_;
+    int unicode_digits_;
+    uint32_t high_surrogate_;
+    const char* literal_;            // Remaining characters of true/false/null
+    bool literal_null_;
+
+    bool list_;
+    bool has_results_;
+    bool has_next_;
+    long count_;
+    int id_;
+    std::string detail_;
+    std::vector<Item> items_;
+};
+
+#endif // NETBOX_RESPONSE_H
@@ -0,0 +1,91 @@
+#include "netbox_router.h"
+
+#include <algorithm>
+
+namespace {
+
+// Points each unit of weight puts on the ring; enough to spread the prefixes
+// within a few percent of the weights
+const unsigned kPointsPerWeight = 128;
+
+// FNV-1a, finished with the splitmix64 mixer so nearby inputs spread over the ring
+uint64_t
+hashBytes(const uint8_t* data, size_t size, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // namespace
+
+NetBoxRouter::NetBoxRouter(const std::vector<Backend>& backends, const std::vector<Route>& routes) {
+    for (size_t b = 0; b < backends.size() && b < kMaxBackends; ++b) {
+        const Backend& backend = backends[b];
+        if (backend.mirror) {
+            mirrors_ |= uint64_t(1) << b;
+            continue;
+        }
+        const std::string& name = backend.name;
+        unsigned points = std::max(1u, backend.weight) * kPointsPerWeight;
+        for (unsigned i = 0; i < points; ++i) {
+            uint64_t point = hashBytes(reinterpret_cast<const uint8_t*>(name.data()), name.size(), i);
+            ring_.emplace_back(point, static_cast<uint32_t>(b));
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+
+    for (const Route& route : routes) {
+        if (route.backend >= kMaxBackends) {
+            continue;
+        }
+        routes_.emplace_back(EventFilter({route.rule}, {}), route.backend);
+        if (!route.rule.link_prefixes.empty()) {
+            link_routes_ |= uint64_t(1) << route.backend;
+        }
+    }
+}
+
+size_t
+NetBoxRouter::hashed(const PrefixKey& prefix) const {
+    if (ring_.empty()) {
+        return 0;
+    }
+    uint8_t key[17];
+    std::copy(prefix.addr, prefix.addr + 16, key);
+    key[16] = prefix.length;
+    uint64_t point = hashBytes(key, sizeof(key), 0);
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(point, uint32_t(0)));
+    return (it == ring_.end() ? ring_.front() : *it).second;
+}
+
+uint64_t
+NetBoxRouter::targets(uint32_t subnet_id, const PrefixKey& prefix, const Ip6Address* link_addr,
+                      bool fan_out) const {
+    bool has_link = link_addr && link_addr->present;
+    EventFilter::Input input{PdEventType::ASSIGNED, 0, subnet_id, prefix.length, has_link ? link_addr : nullptr};
+
+    size_t primary = kMaxBackends;
+    for (const auto& route : routes_) {
+        if (route.first.matches(input)) {
+            primary = route.second;
+            break;
+        }
+    }
+    if (primary == kMaxBackends) {
+        primary = hashed(prefix);
+    }
+
+    uint64_t targets = (uint64_t(1) << primary) | mirrors_;
+    if (fan_out && !has_link) {
+        targets |= link_routes_;
+    }
+    return targets;
+}
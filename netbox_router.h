@@ -0,0 +1,64 @@
+#ifndef NETBOX_ROUTER_H
+#define NETBOX_ROUTER_H
+
+#include "event_filter.h"
+#include "pd_address.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Chooses the NetBox backends of a prefix when "netbox-backends" lists several.
+//
+// The primary backend is named by the first route whose rule matches the
+// subnet ID, prefix length and relay link-address; otherwise the prefix is
+// placed on a consistent-hash ring of the backends that are not mirrors, so
+// every hook instance picks the same backend and adding one moves only about
+// its share of the prefixes. Mirrors receive every event besides the primary.
+// Backends are returned as bits of a mask, at most kMaxBackends of them.
+class NetBoxRouter {
+public:
+    static const size_t kMaxBackends = 64;
+
+    struct Backend {
+        std::string name;            // Seeds its ring points, so it decides placement
+        unsigned weight{1};          // Share of the ring
+        bool mirror{false};          // Receives every event, never the primary
+    };
+
+    // Events matching rule go to backend
+    struct Route {
+        EventFilter::Rule rule;      // Only prefix length, subnet IDs and link prefixes
+        size_t backend;
+    };
+
+    // backends must hold at least one that is not a mirror, and routes must
+    // name primaries only
+    NetBoxRouter(const std::vector<Backend>& backends, const std::vector<Route>& routes);
+
+    // Backends an event goes to: the primary and the mirrors. With fan_out and
+    // no relay link-address, every backend a link-prefix route names is
+    // included too, as the prefix may be held by any of them; that is only
+    // safe for expirations, which leave a prefix a backend lacks alone.
+    uint64_t targets(uint32_t subnet_id, const PrefixKey& prefix, const Ip6Address* link_addr,
+                     bool fan_out) const;
+
+    // Backends that are mirrors
+    uint64_t mirrors() const { return mirrors_; }
+
+    // Whether some route tests the relay link-address, which leases read from
+    // the lease database do not carry
+    bool hasLinkRoutes() const { return link_routes_ != 0; }
+
+private:
+    size_t hashed(const PrefixKey& prefix) const;
+
+    std::vector<std::pair<EventFilter, size_t>> routes_;
+    std::vector<std::pair<uint64_t, uint32_t>> ring_;  // Sorted points and their backend
+    uint64_t mirrors_{0};
+    uint64_t link_routes_{0};        // Backends named by a link-prefix route
+};
+
+#endif // NETBOX_ROUTER_H
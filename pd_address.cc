@@ -0,0 +1,242 @@
+#include "pd_address.h"
+
+#include <arpa/inet.h>
+
+#include <cstdlib>
+#include <ostream>
+
+namespace {
+
+const char kDigits[] = "0123456789abcdef";
+
+// "00".."ff", two characters per byte value
+struct HexPairs {
+    char text[512];
+
+    constexpr HexPairs() : text() {
+        for (int i = 0; i < 256; ++i) {
+            text[2 * i] = kDigits[i >> 4];
+            text[2 * i + 1] = kDigits[i & 0x0f];
+        }
+    }
+};
+
+constexpr HexPairs kHexPairs;
+
+// One group without leading zeros
+char*
+writeGroup(uint16_t group, char* out) {
+    int shift = group >= 0x1000 ? 12 : group >= 0x100 ? 8 : group >= 0x10 ? 4 : 0;
+    for (; shift >= 0; shift -= 4) {
+        *out++ = kDigits[(group >> shift) & 0x0f];
+    }
+    return out;
+}
+
+char*
+writeDecimal(uint8_t value, char* out) {
+    if (value >= 100) {
+        *out++ = static_cast<char>('0' + value / 100);
+    }
+    if (value >= 10) {
+        *out++ = static_cast<char>('0' + value / 10 % 10);
+    }
+    *out++ = static_cast<char>('0' + value % 10);
+    return out;
+}
+
+int
+hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+// Follows glibc's inet_ntop6(): the first longest run of two or more zero
+// groups becomes "::".
+size_t
+formatIp6(const uint8_t* addr, char* out) {
+    uint16_t groups[8];
+    for (int i = 0; i < 8; ++i) {
+        groups[i] = static_cast<uint16_t>(addr[2 * i] << 8 | addr[2 * i + 1]);
+    }
+
+    int best = -1;
+    int best_len = 0;
+    for (int i = 0; i < 8;) {
+        if (groups[i] != 0) {
+            ++i;
+            continue;
+        }
+        int run = i;
+        while (i < 8 && groups[i] == 0) {
+            ++i;
+        }
+        if (i - run > best_len) {
+            best = run;
+            best_len = i - run;
+        }
+    }
+    if (best_len < 2) {
+        best = -1;
+    }
+
+    char* p = out;
+    for (int i = 0; i < 8; ++i) {
+        if (best >= 0 && i >= best && i < best + best_len) {
+            if (i == best) {
+                *p++ = ':';
+            }
+            continue;
+        }
+        if (i != 0) {
+            *p++ = ':';
+        }
+        if (i == 6 && best == 0 && (best_len == 6 || (best_len == 5 && groups[5] == 0xffff))) {
+            for (int j = 12; j < 16; ++j) {
+                p = writeDecimal(addr[j], p);
+                if (j != 15) {
+                    *p++ = '.';
+                }
+            }
+            return static_cast<size_t>(p - out);
+        }
+        p = writeGroup(groups[i], p);
+    }
+    if (best >= 0 && best + best_len == 8) {
+        *p++ = ':';
+    }
+    return static_cast<size_t>(p - out);
+}
+
+size_t
+formatHex(const uint8_t* data, size_t len, char* out) {
+    for (size_t i = 0; i < len; ++i) {
+        std::memcpy(out + 2 * i, kHexPairs.text + 2 * data[i], 2);
+    }
+    return 2 * len;
+}
+
+void
+appendHex(std::string& out, const uint8_t* data, size_t len) {
+    size_t offset = out.size();
+    out.resize(offset + 2 * len);
+    formatHex(data, len, &out[offset]);
+}
+
+bool
+Ip6Address::fromText(const std::string& text, Ip6Address& address) {
+    address = Ip6Address();
+    if (text.empty()) {
+        return true;
+    }
+    if (inet_pton(AF_INET6, text.c_str(), address.bytes) != 1) {
+        return false;
+    }
+    address.present = true;
+    return true;
+}
+
+std::string
+Ip6Address::toText() const {
+    if (!present) {
+        return std::string();
+    }
+    char text[kIp6TextMax];
+    return std::string(text, formatIp6(bytes, text));
+}
+
+bool
+Duid::fromHex(const std::string& hex, Duid& duid) {
+    duid = Duid();
+    if (hex.size() % 2 != 0 || hex.size() / 2 > kMaxLength) {
+        return false;
+    }
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int hi = hexValue(hex[i]);
+        int lo = hexValue(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        duid.bytes[i / 2] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    duid.length = static_cast<uint8_t>(hex.size() / 2);
+    return true;
+}
+
+std::string
+Duid::toHex() const {
+    std::string text;
+    appendHex(text, bytes, length);
+    return text;
+}
+
+bool
+PrefixKey::fromText(const std::string& prefix, int prefix_length, PrefixKey& key) {
+    if (prefix_length < 1 || prefix_length > 128 || inet_pton(AF_INET6, prefix.c_str(), key.addr) != 1) {
+        return false;
+    }
+    key.length = static_cast<uint8_t>(prefix_length);
+    return true;
+}
+
+bool
+PrefixKey::fromCidr(const std::string& cidr, PrefixKey& key) {
+    size_t slash = cidr.find('/');
+    if (slash == std::string::npos) {
+        return false;
+    }
+    return fromText(cidr.substr(0, slash), std::atoi(cidr.c_str() + slash + 1), key);
+}
+
+std::string
+PrefixKey::address() const {
+    char text[kIp6TextMax];
+    return std::string(text, formatIp6(addr, text));
+}
+
+std::string
+PrefixKey::toText() const {
+    char text[kIp6TextMax + 4];
+    size_t len = formatIp6(addr, text);
+    text[len++] = '/';
+    len = static_cast<size_t>(writeDecimal(length, text + len) - text);
+    return std::string(text, len);
+}
+
+std::ostream&
+operator<<(std::ostream& os, const Ip6Address& address) {
+    return os << address.toText();
+}
+
+std::ostream&
+operator<<(std::ostream& os, const Duid& duid) {
+    return os << duid.toHex();
+}
+
+size_t
+PrefixKeyHash::operator()(const PrefixKey& key) const {
+    uint64_t a;
+    uint64_t b;
+    std::memcpy(&a, key.addr, sizeof(a));
+    std::memcpy(&b, key.addr + sizeof(a), sizeof(b));
+    uint64_t h = a * 0x9e3779b97f4a7c15ULL ^ (b + key.length) * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return static_cast<size_t>(h);
+}
+
+std::ostream&
+operator<<(std::ostream& os, const PrefixKey& key) {
+    return os << key.toText();
+}
@@ -0,0 +1,107 @@
+#ifndef PD_ADDRESS_H
+#define PD_ADDRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+
+// Binary DUIDs, IPv6 addresses and prefixes carried by PD events.
+//
+// Events keep them as raw bytes from the callouts to the sinks; text is only
+// produced when a payload is serialized, written straight into the output
+// buffer by the formatters below.
+
+// Room formatIp6() needs
+static const size_t kIp6TextMax = 40;
+
+// Write addr (16 bytes) as inet_ntop() would, RFC 5952 with IPv4-mapped and
+// -compatible addresses in dotted form; returns the length, without a NUL
+size_t formatIp6(const uint8_t* addr, char* out);
+
+// Write len bytes as lowercase hex to out (2 * len chars); returns 2 * len
+size_t formatHex(const uint8_t* data, size_t len, char* out);
+
+// Append the hex of len bytes to out
+void appendHex(std::string& out, const uint8_t* data, size_t len);
+
+// An IPv6 address that may be absent; absent addresses format as ""
+struct Ip6Address {
+    uint8_t bytes[16]{};
+    bool present{false};
+
+    void assign(const uint8_t* addr) {
+        std::memcpy(bytes, addr, sizeof(bytes));
+        present = true;
+    }
+
+    // "" gives an absent address; false unless text is an IPv6 address
+    static bool fromText(const std::string& text, Ip6Address& address);
+
+    std::string toText() const;
+
+    bool operator==(const Ip6Address& other) const {
+        return present == other.present && std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+};
+
+// Client DUID as received
+struct Duid {
+    static const size_t kMaxLength = 130;  // Type plus up to 128 bytes (RFC 8415)
+
+    uint8_t length{0};
+    uint8_t bytes[kMaxLength]{};
+
+    // Longer input is cut to kMaxLength
+    void assign(const uint8_t* data, size_t len) {
+        length = static_cast<uint8_t>(len < kMaxLength ? len : kMaxLength);
+        std::memcpy(bytes, data, length);
+    }
+
+    // Parse hex digits; false on odd length, other characters or too many bytes
+    static bool fromHex(const std::string& hex, Duid& duid);
+
+    std::string toHex() const;
+
+    bool operator==(const Duid& other) const {
+        return length == other.length && std::memcmp(bytes, other.bytes, length) == 0;
+    }
+};
+
+// Binary key of a delegated prefix: the 16 address bytes and the length
+struct PrefixKey {
+    uint8_t addr[16]{};
+    uint8_t length{0};               // 0 marks an unused table slot
+
+    // Parse "2001:db8:56::" and 56; false unless it is an IPv6 prefix of length 1..128
+    static bool fromText(const std::string& prefix, int prefix_length, PrefixKey& key);
+
+    // Parse "2001:db8:56::/56"
+    static bool fromCidr(const std::string& cidr, PrefixKey& key);
+
+    std::string address() const;     // "2001:db8:56::"
+    std::string toText() const;      // "2001:db8:56::/56"
+
+    bool operator==(const PrefixKey& other) const {
+        return length == other.length && std::memcmp(addr, other.addr, sizeof(addr)) == 0;
+    }
+
+    // Address order, then length
+    bool operator<(const PrefixKey& other) const {
+        int order = std::memcmp(addr, other.addr, sizeof(addr));
+        return order < 0 || (order == 0 && length < other.length);
+    }
+};
+
+// Hash for unordered containers keyed by prefix
+struct PrefixKeyHash {
+    size_t operator()(const PrefixKey& key) const;
+};
+
+// Text forms for log messages
+std::ostream& operator<<(std::ostream& os, const Ip6Address& address);
+std::ostream& operator<<(std::ostream& os, const Duid& duid);
+std::ostream& operator<<(std::ostream& os, const PrefixKey& key);
+
+#endif // PD_ADDRESS_H
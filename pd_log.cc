@@ -0,0 +1,50 @@
+#include "pd_log.h"
+
+#include "pd_webhook_messages.h"
+
+#include <log/macros.h>
+
+isc::log::Logger pd_webhook_logger("pd-webhook");
+
+std::atomic<int> g_log_level{static_cast<int>(LogLevel::WARNING)};
+std::atomic<unsigned> g_log_sample_rate{1};
+thread_local bool t_log_sampled = true;
+
+namespace {
+
+std::atomic<unsigned long> g_log_packets{0};
+
+} // namespace
+
+void
+setLogLevel(LogLevel level, unsigned sample_rate) {
+    g_log_sample_rate.store(sample_rate > 0 ? sample_rate : 1, std::memory_order_relaxed);
+    g_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void
+samplePacketLog() {
+    if (!logEnabled(LogLevel::DEBUG)) {
+        return;
+    }
+    unsigned rate = g_log_sample_rate.load(std::memory_order_relaxed);
+    t_log_sampled = rate <= 1 || g_log_packets.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+}
+
+void
+writeLog(LogLevel level, const std::string& text) {
+    switch (level) {
+    case LogLevel::ERROR:
+        LOG_ERROR(pd_webhook_logger, PD_WEBHOOK_ERROR).arg(text);
+        break;
+    case LogLevel::WARNING:
+        LOG_WARN(pd_webhook_logger, PD_WEBHOOK_WARNING).arg(text);
+        break;
+    case LogLevel::INFO:
+        LOG_INFO(pd_webhook_logger, PD_WEBHOOK_INFO).arg(text);
+        break;
+    case LogLevel::DEBUG:
+        LOG_DEBUG(pd_webhook_logger, isc::log::DBGLVL_TRACE_BASIC, PD_WEBHOOK_DEBUG).arg(text);
+        break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef PD_LOG_H
+#define PD_LOG_H
+
+#include <log/logger.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+// Logging for the hook, written through Kea's logger "pd-webhook"
+// (kea-dhcp6.pd-webhook), so its severity and output are configured in the
+// Kea "loggers" section like any other Kea component.
+//
+// In front of Kea's own check sits the hook's "log-level": a relaxed atomic
+// load that the PD_LOG_* macros test before their arguments are evaluated,
+// so a disabled statement costs one comparison and never formats anything.
+
+enum class LogLevel {
+    ERROR,
+    WARNING,
+    INFO,
+    DEBUG
+};
+
+extern isc::log::Logger pd_webhook_logger;
+
+// Highest enabled level, as an int of LogLevel
+extern std::atomic<int> g_log_level;
+
+// Packet sampling for debug output: only 1 in g_log_sample_rate packets logs
+extern std::atomic<unsigned> g_log_sample_rate;
+extern thread_local bool t_log_sampled;
+
+inline bool
+logEnabled(LogLevel level) {
+    return static_cast<int>(level) <= g_log_level.load(std::memory_order_relaxed);
+}
+
+// Debug output for the current packet; true outside the callouts
+inline bool
+debugLogEnabled() {
+    return logEnabled(LogLevel::DEBUG) && t_log_sampled;
+}
+
+void setLogLevel(LogLevel level, unsigned sample_rate);
+
+// Pick whether the packet handled next on this thread is sampled
+void samplePacketLog();
+
+// Hand a formatted message to the Kea logger
+void writeLog(LogLevel level, const std::string& text);
+
+#define PD_LOG(level, msg) do { \
+    if (logEnabled(level)) { \
+        std::ostringstream pd_log_os_; \
+        pd_log_os_ << msg; \
+        writeLog(level, pd_log_os_.str()); \
+    } \
+} while (0)
+
+#define PD_LOG_ERROR(msg) PD_LOG(LogLevel::ERROR, msg)
+#define PD_LOG_WARN(msg) PD_LOG(LogLevel::WARNING, msg)
+#define PD_LOG_INFO(msg) PD_LOG(LogLevel::INFO, msg)
+
+#define PD_LOG_DEBUG(msg) do { \
+    if (debugLogEnabled()) { \
+        std::ostringstream pd_log_os_; \
+        pd_log_os_ << msg; \
+        writeLog(LogLevel::DEBUG, pd_log_os_.str()); \
+    } \
+} while (0)
+
+#endif // PD_LOG_H
@@ -0,0 +1,416 @@
+#include "pd_payload.h"
+
+#include "json_writer.h"
+
+#include <jsoncpp/json/json.h>
+
+namespace {
+
+// Scratch buffer reused by every fast payload built on this thread
+std::string&
+scratch() {
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+std::string
+jsoncppString(const Json::Value& value) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, value);
+}
+
+std::string
+prefixDescription(uint32_t iaid) {
+    return "DHCPv6 PD assignment - IAID: " + std::to_string(iaid);
+}
+
+// String values formatted straight into the payload
+
+void
+addressValue(JsonWriter& w, const Ip6Address& address) {
+    char text[kIp6TextMax];
+    w.beginString();
+    if (address.present) {
+        w.appendPlain(text, formatIp6(address.bytes, text));
+    }
+    w.endString();
+}
+
+void
+prefixValue(JsonWriter& w, const PrefixKey& prefix, bool with_length) {
+    char text[kIp6TextMax];
+    w.beginString();
+    w.appendPlain(text, formatIp6(prefix.addr, text));
+    if (with_length) {
+        w.appendPlain("/", 1);
+        w.appendString(prefix.length);
+    }
+    w.endString();
+}
+
+void
+duidValue(JsonWriter& w, const Duid& duid) {
+    char text[Duid::kMaxLength * 2];
+    w.beginString();
+    w.appendPlain(text, formatHex(duid.bytes, duid.length, text));
+    w.endString();
+}
+
+// The "lease" object of pd_expired, also one element of pd_expired_batch
+
+Json::Value
+expiredLeaseValue(const PdEvent& ev, uint32_t fields) {
+    Json::Value lease_obj(Json::objectValue);
+    if (fields & WF_PREFIX) {
+        lease_obj["prefix"] = ev.data.prefix.address();
+    }
+    if (fields & WF_PREFIX_LENGTH) {
+        lease_obj["prefix_length"] = ev.data.prefix.length;
+    }
+    if (fields & WF_IAID) {
+        lease_obj["iaid"] = static_cast<Json::UInt>(ev.data.iaid);
+    }
+    if (fields & WF_DUID) {
+        lease_obj["duid"] = ev.data.client_duid.toHex();
+    }
+    if (fields & WF_CLTT) {
+        lease_obj["cltt"] = static_cast<Json::Int64>(ev.cltt);
+    }
+    if (fields & WF_VALID_LFT) {
+        lease_obj["valid_lft"] = static_cast<Json::UInt>(ev.valid_lft);
+    }
+    if (fields & WF_PREFERRED_LFT) {
+        lease_obj["preferred_lft"] = static_cast<Json::UInt>(ev.preferred_lft);
+    }
+    return lease_obj;
+}
+
+void
+expiredLease(JsonWriter& w, const PdEvent& ev, uint32_t fields) {
+    w.beginObject();
+    if (fields & WF_CLTT) {
+        w.key("cltt"); w.value(static_cast<Json::Int64>(ev.cltt));
+    }
+    if (fields & WF_DUID) {
+        w.key("duid"); duidValue(w, ev.data.client_duid);
+    }
+    if (fields & WF_IAID) {
+        w.key("iaid"); w.value(ev.data.iaid);
+    }
+    if (fields & WF_PREFERRED_LFT) {
+        w.key("preferred_lft"); w.value(ev.preferred_lft);
+    }
+    if (fields & WF_PREFIX) {
+        w.key("prefix"); prefixValue(w, ev.data.prefix, false);
+    }
+    if (fields & WF_PREFIX_LENGTH) {
+        w.key("prefix_length"); w.value(ev.data.prefix.length);
+    }
+    if (fields & WF_VALID_LFT) {
+        w.key("valid_lft"); w.value(ev.valid_lft);
+    }
+    w.endObject();
+}
+
+struct FieldName {
+    const char* name;
+    uint32_t field;
+};
+
+const FieldName kWebhookFields[] = {
+    {"client_duid", WF_CLIENT_DUID}, {"link_addr", WF_LINK_ADDR}, {"msg_type", WF_MSG_TYPE},
+    {"peer_addr", WF_PEER_ADDR}, {"relay_src_addr", WF_RELAY_SRC_ADDR}, {"reply_type", WF_REPLY_TYPE},
+    {"cltt", WF_CLTT}, {"duid", WF_DUID}, {"expires_at", WF_EXPIRES_AT}, {"iaid", WF_IAID},
+    {"preferred_lft", WF_PREFERRED_LFT}, {"prefix", WF_PREFIX}, {"prefix_length", WF_PREFIX_LENGTH},
+    {"subnet_id", WF_SUBNET_ID}, {"valid_lft", WF_VALID_LFT}
+};
+
+const FieldName kNetBoxFields[] = {
+    {"description", NF_DESCRIPTION}, {"dhcpv6_iaid", NF_IAID}, {"dhcpv6_cpe_link_local", NF_CPE_LINK_LOCAL},
+    {"dhcpv6_router_ip", NF_ROUTER_IP}, {"dhcpv6_router_link_addr", NF_ROUTER_LINK_ADDR}
+};
+
+template <size_t N>
+bool
+findField(const FieldName (&names)[N], const std::string& name, uint32_t& field) {
+    for (const FieldName& entry : names) {
+        if (name == entry.name) {
+            field = entry.field;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool
+parseWebhookField(const std::string& name, uint32_t& field) {
+    return findField(kWebhookFields, name, field);
+}
+
+bool
+parseNetBoxField(const std::string& name, uint32_t& field) {
+    return findField(kNetBoxFields, name, field);
+}
+
+// pd_assigned body for count leases of one packet, whose context is taken from
+// the first; expires_at counts valid_lft from base
+static std::string
+assignedPayload(const PdEvent* leases, size_t count, time_t base, JsonEncoder encoder, uint32_t fields) {
+    const PdEvent& ev = leases[0];
+
+    if (encoder == JsonEncoder::JSONCPP) {
+        Json::Value payload;
+        payload["event"] = "pd_assigned";
+        if (fields & WF_MSG_TYPE) {
+            payload["msg_type"] = static_cast<int>(ev.msg_type);
+        }
+        if (fields & WF_REPLY_TYPE) {
+            payload["reply_type"] = static_cast<int>(ev.reply_type);
+        }
+        if (fields & WF_CLIENT_DUID) {
+            payload["client_duid"] = ev.data.client_duid.toHex();
+        }
+        if (fields & WF_LINK_ADDR) {
+            payload["link_addr"] = ev.data.router_link_addr.toText();
+        }
+        if (fields & WF_PEER_ADDR) {
+            payload["peer_addr"] = ev.peer_addr.toText();
+        }
+        if (fields & WF_RELAY_SRC_ADDR) {
+            payload["relay_src_addr"] = ev.data.router_ip.toText();
+        }
+
+        Json::Value lease_array(Json::arrayValue);
+        for (size_t i = 0; i < count; ++i) {
+            const PdEvent& lease = leases[i];
+            Json::Value lease_obj(Json::objectValue);
+            if (fields & WF_PREFIX) {
+                lease_obj["prefix"] = lease.data.prefix.address();
+            }
+            if (fields & WF_PREFIX_LENGTH) {
+                lease_obj["prefix_length"] = lease.data.prefix.length;
+            }
+            if (fields & WF_IAID) {
+                lease_obj["iaid"] = static_cast<Json::UInt>(lease.data.iaid);
+            }
+            if (fields & WF_SUBNET_ID) {
+                lease_obj["subnet_id"] = static_cast<Json::UInt>(lease.subnet_id);
+            }
+            if (fields & WF_PREFERRED_LFT) {
+                lease_obj["preferred_lft"] = static_cast<Json::UInt>(lease.preferred_lft);
+            }
+            if (fields & WF_VALID_LFT) {
+                lease_obj["valid_lft"] = static_cast<Json::UInt>(lease.valid_lft);
+            }
+            if (fields & WF_EXPIRES_AT) {
+                lease_obj["expires_at"] = static_cast<Json::Int64>(base) + lease.valid_lft;
+            }
+            lease_array.append(lease_obj);
+        }
+        payload["leases"] = lease_array;
+        return jsoncppString(payload);
+    }
+
+    std::string& out = scratch();
+    out.reserve(count * 160 + 256);
+    JsonWriter w(out);
+    w.beginObject();
+    if (fields & WF_CLIENT_DUID) {
+        w.key("client_duid"); duidValue(w, ev.data.client_duid);
+    }
+    w.key("event"); w.value("pd_assigned");
+    w.key("leases");
+    w.beginArray();
+    for (size_t i = 0; i < count; ++i) {
+        const PdEvent& lease = leases[i];
+        w.beginObject();
+        if (fields & WF_EXPIRES_AT) {
+            w.key("expires_at"); w.value(static_cast<Json::Int64>(base) + lease.valid_lft);
+        }
+        if (fields & WF_IAID) {
+            w.key("iaid"); w.value(lease.data.iaid);
+        }
+        if (fields & WF_PREFERRED_LFT) {
+            w.key("preferred_lft"); w.value(lease.preferred_lft);
+        }
+        if (fields & WF_PREFIX) {
+            w.key("prefix"); prefixValue(w, lease.data.prefix, false);
+        }
+        if (fields & WF_PREFIX_LENGTH) {
+            w.key("prefix_length"); w.value(lease.data.prefix.length);
+        }
+        if (fields & WF_SUBNET_ID) {
+            w.key("subnet_id"); w.value(lease.subnet_id);
+        }
+        if (fields & WF_VALID_LFT) {
+            w.key("valid_lft"); w.value(lease.valid_lft);
+        }
+        w.endObject();
+    }
+    w.endArray();
+    if (fields & WF_LINK_ADDR) {
+        w.key("link_addr"); addressValue(w, ev.data.router_link_addr);
+    }
+    if (fields & WF_MSG_TYPE) {
+        w.key("msg_type"); w.value(static_cast<int>(ev.msg_type));
+    }
+    if (fields & WF_PEER_ADDR) {
+        w.key("peer_addr"); addressValue(w, ev.peer_addr);
+    }
+    if (fields & WF_RELAY_SRC_ADDR) {
+        w.key("relay_src_addr"); addressValue(w, ev.data.router_ip);
+    }
+    if (fields & WF_REPLY_TYPE) {
+        w.key("reply_type"); w.value(static_cast<int>(ev.reply_type));
+    }
+    w.endObject();
+    return out;
+}
+
+std::string
+buildAssignedPayload(const PdEvent& ev, JsonEncoder encoder, uint32_t fields) {
+    return assignedPayload(&ev, 1, ev.cltt, encoder, fields);
+}
+
+std::string
+buildAssignedPayload(const std::vector<PdEvent>& leases, time_t now, JsonEncoder encoder, uint32_t fields) {
+    return assignedPayload(leases.data(), leases.size(), now, encoder, fields);
+}
+
+std::string
+buildExpiredPayload(const PdEvent& ev, JsonEncoder encoder, uint32_t fields) {
+    if (encoder == JsonEncoder::JSONCPP) {
+        Json::Value payload;
+        payload["event"] = "pd_expired";
+        payload["lease"] = expiredLeaseValue(ev, fields);
+        return jsoncppString(payload);
+    }
+
+    std::string& out = scratch();
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("event"); w.value("pd_expired");
+    w.key("lease"); expiredLease(w, ev, fields);
+    w.endObject();
+    return out;
+}
+
+std::string
+buildExpiredBatchPayload(const std::vector<PdEvent>& events, JsonEncoder encoder, uint32_t fields) {
+    if (encoder == JsonEncoder::JSONCPP) {
+        Json::Value payload;
+        payload["event"] = "pd_expired_batch";
+        payload["count"] = static_cast<Json::UInt>(events.size());
+        Json::Value leases(Json::arrayValue);
+        for (const PdEvent& ev : events) {
+            leases.append(expiredLeaseValue(ev, fields));
+        }
+        payload["leases"] = leases;
+        return jsoncppString(payload);
+    }
+
+    std::string& out = scratch();
+    out.reserve(events.size() * 200 + 64);
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("count"); w.value(static_cast<uint64_t>(events.size()));
+    w.key("event"); w.value("pd_expired_batch");
+    w.key("leases");
+    w.beginArray();
+    for (const PdEvent& ev : events) {
+        expiredLease(w, ev, fields);
+    }
+    w.endArray();
+    w.endObject();
+    return out;
+}
+
+std::string
+buildPrefixObject(const PdAssignmentData& data, const std::string& status, time_t expires_at,
+                  bool include_prefix, JsonEncoder encoder, uint32_t fields) {
+    Json::Int64 leasetime = static_cast<Json::Int64>(expires_at);
+
+    if (encoder == JsonEncoder::JSONCPP) {
+        Json::Value payload;
+        if (include_prefix) {
+            payload["prefix"] = data.prefix.toText();
+        }
+        payload["status"] = status;
+        if (fields & NF_DESCRIPTION) {
+            payload["description"] = prefixDescription(data.iaid);
+        }
+
+        Json::Value custom_fields;
+        custom_fields["dhcpv6_client_duid"] = data.client_duid.toHex();
+        if (fields & NF_IAID) {
+            custom_fields["dhcpv6_iaid"] = static_cast<Json::UInt>(data.iaid);
+        }
+        if (fields & NF_CPE_LINK_LOCAL) {
+            custom_fields["dhcpv6_cpe_link_local"] = data.cpe_link_local.toText();
+        }
+        if (fields & NF_ROUTER_IP) {
+            custom_fields["dhcpv6_router_ip"] = data.router_ip.toText();
+        }
+        if (fields & NF_ROUTER_LINK_ADDR) {
+            custom_fields["dhcpv6_router_link_addr"] = data.router_link_addr.toText();
+        }
+        custom_fields["dhcpv6_leasetime"] = leasetime;
+        payload["custom_fields"] = custom_fields;
+        return jsoncppString(payload);
+    }
+
+    std::string& out = scratch();
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("custom_fields");
+    w.beginObject();
+    w.key("dhcpv6_client_duid"); duidValue(w, data.client_duid);
+    if (fields & NF_CPE_LINK_LOCAL) {
+        w.key("dhcpv6_cpe_link_local"); addressValue(w, data.cpe_link_local);
+    }
+    if (fields & NF_IAID) {
+        w.key("dhcpv6_iaid"); w.value(data.iaid);
+    }
+    w.key("dhcpv6_leasetime"); w.value(leasetime);
+    if (fields & NF_ROUTER_IP) {
+        w.key("dhcpv6_router_ip"); addressValue(w, data.router_ip);
+    }
+    if (fields & NF_ROUTER_LINK_ADDR) {
+        w.key("dhcpv6_router_link_addr"); addressValue(w, data.router_link_addr);
+    }
+    w.endObject();
+
+    if (fields & NF_DESCRIPTION) {
+        w.key("description");
+        w.beginString();
+        w.appendString("DHCPv6 PD assignment - IAID: ");
+        w.appendString(data.iaid);
+        w.endString();
+    }
+    if (include_prefix) {
+        w.key("prefix"); prefixValue(w, data.prefix, true);
+    }
+    w.key("status"); w.value(status);
+    w.endObject();
+    return out;
+}
+
+std::string
+buildStatusObject(const std::string& status, JsonEncoder encoder) {
+    if (encoder == JsonEncoder::JSONCPP) {
+        Json::Value payload;
+        payload["status"] = status;
+        return jsoncppString(payload);
+    }
+
+    std::string& out = scratch();
+    JsonWriter w(out);
+    w.beginObject();
+    w.key("status"); w.value(status);
+    w.endObject();
+    return out;
+}
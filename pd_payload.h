@@ -0,0 +1,88 @@
+#ifndef PD_PAYLOAD_H
+#define PD_PAYLOAD_H
+
+#include "pd_types.h"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// JSON bodies for the webhook and the NetBox prefix API.
+//
+// The fast encoder writes each fixed payload shape with JsonWriter into a
+// per-thread buffer; the jsoncpp encoder builds a Json::Value tree as the
+// hook always did and is kept as a fallback. Both emit the keys in the same
+// (sorted) order and produce identical output.
+enum class JsonEncoder {
+    FAST,
+    JSONCPP
+};
+
+// Optional members of the webhook payloads, selected by "webhook-fields" and
+// named after their keys; "event", "count", "lease" and "leases" are always written
+enum WebhookField : uint32_t {
+    WF_CLIENT_DUID = 1u << 0,
+    WF_LINK_ADDR = 1u << 1,
+    WF_MSG_TYPE = 1u << 2,
+    WF_PEER_ADDR = 1u << 3,
+    WF_RELAY_SRC_ADDR = 1u << 4,
+    WF_REPLY_TYPE = 1u << 5,
+    WF_CLTT = 1u << 6,
+    WF_DUID = 1u << 7,
+    WF_EXPIRES_AT = 1u << 8,
+    WF_IAID = 1u << 9,
+    WF_PREFERRED_LFT = 1u << 10,
+    WF_PREFIX = 1u << 11,
+    WF_PREFIX_LENGTH = 1u << 12,
+    WF_SUBNET_ID = 1u << 13,
+    WF_VALID_LFT = 1u << 14,
+    WF_ALL = (1u << 15) - 1
+};
+
+// Optional members of the NetBox prefix objects, selected by "netbox-fields".
+// "prefix", "status" and the dhcpv6_client_duid and dhcpv6_leasetime custom
+// fields are always written: warm-up, reconciliation and expiry rely on them.
+enum NetBoxField : uint32_t {
+    NF_DESCRIPTION = 1u << 0,
+    NF_IAID = 1u << 1,                // dhcpv6_iaid
+    NF_CPE_LINK_LOCAL = 1u << 2,      // dhcpv6_cpe_link_local
+    NF_ROUTER_IP = 1u << 3,           // dhcpv6_router_ip
+    NF_ROUTER_LINK_ADDR = 1u << 4,    // dhcpv6_router_link_addr
+    NF_ALL = (1u << 5) - 1,
+    // Taken from the relay, so unknown for a lease read from Kea's lease database;
+    // left out of its PATCH, they keep the values NetBox already holds
+    NF_RELAY = NF_CPE_LINK_LOCAL | NF_ROUTER_IP | NF_ROUTER_LINK_ADDR
+};
+
+// Bit for a "webhook-fields" or "netbox-fields" name; false for an unknown one
+bool parseWebhookField(const std::string& name, uint32_t& field);
+bool parseNetBoxField(const std::string& name, uint32_t& field);
+
+// pd_assigned webhook body for one lease event, with the WebhookField members in fields;
+// expires_at counts from the lease's cltt
+std::string buildAssignedPayload(const PdEvent& ev, JsonEncoder encoder, uint32_t fields = WF_ALL);
+
+// pd_assigned webhook body for the PD leases of one packet, as the hook has
+// always posted it: a "leases" member per lease, the packet's context taken
+// from the first, and expires_at counting valid_lft from now
+std::string buildAssignedPayload(const std::vector<PdEvent>& leases, time_t now, JsonEncoder encoder,
+                                 uint32_t fields = WF_ALL);
+
+// pd_expired webhook body for one lease event
+std::string buildExpiredPayload(const PdEvent& ev, JsonEncoder encoder, uint32_t fields = WF_ALL);
+
+// pd_expired_batch webhook body: the lease objects of pd_expired, in order,
+// for the expirations of one reclamation sweep
+std::string buildExpiredBatchPayload(const std::vector<PdEvent>& events, JsonEncoder encoder,
+                                     uint32_t fields = WF_ALL);
+
+// NetBox prefix object carrying the assignment, with the NetBoxField members
+// in fields; the "prefix" member is only included for creates
+std::string buildPrefixObject(const PdAssignmentData& data, const std::string& status, time_t expires_at,
+                              bool include_prefix, JsonEncoder encoder, uint32_t fields = NF_ALL);
+
+// NetBox prefix object that only sets the status
+std::string buildStatusObject(const std::string& status, JsonEncoder encoder);
+
+#endif // PD_PAYLOAD_H
@@ -0,0 +1,57 @@
+#ifndef PD_TYPES_H
+#define PD_TYPES_H
+
+#include "pd_address.h"
+#include "trace_context.h"
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+
+// Data structure for PD assignment information, kept in binary until serialized
+struct PdAssignmentData {
+    Duid client_duid;                // Client DUID
+    PrefixKey prefix;                // Assigned prefix and length (e.g., 2001:db8:56::/56)
+    uint32_t iaid;                   // Identity association ID
+    Ip6Address cpe_link_local;       // CPE's link-local address
+    Ip6Address router_ip;            // Router's IP address
+    Ip6Address router_link_addr;     // Router's link-address from relay packet
+};
+
+// Lease lifecycle event reported by the callouts
+enum class PdEventType : uint8_t {
+    ASSIGNED,
+    EXPIRED,
+    RECOVERED
+};
+
+// Sinks an event goes to, as chosen by "webhook-event-filter" and "netbox-event-filter"
+enum EventSink : uint8_t {
+    SINK_WEBHOOK = 1,
+    SINK_NETBOX = 2
+};
+
+// pd_assigned webhook shared by the lease events of one packet
+struct PacketWebhook;
+
+// Event record handed from the callouts to the sender threads.
+// One record is created per PD lease and carries everything both sinks need.
+struct PdEvent {
+    PdEventType type{PdEventType::ASSIGNED};
+    uint8_t msg_type{0};             // Client message type (assignments only)
+    uint8_t reply_type{0};           // Server reply type (assignments only)
+    PdAssignmentData data{};
+    Ip6Address peer_addr;            // Raw relay peer-address, as sent in the webhook
+    uint32_t subnet_id{0};
+    uint32_t valid_lft{0};
+    uint32_t preferred_lft{0};
+    time_t cltt{0};                  // Client last transmission time of the lease
+    uint64_t spool_seq{0};           // Spool record holding this event, 0 if not spooled
+    bool low_priority{false};        // Plain renewal: sent after other events, shed first
+    uint8_t sinks{SINK_WEBHOOK | SINK_NETBOX};  // EventSink bits
+    bool log_sampled{true};          // Debug output enabled for the packet that produced it
+    TraceContext trace;              // Set when the event was sampled for tracing
+    std::shared_ptr<PacketWebhook> packet;  // Assignments sent to the webhook, unless replayed
+};
+
+#endif // PD_TYPES_H
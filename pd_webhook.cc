@@ -1,3 +1,4 @@
+#include <cc/command_interpreter.h>
 #include <cc/data.h>
 
 #include <dhcp/pkt6.h>
@@ -9,13 +10,52 @@
 #include <hooks/callout_handle.h>
 #include <hooks/hooks.h>
 #include <hooks/library_handle.h>
+#include <stats/stats_mgr.h>
 
 #include <curl/curl.h>
-#include <jsoncpp/json/json.h>
 
+#include "batcher.h"
+#include "circuit_breaker.h"
+#include "compression.h"
+#include "curl_multi_engine.h"
+#include "curl_pool.h"
+#include "dispatch_queue.h"
+#include "error_tracker.h"
+#include "event_filter.h"
+#include "event_spool.h"
+#include "hook_stats.h"
+#include "http_transport.h"
+#include "netbox_client.h"
+#include "netbox_router.h"
+#include "pd_address.h"
+#include "pd_log.h"
+#include "pd_payload.h"
+#include "prefix_table.h"
+#include "rate_limiter.h"
+#include "reconciler.h"
+#include "renewal_filter.h"
+#include "retry_policy.h"
+#include "tracer.h"
+#include "work_lane.h"
+#include "pd_types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <ctime>
 
@@ -24,73 +64,207 @@ using namespace isc::data;
 using namespace isc::dhcp;
 using namespace isc::hooks;
 
-// Data structure for PD assignment information
-struct PdAssignmentData {
-    std::string client_duid;        // Client DUID (hex encoded)
-    std::string prefix;              // Assigned prefix (e.g., "2001:db8:56::")
-    int prefix_length;               // Prefix length (e.g., 56)
-    uint32_t iaid;                   // Identity association ID
-    std::string cpe_link_local;      // CPE's link-local address
-    std::string router_ip;           // Router's IP address
-    std::string router_link_addr;    // Router's link-address from relay packet
-};
-
-// Error codes for structured error reporting
-enum class ErrorCode {
-    NONE,
-    CURL_INIT_FAILED,
-    HTTP_REQUEST_FAILED,
-    JSON_PARSE_FAILED,
-    INVALID_RESPONSE
-};
-
-enum class LogLevel {
-    ERROR,
-    WARNING,
-    INFO,
-    DEBUG
-};
-
 // Simple runtime configuration for this library.
 struct WebhookConfig {
     std::string url;
     long timeout_ms{2000};
     bool enabled{false};
-    bool debug{false};
+    bool debug{false};               // Shorthand for "log-level": "debug"
 
     // NetBox API configuration
     std::string netbox_url;
     std::string netbox_token;
     bool netbox_enabled{false};
-
-    // Error reporting
-    ErrorCode last_error{ErrorCode::NONE};
-    std::string last_error_msg;
+    bool null_netbox{false};         // "netbox-client": "http" or "null"
+
+    // Several NetBox instances, "netbox-backends"; replaces netbox-url and netbox-token
+    struct NetBoxBackendConfig {
+        std::string name;
+        std::string url;
+        std::string token;
+        unsigned weight{1};          // Share of the consistent-hash ring
+        bool mirror{false};          // Receives every event besides its primary
+        double rate_limit{-1.0};     // -1 = netbox-rate-limit
+        double rate_burst{0.0};      // 0 = netbox-rate-burst, or one second's worth
+        size_t max_in_flight{0};     // 0 = max-in-flight
+        size_t queue_size{0};        // 0 = queue-size
+    };
+    std::vector<NetBoxBackendConfig> netbox_backends;
+    std::vector<NetBoxRouter::Route> netbox_routes;  // "netbox-routes"
+    size_t netbox_backend_threads{0};  // Lane threads per backend; 0 = sender-threads
 
     // Logging
     LogLevel log_level{LogLevel::WARNING};
+    unsigned log_sample_rate{1};     // Debug output for 1 in N packets
+
+    // Asynchronous dispatch
+    size_t queue_size{10000};
+    size_t sender_threads{2};
+    DispatchQueue::OverflowPolicy queue_overflow{DispatchQueue::OverflowPolicy::DROP_OLDEST};
+    size_t intake_ring_size{8192};   // 0 queues under the queue lock
+
+    // HTTP engine
+    bool multi_engine{false};        // "http-engine": "easy" or "multi"
+    size_t engine_threads{1};
+    size_t max_in_flight{32};        // Per endpoint host
+    bool http2{false};
+
+    // Outbound rate limits in events per second; 0 disables a limit
+    double netbox_rate_limit{0.0};
+    double netbox_rate_burst{0.0};   // 0 = one second's worth
+    double webhook_rate_limit{0.0};
+    double webhook_rate_burst{0.0};
+    long low_priority_max_wait_ms{1000};  // Renewals waiting longer are shed
+
+    // NetBox prefix ID cache
+    size_t prefix_cache_size{100000};  // 0 disables the cache
+    long prefix_cache_ttl{3600};       // Seconds
+
+    // Prefix ID cache warm-up at load
+    enum class Warmup { OFF, BLOCK, BACKGROUND } cache_warmup{Warmup::OFF};
+    std::string cache_warmup_filter{"cf_dhcpv6_client_duid__empty=false"};
+    size_t cache_warmup_page_size{1000};
+
+    // Renewal suppression: allowed expiry drift as a fraction of valid_lft
+    double renew_suppress_fraction{0.0};  // 0 sends every renewal
+
+    // Reconciliation with the lease database
+    long reconcile_interval_sec{0};  // 0 disables it
+    size_t reconcile_lease_page_size{1000};
+    size_t reconcile_netbox_page_size{1000};
+    size_t reconcile_max_writes_per_sec{100};  // 0 = unlimited
+    double reconcile_leasetime_tolerance{-1.0};  // Below 0: renew_suppress_fraction
+    std::string reconcile_filter{"cf_dhcpv6_client_duid__empty=false"};
+
+    // NetBox bulk writes
+    size_t bulk_max_items{1};        // 1 sends every write on its own
+    long bulk_max_delay_ms{50};
+
+    // Merged NetBox lookups on cache misses
+    size_t lookup_max_items{1};      // 1 looks up every prefix on its own
+    long lookup_max_delay_ms{10};
+
+    // Expiry sweeps: lease6_expire events collected and delivered as one batch
+    size_t expire_batch_max_items{1};  // 1 delivers every expiration on its own
+    long expire_batch_idle_ms{200};    // Quiet time that ends a sweep
+
+    // Retries and circuit breaking
+    unsigned retry_max_attempts{3};  // 1 disables retries
+    long retry_backoff_ms{200};
+    long retry_backoff_max_ms{5000};
+    double retry_jitter{0.5};        // Fraction of the backoff that is randomized
+    unsigned breaker_failure_threshold{5};  // 0 disables the breaker
+    long breaker_cooldown_ms{10000};
+
+    // Payload serialization: "json-encoder": "fast" or "jsoncpp"
+    JsonEncoder json_encoder{JsonEncoder::FAST};
+
+    // Per-sink event selection and payload members
+    EventFilter webhook_filter;      // "webhook-event-filter"
+    EventFilter netbox_filter;       // "netbox-event-filter"
+    uint32_t webhook_fields{WF_ALL};
+    uint32_t netbox_fields{NF_ALL};
+
+    // Webhook body format: "webhook-format": "json" (one post per event) or "ndjson"
+    bool webhook_ndjson{false};
+    size_t webhook_batch_max_items{500};
+    long webhook_batch_max_delay_ms{1000};
+    Compression webhook_compression{Compression::NONE};
+
+    // Statistics: publish interval for Kea's StatsMgr, 0 disables publishing
+    long stats_interval_ms{1000};
+
+    // Durable event spool
+    std::string spool_path;          // Empty disables the spool
+    size_t spool_max_size{16 * 1024 * 1024};
+    EventSpool::SyncPolicy spool_fsync{EventSpool::SyncPolicy::INTERVAL};
+    long spool_fsync_interval_ms{1000};
+
+    // Unload: how long queued and in-flight events may take to finish
+    long drain_timeout_ms{2000};     // 0 discards them at once
+
+    // Sampled tracing, exported to an OTLP/HTTP collector
+    double trace_sample_rate{0.0};   // 0 disables tracing
+    std::string trace_otlp_url;      // e.g. http://collector:4318/v1/traces
+    std::string trace_service_name{"kea-pd-webhook"};
 };
 
 static WebhookConfig g_cfg;
 
-// Error logging macro
-#define ERROR_LOG(msg) do { \
-    g_cfg.last_error_msg = msg; \
-    std::cerr << "[ERROR] " << msg << std::endl; \
+// Error counters and recent errors, read by the "pd-webhook-errors-get" command
+static ErrorTracker g_errors;
+
+// Throughput counters and latency histograms; sharded so the callout and
+// sender threads never contend on them
+struct HookStats {
+    ShardedCounter received_committed;   // PD events per callout
+    ShardedCounter received_expire;
+    ShardedCounter received_recover;
+    ShardedCounter sent;                 // Events fully delivered
+    ShardedCounter failed;               // Events with a failed part
+    ShardedCounter filtered;             // Events the event filters kept from every sink
+    ShardedCounter filtered_webhook;     // Events an event filter kept from a sink
+    ShardedCounter filtered_netbox;
+
+    LatencyHistogram callout_committed;
+    LatencyHistogram callout_expire;
+    LatencyHistogram callout_recover;
+    LatencyHistogram netbox[kNetBoxOps]; // Per request, including retries
+};
+
+static HookStats g_stats;
+
+// Deliveries started and not finished yet, waited for when unloading
+static std::atomic<size_t> g_deliveries{0};
+
+// Cleared when unloading starts; events dispatched after that are only spooled
+static std::atomic<bool> g_accepting{false};
+static std::atomic<uint64_t> g_refused{0};
+
+static void
+finishDelivery() {
+    g_deliveries.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Error logging macro: counts the error for an endpoint, then logs it
+#define ERROR_LOG(code, endpoint, msg) do { \
+    g_errors.record(code, endpoint); \
+    PD_LOG_ERROR(msg); \
 } while(0)
 
-// Debug logging macro
-#define DEBUG_LOG(msg) do { if (g_cfg.debug) std::cout << msg << std::endl; } while(0)
+#define WARN_LOG(msg) PD_LOG_WARN(msg)
+#define INFO_LOG(msg) PD_LOG_INFO(msg)
+
+// Debug logging macro; arguments are only evaluated when debug output is on
+#define DEBUG_LOG(msg) PD_LOG_DEBUG(msg)
 
-// Hex encode helper for DUID, etc.
+// Hex encode helper for debug output
 static std::string
 toHex(const std::vector<uint8_t>& data) {
-    std::ostringstream os;
-    os << std::hex << std::setfill('0');
-    for (auto b : data) {
-        os << std::setw(2) << static_cast<unsigned int>(b);
+    std::string text;
+    appendHex(text, data.data(), data.size());
+    return text;
+}
+
+// Binary form of an IPv6 address; anything else stays absent
+static void
+toIp6(const asiolink::IOAddress& addr, Ip6Address& out) {
+    if (addr.isV6()) {
+        std::vector<uint8_t> bytes = addr.toBytes();
+        out.assign(bytes.data());
     }
-    return os.str();
+}
+
+// Binary prefix of a PD lease; length 0 if the address is not IPv6
+static PrefixKey
+leasePrefix(const Lease6& lease) {
+    PrefixKey key;
+    if (lease.addr_.isV6()) {
+        std::vector<uint8_t> bytes = lease.addr_.toBytes();
+        std::memcpy(key.addr, bytes.data(), sizeof(key.addr));
+        key.length = lease.prefixlen_;
+    }
+    return key;
 }
 
 // Safe integer parsing to prevent exceptions
@@ -127,316 +301,606 @@ hexDump(const uint8_t* data, size_t len, size_t offset = 0) {
     return os.str();
 }
 
-// Post JSON payload to the configured webhook URL.
-static void
-postWebhook(const std::string& body) {
-    if (!g_cfg.enabled || g_cfg.url.empty()) {
-        return;
-    }
+// Pooled easy handles, created in load()
+static std::unique_ptr<CurlPool> g_pool;
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        return;
-    }
+// Request engine selected by "http-engine", created in load()
+static std::unique_ptr<HttpTransport> g_transport;
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+// Caps on outstanding NetBox transactions and webhook posts ("max-in-flight")
+static std::unique_ptr<InflightLimiter> g_netbox_limiter;
+static std::unique_ptr<InflightLimiter> g_webhook_limiter;
 
-    curl_easy_setopt(curl, CURLOPT_URL, g_cfg.url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
-    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, g_cfg.timeout_ms);
+// Event rate limits per endpoint; null when "netbox-rate-limit" / "webhook-rate-limit" is 0
+static std::unique_ptr<TokenBucket> g_netbox_rate;
+static std::unique_ptr<TokenBucket> g_webhook_rate;
 
-    // Errors are intentionally ignored; this library is notification-only.
-    (void)curl_easy_perform(curl);
+// Per-prefix state behind the prefix cache, the renewal filter and the queue, created in load()
+static std::unique_ptr<PrefixTable> g_prefix_table;
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-}
+// Last pushed state per prefix; null when "renew-suppress-fraction" is 0
+static std::unique_ptr<RenewalFilter> g_renewal_filter;
 
-// Make HTTP request to NetBox API and return response
-static std::string
-netboxHttpRequest(const std::string& method, const std::string& endpoint, const std::string& data) {
-    if (!g_cfg.netbox_enabled || g_cfg.netbox_url.empty() || g_cfg.netbox_token.empty()) {
-        return "";
-    }
+// Retry policy and timer for failed requests, created in load()
+static std::unique_ptr<RetryPolicy> g_retry_policy;
+static std::unique_ptr<RetryScheduler> g_retry_scheduler;
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        return "";
-    }
+// One breaker per endpoint ("breaker-failure-threshold")
+static std::unique_ptr<CircuitBreaker> g_netbox_breaker;
+static std::unique_ptr<CircuitBreaker> g_webhook_breaker;
 
-    std::string response;
-    std::string full_url = g_cfg.netbox_url;
-    if (full_url.back() != '/') {
-        full_url += "/";
-    }
-    full_url += "api/" + endpoint;
+// Failures worth another attempt: no response at all, 429 or a server error.
+// Other HTTP errors (e.g. 404 for a stale prefix ID) are answers, not failures.
+static bool
+isTransientFailure(const HttpResponse& response) {
+    return !response.ok() || response.status == 429 || response.status >= 500;
+}
 
-    struct curl_slist* headers = nullptr;
-    std::string auth_header = "Authorization: Token " + g_cfg.netbox_token;
-    headers = curl_slist_append(headers, auth_header.c_str());
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "Accept: application/json");
+// Failures where the request cannot have reached the server, so that even a
+// create can be sent again: the handle could not be set up, or the name did
+// not resolve or the connection was refused. A timeout or a 5xx may come after
+// the server acted on the request.
+static bool
+neverSent(const HttpResponse& response) {
+    return response.code == CURLE_FAILED_INIT || response.code == CURLE_COULDNT_RESOLVE_HOST ||
+           response.code == CURLE_COULDNT_RESOLVE_PROXY || response.code == CURLE_COULDNT_CONNECT;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, full_url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, g_cfg.timeout_ms);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+// A request across its attempts
+struct RetryState {
+    HttpRequest request;
+    CircuitBreaker* breaker;
+    const char* endpoint;            // Name used in log messages
+    HttpCompletion done;
+    unsigned attempts;
+};
 
-    // Set up response callback
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, +[](void* contents, size_t size, size_t nmemb, void* userp) -> size_t {
-        ((std::string*)userp)->append((char*)contents, size * nmemb);
-        return size * nmemb;
-    });
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+// Sampled tracing; null when "trace-sample-rate" is 0
+static std::unique_ptr<Tracer> g_tracer;
 
-    // Set request method
-    if (method == "POST") {
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(data.size()));
-    } else if (method == "GET") {
-        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-    } else if (method == "PATCH") {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(data.size()));
+// Export one OTLP body; spans are best effort, so there are no retries
+static void
+exportTraces(std::string&& body, std::function<void(bool)> done) {
+    if (!g_transport) {
+        done(false);
+        return;
     }
+    HttpRequest request;
+    request.method = "POST";
+    request.url = g_cfg.trace_otlp_url;
+    request.body = std::move(body);
+    request.headers = g_pool->traceHeaders();
+    request.timeout_ms = g_cfg.timeout_ms;
+    request.keep_body = false;
+    g_transport->submit(std::move(request), [done](const HttpResponse& response) {
+        done(response.ok() && response.status >= 200 && response.status < 300);
+    });
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    if (res != CURLE_OK) {
-        ERROR_LOG("HTTP request failed: " + std::string(curl_easy_strerror(res)));
-        return "";
+// Spans of one traced attempt: the request, and under it the phases curl
+// timed (DNS, TCP connect, TLS handshake, time to first byte)
+static void
+recordRequestSpans(const RetryState& state, const HttpResponse& response, uint64_t start_ns) {
+    if (!g_tracer) {
+        return;
+    }
+    uint64_t end_ns = Tracer::nowNs();
+    Span span = Tracer::childSpan(state.request.trace, state.endpoint, start_ns, end_ns);
+    span.client = true;
+    span.error = isTransientFailure(response) || response.status >= 400;
+    span.attribute("http.request.method", state.request.method);
+    span.attribute("url.full", state.request.url);
+    span.attribute("http.response.status_code", static_cast<int64_t>(response.status));
+    if (state.attempts > 1) {
+        span.attribute("http.request.resend_count", static_cast<int64_t>(state.attempts - 1));
+    }
+    if (!response.ok()) {
+        span.attribute("error.type", curl_easy_strerror(response.code));
     }
 
-    return response;
+    // curl's clock starts when the transfer does, after any wait for the engine.
+    const HttpTimings& t = response.timings;
+    uint64_t curl_start = end_ns - std::min<uint64_t>(end_ns - start_ns, static_cast<uint64_t>(t.total_us) * 1000);
+    TraceContext parent = state.request.trace;
+    parent.span_id = span.span_id;
+    auto phase = [&parent, curl_start](const char* name, int64_t from_us, int64_t to_us) {
+        if (to_us > from_us) {
+            g_tracer->record(Tracer::childSpan(parent, name, curl_start + static_cast<uint64_t>(from_us) * 1000,
+                                               curl_start + static_cast<uint64_t>(to_us) * 1000));
+        }
+    };
+    phase("dns", 0, t.namelookup_us);
+    phase("connect", t.namelookup_us, t.connect_us);
+    phase("tls", t.connect_us, t.appconnect_us);
+    phase("ttfb", t.pretransfer_us, t.starttransfer_us);
+    g_tracer->record(std::move(span));
 }
 
-// Check if prefix exists in NetBox and return its ID
-static int
-findPrefixId(const std::string& prefix, int prefix_length) {
-    std::string search_url = "ipam/prefixes/?prefix=" + prefix + "/" + std::to_string(prefix_length);
-    std::string response = netboxHttpRequest("GET", search_url, "");
-
-    if (response.empty()) {
-        return -1;
+// Send one attempt of a request through its endpoint's breaker. A transient
+// failure is retried after a backoff on the retry timer, not on the caller's
+// thread; done receives the final response. A request that is not idempotent
+// is only retried when it was never sent. While the breaker is open the
+// request completes immediately with response.rejected set.
+static void
+submitAttempt(std::shared_ptr<RetryState> state) {
+    if (!state->breaker->allow()) {
+        if (state->attempts > 0) {
+            g_retry_policy->recordExhausted();
+        }
+        HttpResponse response;
+        response.code = CURLE_ABORTED_BY_CALLBACK;
+        response.rejected = true;
+        state->done(response);
+        return;
     }
 
-    Json::Value root;
-    Json::CharReaderBuilder builder;
-    Json::CharReader* reader = builder.newCharReader();
-    std::string errors;
-    bool success = reader->parse(response.c_str(), response.c_str() + response.size(), &root, &errors);
-    delete reader;
+    ++state->attempts;
+    HttpRequest request = state->request;
+    uint64_t trace_start = request.trace.sampled() ? Tracer::nowNs() : 0;
+    g_transport->submit(std::move(request), [state, trace_start](const HttpResponse& response) {
+        // Requests the continuation submits belong to the same trace.
+        if (trace_start != 0) {
+            recordRequestSpans(*state, response, trace_start);
+        }
+        TraceScope trace_scope(state->request.trace);
 
-    if (!success || !root.isMember("results") || !root["results"].isArray()) {
-        DEBUG_LOG("PD_WEBHOOK: Failed to parse NetBox response: " << errors);
-        return -1;
-    }
+        if (!isTransientFailure(response)) {
+            state->breaker->onSuccess();
+            if (state->attempts > 1) {
+                g_retry_policy->recordRecovered();
+            }
+            state->done(response);
+            return;
+        }
 
-    if (root["results"].size() == 0) {
-        return -1;
-    }
+        if (state->breaker->onFailure()) {
+            ERROR_LOG(ErrorCode::CIRCUIT_OPEN, state->endpoint,
+                      std::string("PD_WEBHOOK: Circuit breaker for ") + state->endpoint + " opened");
+        }
+        bool resendable = state->request.idempotent || neverSent(response);
+        if (!resendable || !g_retry_policy->shouldRetry(state->attempts) || !g_retry_scheduler) {
+            if (state->attempts > 1) {
+                g_retry_policy->recordExhausted();
+            }
+            g_errors.record(response.code == CURLE_FAILED_INIT ? ErrorCode::CURL_INIT_FAILED
+                                                                : ErrorCode::HTTP_REQUEST_FAILED,
+                            state->endpoint);
+            state->done(response);
+            return;
+        }
+
+        g_retry_policy->recordRetry();
+        g_retry_scheduler->schedule(g_retry_policy->backoff(state->attempts),
+                                    [state, response](bool due) {
+            if (due) {
+                submitAttempt(state);
+            } else {
+                g_errors.record(ErrorCode::HTTP_REQUEST_FAILED, state->endpoint);
+                state->done(response);
+            }
+        });
+    });
+}
 
-    return root["results"][0]["id"].asInt();
+// Submit a request with retries and circuit breaking for the given endpoint
+static void
+submitWithRetry(HttpRequest&& request, CircuitBreaker* breaker, const char* endpoint, HttpCompletion done) {
+    auto state = std::make_shared<RetryState>();
+    state->request = std::move(request);
+    state->breaker = breaker;
+    state->endpoint = endpoint;
+    state->done = std::move(done);
+    state->attempts = 0;
+    submitAttempt(state);
 }
 
-// Update existing prefix with new data
-static bool
-updatePrefix(int prefix_id, const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft,
-              const std::string& status = "active") {
-    std::string endpoint = "ipam/prefixes/" + std::to_string(prefix_id) + "/";
-
-    // Calculate expiration timestamp (current time + valid lifetime)
-    time_t now = time(nullptr);
-    time_t expires_at = now + valid_lft;
-
-    Json::Value payload;
-    payload["status"] = status;
-    payload["description"] = "DHCPv6 PD assignment - IAID: " + std::to_string(data.iaid);
-
-    Json::Value custom_fields;
-    custom_fields["dhcpv6_client_duid"] = data.client_duid;
-    custom_fields["dhcpv6_iaid"] = static_cast<int>(data.iaid);
-    custom_fields["dhcpv6_cpe_link_local"] = data.cpe_link_local;
-    custom_fields["dhcpv6_router_ip"] = data.router_ip;
-    custom_fields["dhcpv6_router_link_addr"] = data.router_link_addr;
-    custom_fields["dhcpv6_leasetime"] = static_cast<int>(expires_at);
-    payload["custom_fields"] = custom_fields;
-
-    Json::StreamWriterBuilder builder;
-    builder["indentation"] = "";
-    std::string payload_str = Json::writeString(builder, payload);
-    DEBUG_LOG("PD_WEBHOOK: updatePrefix payload: " << payload_str);
-
-    std::string response = netboxHttpRequest("PATCH", endpoint, payload_str);
-
-    if (response.empty()) {
-        return false;
+// Webhook body bytes before and after "webhook-compression"
+static std::atomic<uint64_t> g_webhook_raw_bytes{0};
+static std::atomic<uint64_t> g_webhook_sent_bytes{0};
+
+// Post JSON payload to the configured webhook URL; done runs once the post has finished
+// and tells whether it was delivered or refused for good (false: worth replaying).
+static void
+postWebhook(std::string&& body, std::function<void(bool)> done) {
+    if (!g_cfg.enabled || g_cfg.url.empty() || !g_transport) {
+        done(true);
+        return;
     }
 
-    // Check if update was successful
-    if (response.find("\"id\":") != std::string::npos) {
-        return true;
+    if (!g_webhook_limiter->acquire()) {
+        done(false);
+        return;
     }
 
-    return false;
+    HttpRequest request;
+    request.method = "POST";
+    request.url = g_cfg.url;
+    if (g_cfg.webhook_compression == Compression::NONE) {
+        request.body = std::move(body);
+    } else {
+        // The headers announce the encoding, so a body that cannot be compressed is not sent.
+        if (!compressBody(g_cfg.webhook_compression, body, request.body)) {
+            g_webhook_limiter->release();
+            ERROR_LOG(ErrorCode::HTTP_REQUEST_FAILED, "webhook", "PD_WEBHOOK: Webhook body compression failed");
+            done(false);
+            return;
+        }
+        g_webhook_raw_bytes.fetch_add(body.size(), std::memory_order_relaxed);
+        g_webhook_sent_bytes.fetch_add(request.body.size(), std::memory_order_relaxed);
+    }
+    request.headers = g_pool->webhookHeaders();
+    request.timeout_ms = g_cfg.timeout_ms;
+    request.keep_body = false;
+    request.trace = t_trace;
+
+    // Errors are intentionally ignored once retries are used up; this library is notification-only.
+    submitWithRetry(std::move(request), g_webhook_breaker.get(), "webhook", [done](const HttpResponse& response) {
+        g_webhook_limiter->release();
+        done(!isTransientFailure(response));
+    });
 }
 
-// Update existing prefix to mark as expired
-static bool
-updateExpiredPrefix(int prefix_id, const PdAssignmentData& data) {
-    std::string endpoint = "ipam/prefixes/" + std::to_string(prefix_id) + "/";
+// One webhook payload waiting for its NDJSON batch
+struct WebhookLine {
+    std::string body;
+    std::function<void(bool)> done;
+};
 
-    Json::Value payload;
-    payload["status"] = "deprecated";  // Just mark as deprecated/expired
+// Collects payloads when "webhook-format" is "ndjson"; null otherwise
+static std::unique_ptr<Batcher<WebhookLine>> g_webhook_batcher;
 
-    Json::StreamWriterBuilder builder;
-    builder["indentation"] = "";
-    std::string payload_str = Json::writeString(builder, payload);
-    DEBUG_LOG("PD_WEBHOOK: updateExpiredPrefix payload: " << payload_str);
+// Batcher flush: post the payloads as one newline-delimited body; every line
+// shares the outcome of the post
+static void
+postWebhookLines(std::vector<WebhookLine>&& batch) {
+    auto lines = std::make_shared<std::vector<WebhookLine>>(std::move(batch));
+    size_t size = 0;
+    for (const WebhookLine& line : *lines) {
+        size += line.body.size() + 1;
+    }
+    std::string body;
+    body.reserve(size);
+    for (WebhookLine& line : *lines) {
+        body.append(line.body);
+        body.push_back('\n');
+        std::string().swap(line.body);
+    }
+    postWebhook(std::move(body), [lines](bool ok) {
+        for (const WebhookLine& line : *lines) {
+            line.done(ok);
+        }
+    });
+}
+
+// Post one payload, or add it to the next NDJSON batch
+static void
+sendWebhook(std::string&& body, std::function<void(bool)> done) {
+    if (g_webhook_batcher) {
+        g_webhook_batcher->add(WebhookLine{std::move(body), std::move(done)});
+        return;
+    }
+    postWebhook(std::move(body), std::move(done));
+}
 
-    std::string response = netboxHttpRequest("PATCH", endpoint, payload_str);
+// The pd_assigned post of one packet, carrying each of its PD leases that
+// goes to the webhook. Its events are delivered on their own; the first to
+// reach the webhook sends the post and the others complete with its outcome.
+struct PacketWebhook {
+    std::vector<PdEvent> leases;     // Copies of the events, without this pointer
+    time_t now{0};                   // When the packet was handled
+    std::mutex mutex;
+    bool started{false};
+    bool finished{false};
+    bool ok{false};
+    std::vector<std::function<void(bool)>> waiting;
+};
 
-    if (response.empty()) {
+// Join the post of a packet's webhook: true if another of its events sends
+// it, and done gets its outcome; false if the caller sends it and reports
+// the outcome to finishPacketWebhook()
+static bool
+joinPacketWebhook(PacketWebhook& packet, std::function<void(bool)> done) {
+    std::unique_lock<std::mutex> lock(packet.mutex);
+    if (!packet.started) {
+        packet.started = true;
         return false;
     }
-
-    // Check if update was successful
-    if (response.find("\"id\":") != std::string::npos) {
+    if (!packet.finished) {
+        packet.waiting.push_back(std::move(done));
         return true;
     }
-
-    return false;
+    bool ok = packet.ok;
+    lock.unlock();
+    done(ok);
+    return true;
 }
 
-// Create new prefix in NetBox
-static bool
-createPrefix(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) {
-    // Calculate expiration timestamp (current time + valid lifetime)
-    time_t now = time(nullptr);
-    time_t expires_at = now + valid_lft;
-
-    Json::Value payload;
-    payload["prefix"] = data.prefix + "/" + std::to_string(data.prefix_length);
-    payload["status"] = "active";
-    payload["description"] = "DHCPv6 PD assignment - IAID: " + std::to_string(data.iaid);
-
-    Json::Value custom_fields;
-    custom_fields["dhcpv6_client_duid"] = data.client_duid;
-    custom_fields["dhcpv6_iaid"] = static_cast<int>(data.iaid);
-    custom_fields["dhcpv6_cpe_link_local"] = data.cpe_link_local;
-    custom_fields["dhcpv6_router_ip"] = data.router_ip;
-    custom_fields["dhcpv6_router_link_addr"] = data.router_link_addr;
-    custom_fields["dhcpv6_leasetime"] = static_cast<int>(expires_at);
-    payload["custom_fields"] = custom_fields;
-
-    Json::StreamWriterBuilder builder;
-    builder["indentation"] = "";
-    std::string payload_str = Json::writeString(builder, payload);
-    DEBUG_LOG("PD_WEBHOOK: createPrefix payload: " << payload_str);
-
-    std::string response = netboxHttpRequest("POST", "ipam/prefixes/", payload_str);
-
-    if (response.empty()) {
-        return false;
+static void
+finishPacketWebhook(PacketWebhook& packet, bool ok) {
+    std::vector<std::function<void(bool)>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(packet.mutex);
+        packet.finished = true;
+        packet.ok = ok;
+        waiting.swap(packet.waiting);
     }
+    for (const auto& done : waiting) {
+        done(ok);
+    }
+}
 
-    // Check if creation was successful
-    if (response.find("\"id\":") != std::string::npos) {
-        return true;
+// NetBox backend selected by "netbox-client", created in load(); null when NetBox is off
+static std::unique_ptr<INetBoxClient> g_netbox;
+
+// Sender for the HTTP NetBox client: retries and circuit breaking on the NetBox breaker
+static void
+sendNetBoxHttp(HttpRequest&& request, HttpCompletion done) {
+    if (!g_transport) {
+        HttpResponse response;
+        response.code = CURLE_FAILED_INIT;
+        done(response);
+        return;
     }
+    request.trace = t_trace;
+    submitWithRetry(std::move(request), g_netbox_breaker.get(), "NetBox", std::move(done));
+}
+
+// One of the NetBox instances of "netbox-backends", with its own prefix ID
+// cache, in-flight limit, rate limit, breaker and lane
+struct NetBoxBackend {
+    std::string name;
+    const char* endpoint;                    // "NetBox <name>" in errors, logs and spans
+    bool mirror{false};
+    std::unique_ptr<PrefixTable> ids;        // Holds the prefix ID cache; null when it is disabled
+    std::unique_ptr<CircuitBreaker> breaker;
+    std::unique_ptr<TokenBucket> rate;       // Null without a rate limit
+    std::unique_ptr<InflightLimiter> limiter;
+    std::unique_ptr<INetBoxClient> client;
+    std::unique_ptr<WorkLane> lane;
+    std::unique_ptr<Reconciler> reconciler;  // Null unless this backend is reconciled
+    ShardedCounter sent;                     // NetBox parts of events, by outcome
+    ShardedCounter failed;
+};
+
+// Set instead of g_netbox when "netbox-backends" is configured
+static std::vector<std::unique_ptr<NetBoxBackend>> g_backends;
+static std::unique_ptr<NetBoxRouter> g_router;
+
+// Endpoint name of a backend. Recorded errors keep the pointer past unload,
+// so the names are kept for the life of the process.
+static const char*
+backendEndpoint(const std::string& name) {
+    static std::mutex mutex;
+    static std::set<std::string> names;
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.insert("NetBox " + name).first->c_str();
+}
 
-    return false;
+// Sender for one backend's client: retries and circuit breaking on its own breaker
+static void
+sendBackendHttp(NetBoxBackend& backend, HttpRequest&& request, HttpCompletion done) {
+    if (!g_transport) {
+        HttpResponse response;
+        response.code = CURLE_FAILED_INIT;
+        done(response);
+        return;
+    }
+    request.trace = t_trace;
+    submitWithRetry(std::move(request), backend.breaker.get(), backend.endpoint, std::move(done));
 }
 
-// Send request to NetBox API with check-then-create-or-update logic
+// Push an assignment to NetBox; done runs when the transaction ends and tells
+// whether NetBox now holds the assignment. With track, the renewal filter
+// learns what was written.
 static void
-sendNetBoxRequest(const PdAssignmentData& data, uint32_t valid_lft, uint32_t preferred_lft) {
-    DEBUG_LOG("PD_WEBHOOK: sendNetBoxRequest called for prefix " << data.prefix << "/" << data.prefix_length
+sendNetBoxRequest(INetBoxClient* netbox, bool track, const PdAssignmentData& data, uint32_t valid_lft,
+                  uint32_t preferred_lft, std::function<void(bool)> done) {
+    DEBUG_LOG("PD_WEBHOOK: sendNetBoxRequest called for prefix " << data.prefix
               << " (valid_lft=" << valid_lft << ", preferred_lft=" << preferred_lft << ")");
 
-    if (!g_cfg.netbox_enabled || g_cfg.netbox_url.empty() || g_cfg.netbox_token.empty()) {
+    if (!netbox) {
         DEBUG_LOG("PD_WEBHOOK: NetBox not properly configured");
+        done(true);
         return;
     }
 
-    // Check if prefix already exists
-    int existing_prefix_id = findPrefixId(data.prefix, data.prefix_length);
+    // Remember what NetBox now holds, so unchanged renewals can be suppressed
+    auto txn = std::make_shared<PdAssignmentData>(data);
+    time_t expires_at = time(nullptr) + valid_lft;
+    netbox->assign(data, valid_lft, preferred_lft, [txn, expires_at, track, done](bool ok) {
+        if (g_renewal_filter && track) {
+            if (ok) {
+                g_renewal_filter->record(*txn, expires_at);
+            } else {
+                g_renewal_filter->forget(txn->prefix);
+            }
+        }
+        done(ok);
+    });
+}
 
-    if (existing_prefix_id > 0) {
-        // Update existing prefix
-        updatePrefix(existing_prefix_id, data, valid_lft, preferred_lft);
-    } else {
-        // Create new prefix
-        createPrefix(data, valid_lft, preferred_lft);
+// Mark an expired prefix as deprecated in NetBox; done tells whether NetBox is up to date
+static void
+expireNetBoxPrefix(INetBoxClient* netbox, const PdAssignmentData& data, std::function<void(bool)> done) {
+    if (!netbox) {
+        done(true);
+        return;
+    }
+
+    DEBUG_LOG("PD_WEBHOOK: Updating NetBox for expired prefix " << data.prefix);
+
+    // The next assignment of this prefix must be pushed in full
+    if (g_renewal_filter) {
+        g_renewal_filter->forget(data.prefix);
     }
+    netbox->expire(data, std::move(done));
 }
 
-// Extract client DUID from CLIENTID option
-static std::string
-extractClientDuid(const Pkt6Ptr& query) {
-    OptionPtr clientid_opt = query->getOption(D6O_CLIENTID);
-    if (clientid_opt) {
-        const std::vector<uint8_t>& d = clientid_opt->getData();
-        return toHex(d);
+// Send the NetBox part of an event through a backend's lane: the rate limit,
+// the in-flight limit and, with the easy engine, the request itself wait on
+// the lane's threads instead of a sender thread. done gets the outcome; a
+// mirror's failures are only counted, so it always gets true from one.
+static void
+sendToBackend(NetBoxBackend& backend, const PdEvent& ev, std::function<void(bool)> done) {
+    NetBoxBackend* b = &backend;
+    auto finish = [b, done](bool ok) {
+        (ok ? b->sent : b->failed).add();
+        done(ok || b->mirror);
+    };
+    bool posted = b->lane->post([b, ev, finish](bool run) {
+        if (!run) {
+            finish(false);
+            return;
+        }
+        t_log_sampled = ev.log_sampled;
+        TraceScope trace_scope(ev.trace);
+        TokenBucket::Admission admission = b->rate ?
+            b->rate->acquire(ev.low_priority, std::chrono::milliseconds(g_cfg.low_priority_max_wait_ms)) :
+            TokenBucket::Admission::GRANTED;
+        if (admission != TokenBucket::Admission::GRANTED) {
+            if (admission == TokenBucket::Admission::SHED) {
+                DEBUG_LOG("PD_WEBHOOK: NetBox update for " << ev.data.prefix << " shed by the rate limit of "
+                          << b->name);
+            }
+            finish(admission == TokenBucket::Admission::SHED);
+            return;
+        }
+        if (!b->limiter->acquire()) {
+            finish(false);
+            return;
+        }
+        auto netbox_done = [b, finish](bool ok) {
+            b->limiter->release();
+            finish(ok);
+        };
+        if (ev.type == PdEventType::EXPIRED) {
+            expireNetBoxPrefix(b->client.get(), ev.data, netbox_done);
+        } else {
+            sendNetBoxRequest(b->client.get(), !b->mirror, ev.data, ev.valid_lft, ev.preferred_lft, netbox_done);
+        }
+    });
+    if (!posted) {
+        g_errors.record(ErrorCode::EVENT_DROPPED, b->endpoint);
+        DEBUG_LOG("PD_WEBHOOK: Lane of NetBox backend " << b->name << " full, update for "
+                  << ev.data.prefix << " dropped");
+        finish(false);
     }
-    return "";
 }
 
-// Extract CPE link-local address from DHCPv6 relay message peer-address
-static std::string
-extractCpeLinkLocal(const Pkt6Ptr& query) {
-    DEBUG_LOG("PD_WEBHOOK: >>> extractCpeLinkLocal() called");
+// expireBatch() of a sweep's prefixes on one backend, through its lane as in
+// sendToBackend(); done runs once for every index
+static void
+expireBatchOnBackend(NetBoxBackend& backend, std::vector<PdAssignmentData>&& prefixes,
+                     INetBoxClient::BatchCompletion done) {
+    NetBoxBackend* b = &backend;
+    auto finish = [b, done](size_t j, bool ok) {
+        (ok ? b->sent : b->failed).add();
+        done(j, ok || b->mirror);
+    };
+    auto batch = std::make_shared<std::vector<PdAssignmentData>>(std::move(prefixes));
+    auto finish_all = [finish, batch](bool ok) {
+        for (size_t j = 0; j < batch->size(); ++j) {
+            finish(j, ok);
+        }
+    };
+    TraceContext trace = t_trace;
+    bool posted = b->lane->post([b, batch, trace, finish, finish_all](bool run) {
+        if (!run) {
+            finish_all(false);
+            return;
+        }
+        TraceScope trace_scope(trace);
+        TokenBucket::Admission admission = b->rate ?
+            b->rate->acquire(false, std::chrono::milliseconds(g_cfg.low_priority_max_wait_ms)) :
+            TokenBucket::Admission::GRANTED;
+        if (admission != TokenBucket::Admission::GRANTED) {
+            finish_all(admission != TokenBucket::Admission::CLOSED);
+            return;
+        }
+        if (!b->limiter->acquire()) {
+            finish_all(false);
+            return;
+        }
+        auto left = std::make_shared<std::atomic<size_t>>(batch->size());
+        b->client->expireBatch(*batch, [b, finish, left](size_t j, bool ok) {
+            finish(j, ok);
+            if (left->fetch_sub(1) == 1) {
+                b->limiter->release();
+            }
+        });
+    });
+    if (!posted) {
+        g_errors.record(ErrorCode::EVENT_DROPPED, b->endpoint);
+        finish_all(false);
+    }
+}
 
-    if (!query || query->relay_info_.empty()) {
-        return "";
+// Background cache warm-up, started in load() when "cache-warmup" is "background"
+static std::thread g_warmup_thread;
+static std::atomic<bool> g_warmup_stop{false};
+
+// Periodic lease database reconciliation, when "reconcile-interval-sec" is set
+static std::unique_ptr<Reconciler> g_reconciler;
+
+// Client and relay details of one query, read once per packet and shared by
+// every PD lease in it. Everything stays binary; text is only produced when a
+// payload is serialized.
+class RelayContext {
+public:
+    explicit RelayContext(const Pkt6Ptr& query) {
+        if (query && !query->relay_info_.empty()) {
+            toIp6(query->relay_info_[0].peeraddr_, peer_addr_);
+            toIp6(query->relay_info_[0].linkaddr_, link_addr_);
+            toIp6(query->getRemoteAddr(), remote_addr_);
+            if (peer_addr_.present && isLinkLocal(peer_addr_)) {
+                cpe_link_local_ = peer_addr_;
+            }
+        }
+        OptionPtr clientid_opt = query ? query->getOption(D6O_CLIENTID) : OptionPtr();
+        if (clientid_opt) {
+            const std::vector<uint8_t>& duid = clientid_opt->getData();
+            duid_.assign(duid.data(), duid.size());
+        }
     }
 
-    const Pkt6::RelayInfo& relay = query->relay_info_[0];
-    std::string peer_address = relay.peeraddr_.toText();
+    // Client DUID from the CLIENTID option
+    const Duid& clientDuid() const {
+        return duid_;
+    }
 
-    DEBUG_LOG("PD_WEBHOOK: Extracted peer address: " << peer_address);
+    // Peer-address of the first relay as sent in the webhook, absent if not relayed
+    const Ip6Address& peerAddr() const {
+        return peer_addr_;
+    }
 
-    // Verify it's a link-local address
-    if (!peer_address.empty() && peer_address.find("fe80::") == 0) {
-        return peer_address;
+    // Relay peer-address if it is the CPE's link-local address, otherwise absent
+    const Ip6Address& cpeLinkLocal() const {
+        return cpe_link_local_;
     }
 
-    return "";
-}
+    // Source of the relayed packet
+    const Ip6Address& routerIp() const {
+        return remote_addr_;
+    }
 
-// Extract router IP from relay information
-static std::string
-extractRouterIp(const Pkt6Ptr& query) {
-    if (!query || query->relay_info_.empty()) {
-        return "";
+    // Link-address of the first relay
+    const Ip6Address& routerLinkAddr() const {
+        return link_addr_;
     }
-    
-    // Return the remote address (source of the relay packet)
-    return query->getRemoteAddr().toText();
-}
 
-// Extract router link address from relay information
-static std::string
-extractRouterLinkAddr(const Pkt6Ptr& query) {
-    if (!query || query->relay_info_.empty()) {
-        return "";
+private:
+    // fe80::/64, i.e. text starting with "fe80::"
+    static bool isLinkLocal(const Ip6Address& addr) {
+        static const uint8_t prefix[8] = {0xfe, 0x80, 0, 0, 0, 0, 0, 0};
+        return std::memcmp(addr.bytes, prefix, sizeof(prefix)) == 0;
     }
-    
-    // Return the link address from the first relay
-    const Pkt6::RelayInfo& relay = query->relay_info_[0];
-    return relay.linkaddr_.toText();
-}
+
+    Ip6Address peer_addr_;
+    Ip6Address link_addr_;
+    Ip6Address remote_addr_;
+    Ip6Address cpe_link_local_;
+    Duid duid_;
+};
 
 // Dump relay information for debugging
 static void
@@ -475,7 +939,7 @@ dumpRelayInfo(const Pkt6Ptr& query) {
             DEBUG_LOG("PD_WEBHOOK:     relay-msg: present (" << relay_msg_data.size() << " bytes)");
             
             // Hex dump the relay message data (contains encapsulated DHCPv6 message)
-            if (g_cfg.debug && !relay_msg_data.empty()) {
+            if (!relay_msg_data.empty()) {
                 DEBUG_LOG("PD_WEBHOOK:     relay_msg hex dump:");
                 std::string hexdump = hexDump(relay_msg_data.data(), relay_msg_data.size());
                 std::istringstream iss(hexdump);
@@ -495,8 +959,8 @@ dumpRelayInfo(const Pkt6Ptr& query) {
             DEBUG_LOG("PD_WEBHOOK:       option " << static_cast<unsigned int>(opt_pair.first) 
                      << ": " << opt_data.size() << " bytes");
             
-            // Hex dump the option data if debug is enabled
-            if (g_cfg.debug && !opt_data.empty()) {
+            // Hex dump the option data
+            if (!opt_data.empty()) {
                 std::string hexdump = hexDump(opt_data.data(), opt_data.size());
                 std::istringstream iss(hexdump);
                 std::string line;
@@ -508,371 +972,2490 @@ dumpRelayInfo(const Pkt6Ptr& query) {
     }
 }
 
-// Build a minimal JSON payload for PD leases and send it.
+// Durable copy of undelivered events; null when "spool-path" is not set
+static std::unique_ptr<EventSpool> g_spool;
+
+// Plain refreshes of an existing lease; everything else is a state change
+// that goes ahead of them when an endpoint is rate limited
+static bool
+isLowPriority(const PdEvent& ev) {
+    return ev.type == PdEventType::ASSIGNED && ev.msg_type != DHCPV6_REQUEST && ev.msg_type != DHCPV6_SOLICIT;
+}
+
+// Take a token for an event from a rate-limited endpoint. Delivery inline on a
+// callout thread never waits: events over the limit are shed instead.
+static TokenBucket::Admission
+admitEvent(TokenBucket* bucket, const PdEvent& ev) {
+    if (!bucket) {
+        return TokenBucket::Admission::GRANTED;
+    }
+    if (g_cfg.sender_threads == 0) {
+        return bucket->acquire(true, std::chrono::milliseconds(0));
+    }
+    return bucket->acquire(ev.low_priority, std::chrono::milliseconds(g_cfg.low_priority_max_wait_ms));
+}
+
+// Root span of a sampled event, from its callout until every part of its
+// delivery has finished
 static void
-notifyPdAssigned(const Pkt6Ptr& query6,
-                 const Pkt6Ptr& response6,
-                 const Lease6CollectionPtr& leases6)
-{
-    if (!leases6 || leases6->empty()) {
+recordEventSpan(const TraceContext& trace, PdEventType type, const PrefixKey& prefix, bool delivered) {
+    if (!trace.sampled() || !g_tracer) {
         return;
     }
+    Span span;
+    span.trace_hi = trace.trace_hi;
+    span.trace_lo = trace.trace_lo;
+    span.span_id = trace.span_id;
+    span.name = type == PdEventType::ASSIGNED ? "leases6_committed" :
+                type == PdEventType::EXPIRED ? "lease6_expire" : "lease6_recover";
+    span.start_ns = trace.start_ns;
+    span.end_ns = Tracer::nowNs();
+    span.error = !delivered;
+    span.attribute("pd.prefix", prefix.toText());
+    g_tracer->record(std::move(span));
+}
 
-    // Collect PD leases only.
-    std::vector<Lease6Ptr> pd_leases;
-    DEBUG_LOG("PD_WEBHOOK: Processing " << leases6->size() << " total leases");
-    
-    for (const auto& l : *leases6) {
-        if (!l) {
-            continue;
+// Time a sampled event spent queued, up to now
+static void
+recordQueueWait(const TraceContext& trace) {
+    if (trace.sampled() && trace.queued_ns != 0 && g_tracer) {
+        g_tracer->record(Tracer::childSpan(trace, "queue_wait", trace.queued_ns, Tracer::nowNs()));
+    }
+}
+
+// Deliver one event to the webhook and NetBox; done runs when both have finished.
+// Runs on a sender thread, or inline on the callout thread when the queue is disabled.
+// NetBox work is admitted through the in-flight limiter and may complete later on
+// a transport thread. The spool record of the event is released only if every part
+// succeeded; otherwise it stays pending and is replayed on the next load.
+static void
+deliverEvent(const PdEvent& ev, std::function<void()> done) {
+    // Sender threads follow the sampling decisions made for the packet.
+    t_log_sampled = ev.log_sampled;
+    recordQueueWait(ev.trace);
+    TraceScope trace_scope(ev.trace);
+
+    // Outstanding parts of this delivery, plus one held until both are started
+    auto remaining = std::make_shared<std::atomic<int>>(1);
+    auto failed = std::make_shared<std::atomic<bool>>(false);
+    uint64_t spool_seq = ev.spool_seq;
+    TraceContext trace = ev.trace;
+    PdEventType type = ev.type;
+    PrefixKey prefix = ev.data.prefix;
+    g_deliveries.fetch_add(1, std::memory_order_relaxed);
+    auto part_done = [remaining, failed, spool_seq, trace, type, prefix, done](bool ok) {
+        if (!ok) {
+            failed->store(true, std::memory_order_relaxed);
         }
-        DEBUG_LOG("PD_WEBHOOK: Lease type: " << static_cast<int>(l->type_) 
-                  << " (NA=" << Lease::TYPE_NA 
-                  << ", TA=" << Lease::TYPE_TA 
-                  << ", PD=" << Lease::TYPE_PD << ")"
-                  << " address: " << l->addr_.toText());
-        
-        if (l->type_ == Lease::TYPE_PD) {
-            pd_leases.push_back(l);
+        if (remaining->fetch_sub(1) == 1) {
+            bool delivered = !failed->load(std::memory_order_relaxed);
+            (delivered ? g_stats.sent : g_stats.failed).add();
+            if (g_spool && spool_seq != 0 && delivered) {
+                g_spool->complete(spool_seq);
+            }
+            recordEventSpan(trace, type, prefix, delivered);
+            done();
+            finishDelivery();
+        }
+    };
+
+    if (g_cfg.enabled && !g_cfg.url.empty() && ev.type != PdEventType::RECOVERED &&
+        (ev.sinks & SINK_WEBHOOK)) {
+        remaining->fetch_add(1);
+        std::function<void(bool)> webhook_done = part_done;
+        std::shared_ptr<PacketWebhook> packet = ev.packet;
+        if (packet && joinPacketWebhook(*packet, part_done)) {
+            // Another lease of the packet sends its post
+        } else {
+            if (packet) {
+                webhook_done = [packet, part_done](bool ok) {
+                    finishPacketWebhook(*packet, ok);
+                    part_done(ok);
+                };
+            }
+            TokenBucket::Admission admission = admitEvent(g_webhook_rate.get(), ev);
+            if (admission == TokenBucket::Admission::GRANTED) {
+                uint64_t serialize_start = trace.sampled() ? Tracer::nowNs() : 0;
+                std::string body =
+                    packet ? buildAssignedPayload(packet->leases, packet->now, g_cfg.json_encoder,
+                                                  g_cfg.webhook_fields) :
+                    ev.type == PdEventType::ASSIGNED ?
+                             buildAssignedPayload(ev, g_cfg.json_encoder, g_cfg.webhook_fields) :
+                             buildExpiredPayload(ev, g_cfg.json_encoder, g_cfg.webhook_fields);
+                if (serialize_start != 0 && g_tracer) {
+                    Span span = Tracer::childSpan(trace, "serialize", serialize_start, Tracer::nowNs());
+                    span.attribute("payload.bytes", static_cast<int64_t>(body.size()));
+                    g_tracer->record(std::move(span));
+                }
+                sendWebhook(std::move(body), std::move(webhook_done));
+            } else if (admission == TokenBucket::Admission::SHED) {
+                DEBUG_LOG("PD_WEBHOOK: Webhook for " << ev.data.prefix
+                          << " shed by webhook-rate-limit");
+                webhook_done(true);
+            } else {
+                webhook_done(false);
+            }
         }
     }
 
-    if (pd_leases.empty()) {
-        DEBUG_LOG("PD_WEBHOOK: No PD leases found, returning");
+    if (!g_cfg.netbox_enabled || !(ev.sinks & SINK_NETBOX)) {
+        part_done(true);
         return;
     }
-    
-    DEBUG_LOG("PD_WEBHOOK: found " << pd_leases.size() << " PD leases");
 
-    // Send webhook notification if configured
-    if (g_cfg.enabled && !g_cfg.url.empty()) {
-        // Client DUID (from CLIENTID option, no parsing – just hex).
-        std::string client_duid_hex;
-        OptionPtr clientid_opt = query6->getOption(D6O_CLIENTID);
-        if (clientid_opt) {
-            const std::vector<uint8_t>& d = clientid_opt->getData();
-            client_duid_hex = toHex(d);
-        }
-
-        // Extract relay information for webhook
-        std::string link_addr = "";
-        std::string peer_addr = "";
-        std::string relay_src_addr = "";
-        if (!query6->relay_info_.empty()) {
-            const Pkt6::RelayInfo& relay = query6->relay_info_[0];
-            link_addr = relay.linkaddr_.toText();
-            peer_addr = relay.peeraddr_.toText();
-            // Get the actual source address of the relay packet (relay agent's IP)
-            relay_src_addr = query6->getRemoteAddr().toText();
-            DEBUG_LOG("PD_WEBHOOK: Found relay info - link_addr: " << link_addr << ", peer_addr: " << peer_addr << ", relay_src_addr: " << relay_src_addr);
-        } else {
-            DEBUG_LOG("PD_WEBHOOK: No relay information found (direct message)");
-        }
-
-        // Build JSON using jsoncpp
-        Json::Value payload;
-        payload["event"] = "pd_assigned";
-        payload["msg_type"] = static_cast<int>(query6->getType());
-        payload["reply_type"] = static_cast<int>(response6->getType());
-        payload["client_duid"] = client_duid_hex;
-        payload["link_addr"] = link_addr;
-        payload["peer_addr"] = peer_addr;
-        payload["relay_src_addr"] = relay_src_addr;
+    // Skip updates that would only move the lease time by a small amount
+    if (ev.type == PdEventType::ASSIGNED && g_renewal_filter &&
+        g_renewal_filter->suppress(ev.data, time(nullptr) + ev.valid_lft, ev.valid_lft)) {
+        DEBUG_LOG("PD_WEBHOOK: NetBox update suppressed for unchanged prefix "
+                  << ev.data.prefix);
+        part_done(true);
+        return;
+    }
 
-        Json::Value leases(Json::arrayValue);
-        for (const auto& l : pd_leases) {
-            Json::Value lease_obj;
-            lease_obj["prefix"] = l->addr_.toText();
-            lease_obj["prefix_length"] = static_cast<int>(l->prefixlen_);
-            lease_obj["iaid"] = static_cast<int>(l->iaid_);
-            lease_obj["subnet_id"] = static_cast<int>(l->subnet_id_);
-            lease_obj["preferred_lft"] = static_cast<int>(l->preferred_lft_);
-            lease_obj["valid_lft"] = static_cast<int>(l->valid_lft_);
-            lease_obj["expires_at"] = static_cast<int>(std::time(nullptr) + l->valid_lft_);
-            leases.append(lease_obj);
+    // Several backends: the primary and any mirrors, each through its own lane
+    if (!g_backends.empty()) {
+        uint64_t targets = g_router->targets(ev.subnet_id, ev.data.prefix, &ev.data.router_link_addr,
+                                             ev.type == PdEventType::EXPIRED);
+        for (size_t b = 0; b < g_backends.size(); ++b) {
+            if (targets & (uint64_t(1) << b)) {
+                remaining->fetch_add(1);
+                sendToBackend(*g_backends[b], ev, part_done);
+            }
         }
-        payload["leases"] = leases;
-
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::string payload_str = Json::writeString(builder, payload);
-
-        postWebhook(payload_str);
+        part_done(true);
+        return;
     }
 
-    // Send NetBox requests for each PD lease
-    for (const auto& l : pd_leases) {
-        PdAssignmentData data;
-        data.client_duid = extractClientDuid(query6);
-        data.prefix = l->addr_.toText();
-        data.prefix_length = l->prefixlen_;
-        data.iaid = l->iaid_;
-        data.cpe_link_local = extractCpeLinkLocal(query6);
-        data.router_ip = extractRouterIp(query6);
-        data.router_link_addr = extractRouterLinkAddr(query6);
-
-        DEBUG_LOG("PD_WEBHOOK: Sending NetBox request for prefix " << data.prefix << "/" << data.prefix_length
-                  << " (IAID=" << data.iaid << ", CPE=" << data.cpe_link_local
-                  << ", Router=" << data.router_ip << ", LinkAddr=" << data.router_link_addr << ")");
-
-        sendNetBoxRequest(data, l->valid_lft_, l->preferred_lft_);
+    // A shed renewal leaves NetBox with the previous lease time until the next one.
+    TokenBucket::Admission admission = admitEvent(g_netbox_rate.get(), ev);
+    if (admission != TokenBucket::Admission::GRANTED) {
+        if (admission == TokenBucket::Admission::SHED) {
+            DEBUG_LOG("PD_WEBHOOK: NetBox update for " << ev.data.prefix
+                      << " shed by netbox-rate-limit");
+        }
+        part_done(admission == TokenBucket::Admission::SHED);
+        return;
     }
-}
 
-// Notify PD lease expiration
-static void
-notifyPdExpired(const Lease6Ptr& lease)
-{
-    if (!lease || lease->type_ != Lease::TYPE_PD) {
+    if (!g_netbox_limiter || !g_netbox_limiter->acquire()) {
+        part_done(false);
         return;
     }
-
-    DEBUG_LOG("PD_WEBHOOK: Notifying PD lease expiration for " << lease->addr_.toText() << "/" << lease->prefixlen_);
-
-    // Send webhook notification if configured
-    if (g_cfg.enabled && !g_cfg.url.empty()) {
-        // Build JSON payload for expired lease
-        Json::Value payload;
-        payload["event"] = "pd_expired";
-
-        Json::Value lease_obj;
-        lease_obj["prefix"] = lease->addr_.toText();
-        lease_obj["prefix_length"] = static_cast<int>(lease->prefixlen_);
-        lease_obj["iaid"] = static_cast<int>(lease->iaid_);
-        lease_obj["duid"] = toHex(lease->duid_->getDuid());
-        lease_obj["cltt"] = static_cast<int>(lease->cltt_);
-        lease_obj["valid_lft"] = static_cast<int>(lease->valid_lft_);
-        lease_obj["preferred_lft"] = static_cast<int>(lease->preferred_lft_);
-        payload["lease"] = lease_obj;
-
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::string payload_str = Json::writeString(builder, payload);
-
-        postWebhook(payload_str);
-    }
-
-    // Handle NetBox update for expired leases
-    PdAssignmentData data;
-    data.client_duid = toHex(lease->duid_->getDuid());
-    data.prefix = lease->addr_.toText();
-    data.prefix_length = lease->prefixlen_;
-    data.iaid = lease->iaid_;
-    // For expired leases, relay info may not be available
-    data.cpe_link_local = "";
-    data.router_ip = "";
-    data.router_link_addr = "";
-
-    DEBUG_LOG("PD_WEBHOOK: Updating NetBox for expired prefix " << data.prefix << "/" << data.prefix_length);
-
-    // Check if prefix exists in NetBox and update to expired status
-    int existing_prefix_id = findPrefixId(data.prefix, data.prefix_length);
-    if (existing_prefix_id > 0) {
-        updateExpiredPrefix(existing_prefix_id, data);
-    } else {
-        DEBUG_LOG("PD_WEBHOOK: Prefix not found in NetBox, skipping expired update");
+    remaining->fetch_add(1);
+    auto netbox_done = [part_done](bool ok) {
+        g_netbox_limiter->release();
+        part_done(ok);
+    };
+
+    switch (ev.type) {
+    case PdEventType::ASSIGNED:
+        sendNetBoxRequest(g_netbox.get(), true, ev.data, ev.valid_lft, ev.preferred_lft, netbox_done);
+        break;
+
+    case PdEventType::EXPIRED:
+        expireNetBoxPrefix(g_netbox.get(), ev.data, netbox_done);
+        break;
+
+    case PdEventType::RECOVERED:
+        // Re-activate, creating the prefix if it is missing
+        sendNetBoxRequest(g_netbox.get(), true, ev.data, ev.valid_lft, ev.preferred_lft, netbox_done);
+        break;
     }
+    part_done(true);
 }
 
-// Hook callout: leases6_committed
-extern "C" {
-
-int
-leases6_committed(CalloutHandle& handle) {
-    try {
-        // Always log that hook was called
-        DEBUG_LOG("PD_WEBHOOK: leases6_committed called");
-        
-        if (!g_cfg.enabled) {
-            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
-            return (0);
-        }
-
-        Pkt6Ptr query6;
-        Pkt6Ptr response6;
-        Lease6CollectionPtr leases6;
-        Lease6CollectionPtr deleted_leases6;
+// Sender threads; null when "sender-threads" is 0 and events are delivered inline
+static std::unique_ptr<DispatchQueue> g_queue;
 
-        handle.getArgument("query6", query6);
-        handle.getArgument("response6", response6);
-        handle.getArgument("leases6", leases6);
-        handle.getArgument("deleted_leases6", deleted_leases6);
+// Held while an expiry is put into the sweep or taken back out, and while the
+// sweep hands it over for delivery, so an event that sees the SWEPT mark also
+// finds the expiry in the sweep, or, once the mark is gone, the prefix claimed
+static std::mutex g_sweep_mutex;
 
-        if (!query6 || !response6 || !leases6) {
-            return (0);
+// Deliver the expirations of one sweep: a single pd_expired_batch post and one
+// bulk deprecation in NetBox. Runs on the sweep thread, or on the caller once the
+// sweep has stopped. Each event keeps its own outcome and spool record, as in
+// deliverEvent(). The sweep takes one token and one in-flight slot per endpoint.
+static void
+deliverExpiredBatch(std::vector<PdEvent>&& batch) {
+    struct Sweep {
+        std::vector<PdEvent> events;
+        std::unique_ptr<std::atomic<int>[]> remaining;  // Per event, as in deliverEvent()
+        std::unique_ptr<std::atomic<bool>[]> failed;
+        std::atomic<size_t> netbox_left{0};
+    };
+    auto sweep = std::make_shared<Sweep>();
+    sweep->events.reserve(batch.size());
+    // The expiries have left the sweep, so a later event no longer takes them
+    // back. A prefix with an earlier event still queued, in the intake ring or
+    // being delivered expires behind it in the queue, so the two cannot
+    // overtake each other. The others are claimed in the queue until their
+    // expiry is delivered: a later event waits for it there.
+    std::vector<PrefixKey> keys;
+    keys.reserve(batch.size());
+    std::vector<bool> pending(batch.size(), false);
+    {
+        std::lock_guard<std::mutex> lock(g_sweep_mutex);
+        for (const PdEvent& ev : batch) {
+            g_prefix_table->modify(ev.data.prefix,
+                                   [](PrefixTable::Entry& entry) { entry.flags &= ~PrefixTable::SWEPT; });
+            keys.push_back(ev.data.prefix);
+        }
+        if (g_queue) {
+            g_queue->hasPending(keys, pending, true);
+        }
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        PdEvent& ev = batch[i];
+        if (pending[i]) {
+            // As in dispatchEvent(), the spool record of a dropped event is kept.
+            if (!g_queue->enqueue(std::move(ev))) {
+                g_errors.record(ErrorCode::EVENT_DROPPED, "queue");
+                DEBUG_LOG("PD_WEBHOOK: Dispatch queue full, expiry dropped");
+            }
+        } else {
+            recordQueueWait(ev.trace);
+            sweep->events.push_back(std::move(ev));
+        }
+    }
+    size_t count = sweep->events.size();
+    if (count == 0) {
+        return;
+    }
+    g_deliveries.fetch_add(count, std::memory_order_relaxed);
+    sweep->remaining.reset(new std::atomic<int>[count]);
+    sweep->failed.reset(new std::atomic<bool>[count]);
+    for (size_t i = 0; i < count; ++i) {
+        sweep->remaining[i].store(1);
+        sweep->failed[i].store(false);
+    }
+    auto part_done = [sweep](size_t i, bool ok) {
+        if (!ok) {
+            sweep->failed[i].store(true, std::memory_order_relaxed);
+        }
+        if (sweep->remaining[i].fetch_sub(1) == 1) {
+            bool delivered = !sweep->failed[i].load(std::memory_order_relaxed);
+            (delivered ? g_stats.sent : g_stats.failed).add();
+            const PdEvent& ev = sweep->events[i];
+            if (g_spool && ev.spool_seq != 0 && delivered) {
+                g_spool->complete(ev.spool_seq);
+            }
+            recordEventSpan(ev.trace, ev.type, ev.data.prefix, delivered);
+            if (g_queue) {
+                g_queue->unclaim(ev.data.prefix);
+            }
+            finishDelivery();
+        }
+    };
+    auto all_done = [part_done, count](bool ok) {
+        for (size_t i = 0; i < count; ++i) {
+            part_done(i, ok);
+        }
+    };
+    auto admit = [](TokenBucket* bucket) {
+        return bucket ? bucket->acquire(false, std::chrono::milliseconds(g_cfg.low_priority_max_wait_ms)) :
+                        TokenBucket::Admission::GRANTED;
+    };
+
+    t_log_sampled = sweep->events.front().log_sampled;
+    DEBUG_LOG("PD_WEBHOOK: Delivering expiry sweep of " << count << " prefixes");
+
+    // The sweep's requests are shared, so they are traced under the first sampled event.
+    TraceContext sweep_trace;
+    for (const PdEvent& ev : sweep->events) {
+        if (ev.trace.sampled()) {
+            sweep_trace = ev.trace;
+            break;
+        }
+    }
+    TraceScope trace_scope(sweep_trace);
+
+    // Events of the sweep each sink receives; an event filter may leave some out
+    std::vector<size_t> to_webhook;
+    std::vector<size_t> to_netbox;
+    for (size_t i = 0; i < count; ++i) {
+        if (sweep->events[i].sinks & SINK_WEBHOOK) {
+            to_webhook.push_back(i);
+        }
+        if (sweep->events[i].sinks & SINK_NETBOX) {
+            to_netbox.push_back(i);
+        }
+    }
+    auto mark_failed = [sweep](const std::vector<size_t>& indices) {
+        for (size_t i : indices) {
+            sweep->failed[i].store(true, std::memory_order_relaxed);
+        }
+    };
+
+    if (g_cfg.enabled && !g_cfg.url.empty() && !to_webhook.empty()) {
+        TokenBucket::Admission admission = admit(g_webhook_rate.get());
+        if (admission == TokenBucket::Admission::GRANTED) {
+            std::string body;
+            if (to_webhook.size() == count) {
+                body = buildExpiredBatchPayload(sweep->events, g_cfg.json_encoder, g_cfg.webhook_fields);
+            } else {
+                std::vector<PdEvent> events;
+                events.reserve(to_webhook.size());
+                for (size_t i : to_webhook) {
+                    events.push_back(sweep->events[i]);
+                }
+                body = buildExpiredBatchPayload(events, g_cfg.json_encoder, g_cfg.webhook_fields);
+            }
+            for (size_t i : to_webhook) {
+                sweep->remaining[i].fetch_add(1);
+            }
+            sendWebhook(std::move(body), [part_done, to_webhook](bool ok) {
+                for (size_t i : to_webhook) {
+                    part_done(i, ok);
+                }
+            });
+        } else if (admission == TokenBucket::Admission::SHED) {
+            DEBUG_LOG("PD_WEBHOOK: Webhook for expiry sweep shed by webhook-rate-limit");
+        } else {
+            mark_failed(to_webhook);
+        }
+    }
+
+    // Several backends: each gets the expirations routed to it as one batch on its lane.
+    if (g_cfg.netbox_enabled && !g_backends.empty() && !to_netbox.empty()) {
+        std::vector<std::vector<size_t>> routed(g_backends.size());
+        for (size_t i : to_netbox) {
+            const PdEvent& ev = sweep->events[i];
+            if (g_renewal_filter) {
+                g_renewal_filter->forget(ev.data.prefix);
+            }
+            uint64_t targets = g_router->targets(ev.subnet_id, ev.data.prefix, &ev.data.router_link_addr, true);
+            for (size_t b = 0; b < g_backends.size(); ++b) {
+                if (targets & (uint64_t(1) << b)) {
+                    routed[b].push_back(i);
+                }
+            }
+        }
+        for (size_t b = 0; b < g_backends.size(); ++b) {
+            if (routed[b].empty()) {
+                continue;
+            }
+            std::vector<PdAssignmentData> prefixes;
+            prefixes.reserve(routed[b].size());
+            for (size_t i : routed[b]) {
+                prefixes.push_back(sweep->events[i].data);
+                sweep->remaining[i].fetch_add(1);
+            }
+            std::vector<size_t> indices = std::move(routed[b]);
+            expireBatchOnBackend(*g_backends[b], std::move(prefixes), [part_done, indices](size_t j, bool ok) {
+                part_done(indices[j], ok);
+            });
+        }
+        all_done(true);
+        return;
+    }
+
+    if (!g_cfg.netbox_enabled || !g_netbox || to_netbox.empty()) {
+        all_done(true);
+        return;
+    }
+    TokenBucket::Admission admission = admit(g_netbox_rate.get());
+    if (admission != TokenBucket::Admission::GRANTED) {
+        if (admission == TokenBucket::Admission::CLOSED) {
+            mark_failed(to_netbox);
+        }
+        all_done(true);
+        return;
+    }
+    if (!g_netbox_limiter || !g_netbox_limiter->acquire()) {
+        mark_failed(to_netbox);
+        all_done(true);
+        return;
+    }
+
+    std::vector<PdAssignmentData> prefixes;
+    prefixes.reserve(to_netbox.size());
+    for (size_t i : to_netbox) {
+        // The next assignment of this prefix must be pushed in full
+        if (g_renewal_filter) {
+            g_renewal_filter->forget(sweep->events[i].data.prefix);
+        }
+        prefixes.push_back(sweep->events[i].data);
+        sweep->remaining[i].fetch_add(1);
+    }
+    sweep->netbox_left.store(to_netbox.size());
+    g_netbox->expireBatch(prefixes, [sweep, part_done, to_netbox](size_t j, bool ok) {
+        part_done(to_netbox[j], ok);
+        if (sweep->netbox_left.fetch_sub(1) == 1) {
+            g_netbox_limiter->release();
+        }
+    });
+    all_done(true);
+}
+
+// Collects lease6_expire events into sweeps; null when "expire-batch-max-items" is 1
+static std::unique_ptr<Batcher<PdEvent>> g_expire_sweep;
+
+// Expirations taken out of the sweep by a later event for their prefix
+static std::atomic<uint64_t> g_sweep_coalesced{0};
+
+// Hold an expiry in the sweep and mark its prefix SWEPT; false, leaving ev
+// alone, if the state table has no room for the mark
+static bool
+holdInSweep(PdEvent& ev) {
+    std::lock_guard<std::mutex> lock(g_sweep_mutex);
+    if (!g_prefix_table->update(ev.data.prefix, [](PrefixTable::Entry& entry) {
+            entry.flags |= PrefixTable::SWEPT;
+        })) {
+        return false;
+    }
+    g_expire_sweep->add(std::move(ev));
+    return true;
+}
+
+// An event for a prefix whose expiry is still held in the sweep supersedes it,
+// as in the queue's coalescing: the sweep could otherwise deprecate the prefix
+// after the newer event made it active again. The event inherits the sinks and
+// the priority of the expiry.
+static void
+takeFromSweep(PdEvent& ev) {
+    bool swept = false;
+    g_prefix_table->modify(ev.data.prefix, [&swept](PrefixTable::Entry& entry) {
+        swept = (entry.flags & PrefixTable::SWEPT) != 0;
+    });
+    if (!swept) {
+        return;
+    }
+
+    // A marked expiry missing from the sweep is being handed over for
+    // delivery; the mark goes once its prefix is claimed, which the event
+    // then waits for in the queue.
+    std::vector<PdEvent> taken;
+    const PrefixKey& prefix = ev.data.prefix;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(g_sweep_mutex);
+            taken = g_expire_sweep->take([&prefix](const PdEvent& held) { return held.data.prefix == prefix; });
+            if (!taken.empty()) {
+                g_prefix_table->modify(prefix, [](PrefixTable::Entry& entry) { entry.flags &= ~PrefixTable::SWEPT; });
+            }
+        }
+        if (!taken.empty()) {
+            break;
+        }
+        std::this_thread::yield();
+        swept = false;
+        g_prefix_table->modify(prefix, [&swept](PrefixTable::Entry& entry) {
+            swept = (entry.flags & PrefixTable::SWEPT) != 0;
+        });
+        if (!swept) {
+            return;
+        }
+    }
+    for (const PdEvent& expiry : taken) {
+        ev.sinks |= expiry.sinks;
+        ev.low_priority = false;
+        // Usually released already by the newer event's record
+        if (g_spool && expiry.spool_seq != 0) {
+            g_spool->complete(expiry.spool_seq);
+        }
+        g_sweep_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Hand an event over to the sender threads
+static void
+dispatchEvent(PdEvent&& ev) {
+    ev.log_sampled = t_log_sampled;
+    ev.low_priority = isLowPriority(ev);
+    bool traced = g_tracer && g_tracer->startTrace(ev.trace);
+
+    // Replayed events already have their record.
+    if (g_spool && ev.spool_seq == 0) {
+        ev.spool_seq = g_spool->append(ev);
+    }
+
+    // Unloading: the spool record, if any, carries the event to the next load.
+    if (!g_accepting.load(std::memory_order_relaxed)) {
+        g_refused.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool sweep = ev.type == PdEventType::EXPIRED && g_expire_sweep;
+    if (g_expire_sweep && !sweep) {
+        takeFromSweep(ev);
+    }
+    if (!g_queue && !sweep) {
+        deliverEvent(ev, [] {});
+        return;
+    }
+
+    // The event is gone once queued, so its trace is kept for the enqueue span.
+    TraceContext trace;
+    if (traced) {
+        ev.trace.queued_ns = Tracer::nowNs();
+        trace = ev.trace;
+    }
+    if (sweep && holdInSweep(ev)) {
+        // Delivered with the sweep; without room for its mark it goes on its own below
+    } else if (!g_queue) {
+        deliverEvent(ev, [] {});
+    } else if (!g_queue->enqueue(std::move(ev))) {
+        g_errors.record(ErrorCode::EVENT_DROPPED, "queue");
+        DEBUG_LOG("PD_WEBHOOK: Dispatch queue full, event dropped");
+    }
+    if (traced) {
+        g_tracer->record(Tracer::childSpan(trace, "enqueue", trace.start_ns, Tracer::nowNs()));
+    }
+}
+
+// Sinks an event goes to, counting the ones a filter keeps it from;
+// 0 when it goes nowhere and is not queued at all
+static uint8_t
+eventSinks(const EventFilter::Input& input) {
+    uint8_t sinks = SINK_WEBHOOK | SINK_NETBOX;
+    if (g_cfg.webhook_filter.active() && !g_cfg.webhook_filter.matches(input)) {
+        sinks &= ~SINK_WEBHOOK;
+        g_stats.filtered_webhook.add();
+    }
+    if (g_cfg.netbox_filter.active() && !g_cfg.netbox_filter.matches(input)) {
+        sinks &= ~SINK_NETBOX;
+        g_stats.filtered_netbox.add();
+    }
+    if (sinks == 0) {
+        g_stats.filtered.add();
+    }
+    return sinks;
+}
+
+// Queue one pd_assigned event per PD lease in the packet. The webhook still
+// receives a single post for the packet, listing all of its PD leases.
+static void
+notifyPdAssigned(const Pkt6Ptr& query6,
+                 const Pkt6Ptr& response6,
+                 const Lease6CollectionPtr& leases6,
+                 RelayContext& relay)
+{
+    if (!leases6 || leases6->empty()) {
+        return;
+    }
+
+    // Collect PD leases only.
+    std::vector<Lease6Ptr> pd_leases;
+    DEBUG_LOG("PD_WEBHOOK: Processing " << leases6->size() << " total leases");
+    
+    for (const auto& l : *leases6) {
+        if (!l) {
+            continue;
+        }
+        DEBUG_LOG("PD_WEBHOOK: Lease type: " << static_cast<int>(l->type_) 
+                  << " (NA=" << Lease::TYPE_NA 
+                  << ", TA=" << Lease::TYPE_TA 
+                  << ", PD=" << Lease::TYPE_PD << ")"
+                  << " address: " << l->addr_.toText());
+        
+        if (l->type_ == Lease::TYPE_PD) {
+            pd_leases.push_back(l);
+        }
+    }
+
+    if (pd_leases.empty()) {
+        DEBUG_LOG("PD_WEBHOOK: No PD leases found, returning");
+        return;
+    }
+    
+    DEBUG_LOG("PD_WEBHOOK: found " << pd_leases.size() << " PD leases");
+
+    std::vector<PdEvent> events;
+    events.reserve(pd_leases.size());
+    for (const auto& l : pd_leases) {
+        g_stats.received_committed.add();
+
+        // Filtered on the raw lease, before anything is built for the event
+        EventFilter::Input input{PdEventType::ASSIGNED, query6->getType(), l->subnet_id_,
+                                 l->prefixlen_, &relay.routerLinkAddr()};
+        uint8_t sinks = eventSinks(input);
+        if (sinks == 0) {
+            continue;
+        }
+
+        PdEvent ev;
+        ev.type = PdEventType::ASSIGNED;
+        ev.sinks = sinks;
+        ev.msg_type = query6->getType();
+        ev.reply_type = response6->getType();
+        ev.data.client_duid = relay.clientDuid();
+        ev.data.prefix = leasePrefix(*l);
+        ev.data.iaid = l->iaid_;
+        ev.data.cpe_link_local = relay.cpeLinkLocal();
+        ev.data.router_ip = relay.routerIp();
+        ev.data.router_link_addr = relay.routerLinkAddr();
+        // Raw relay peer-address for the webhook (the NetBox field keeps link-local only)
+        ev.peer_addr = relay.peerAddr();
+        ev.subnet_id = l->subnet_id_;
+        ev.valid_lft = l->valid_lft_;
+        ev.preferred_lft = l->preferred_lft_;
+        ev.cltt = l->cltt_;
+
+        DEBUG_LOG("PD_WEBHOOK: Queueing event for prefix " << ev.data.prefix
+                  << " (IAID=" << ev.data.iaid << ", CPE=" << ev.data.cpe_link_local
+                  << ", Router=" << ev.data.router_ip << ", LinkAddr=" << ev.data.router_link_addr << ")");
+
+        events.push_back(std::move(ev));
+    }
+
+    if (g_cfg.enabled && !g_cfg.url.empty()) {
+        std::shared_ptr<PacketWebhook> packet;
+        for (const PdEvent& ev : events) {
+            if (ev.sinks & SINK_WEBHOOK) {
+                if (!packet) {
+                    packet = std::make_shared<PacketWebhook>();
+                    packet->now = time(nullptr);
+                }
+                packet->leases.push_back(ev);
+            }
+        }
+        for (PdEvent& ev : events) {
+            if (ev.sinks & SINK_WEBHOOK) {
+                ev.packet = packet;
+            }
+        }
+    }
+    for (PdEvent& ev : events) {
+        dispatchEvent(std::move(ev));
+    }
+}
+
+// Build a lease event from a lease without packet context (expire/recover)
+static PdEvent
+makeLeaseEvent(PdEventType type, const Lease6Ptr& lease, uint8_t sinks) {
+    PdEvent ev;
+    ev.type = type;
+    ev.sinks = sinks;
+    if (lease->duid_) {
+        const std::vector<uint8_t>& duid = lease->duid_->getDuid();
+        ev.data.client_duid.assign(duid.data(), duid.size());
+    }
+    ev.data.prefix = leasePrefix(*lease);
+    ev.data.iaid = lease->iaid_;
+    // For expired and recovered leases, relay info is not available
+    ev.subnet_id = lease->subnet_id_;
+    ev.valid_lft = lease->valid_lft_;
+    ev.preferred_lft = lease->preferred_lft_;
+    ev.cltt = lease->cltt_;
+    return ev;
+}
+
+// Queue a PD lease expiration event
+static void
+notifyPdExpired(const Lease6Ptr& lease)
+{
+    if (!lease || lease->type_ != Lease::TYPE_PD) {
+        return;
+    }
+
+    DEBUG_LOG("PD_WEBHOOK: Notifying PD lease expiration for " << lease->addr_.toText() << "/" << lease->prefixlen_);
+
+    g_stats.received_expire.add();
+    uint8_t sinks = eventSinks({PdEventType::EXPIRED, 0, lease->subnet_id_, lease->prefixlen_, nullptr});
+    if (sinks != 0) {
+        dispatchEvent(makeLeaseEvent(PdEventType::EXPIRED, lease, sinks));
+    }
+}
+
+// One rule of an event filter; false, with the reason in error, if it is malformed
+static bool
+parseFilterRule(const ConstElementPtr& rule_el, EventFilter::Rule& rule, std::string& error) {
+    if (rule_el->getType() != Element::map) {
+        error = "a rule is not a map";
+        return false;
+    }
+    for (const auto& member : rule_el->mapValue()) {
+        const std::string& key = member.first;
+        const ConstElementPtr& value = member.second;
+        // Every condition but prefix-length takes one value or a list of them
+        std::vector<ConstElementPtr> items;
+        if (value->getType() == Element::list) {
+            for (const auto& item : value->listValue()) {
+                items.push_back(item);
+            }
+        } else {
+            items.push_back(value);
+        }
+
+        if (key == "events") {
+            for (const auto& item : items) {
+                std::string name = item->getType() == Element::string ? item->stringValue() : "";
+                if (name == "assigned") {
+                    rule.events |= 1u << static_cast<unsigned>(PdEventType::ASSIGNED);
+                } else if (name == "expired") {
+                    rule.events |= 1u << static_cast<unsigned>(PdEventType::EXPIRED);
+                } else if (name == "recovered") {
+                    rule.events |= 1u << static_cast<unsigned>(PdEventType::RECOVERED);
+                } else {
+                    error = "unknown event '" + name + "'";
+                    return false;
+                }
+            }
+        } else if (key == "msg-types") {
+            for (const auto& item : items) {
+                int64_t type = -1;
+                if (item->getType() == Element::integer) {
+                    type = item->intValue();
+                } else if (item->getType() == Element::string) {
+                    const std::string& name = item->stringValue();
+                    type = name == "solicit" ? DHCPV6_SOLICIT : name == "request" ? DHCPV6_REQUEST :
+                           name == "renew" ? DHCPV6_RENEW : name == "rebind" ? DHCPV6_REBIND : -1;
+                }
+                if (type <= 0 || type >= 32) {
+                    error = "invalid msg-types entry";
+                    return false;
+                }
+                rule.msg_types |= 1u << type;
+            }
+        } else if (key == "subnet-ids") {
+            for (const auto& item : items) {
+                if (item->getType() != Element::integer || item->intValue() < 0 ||
+                    item->intValue() > std::numeric_limits<uint32_t>::max()) {
+                    error = "invalid subnet-ids entry";
+                    return false;
+                }
+                rule.subnet_ids.push_back(static_cast<uint32_t>(item->intValue()));
+            }
+        } else if (key == "prefix-length") {
+            // One length, or [min, max]
+            if (items.size() > 2) {
+                error = "prefix-length takes a length or [min, max]";
+                return false;
+            }
+            int64_t bounds[2];
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (items[i]->getType() != Element::integer || items[i]->intValue() < 0 ||
+                    items[i]->intValue() > 128) {
+                    error = "invalid prefix-length";
+                    return false;
+                }
+                bounds[i] = items[i]->intValue();
+            }
+            if (items.size() == 1) {
+                bounds[1] = bounds[0];
+            }
+            if (items.empty() || bounds[0] > bounds[1]) {
+                error = "invalid prefix-length";
+                return false;
+            }
+            rule.min_prefix_length = static_cast<uint8_t>(bounds[0]);
+            rule.max_prefix_length = static_cast<uint8_t>(bounds[1]);
+        } else if (key == "relay-link-prefix") {
+            for (const auto& item : items) {
+                PrefixKey prefix;
+                if (item->getType() != Element::string || !PrefixKey::fromCidr(item->stringValue(), prefix)) {
+                    error = "invalid relay-link-prefix entry";
+                    return false;
+                }
+                rule.link_prefixes.push_back(prefix);
+            }
+        } else {
+            error = "unknown condition '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// "webhook-event-filter" or "netbox-event-filter": {"include": [rules], "exclude": [rules]}.
+// A filter with a malformed rule is ignored as a whole, so the sink receives everything.
+static EventFilter
+parseEventFilter(const ConstElementPtr& filter_el, const std::string& name) {
+    if (filter_el->getType() != Element::map) {
+        WARN_LOG("PD_WEBHOOK: " + name + " is not a map, ignored");
+        return EventFilter();
+    }
+    std::vector<EventFilter::Rule> rules[2];
+    const char* sections[2] = {"include", "exclude"};
+    for (int i = 0; i < 2; ++i) {
+        ConstElementPtr rules_el = filter_el->get(sections[i]);
+        if (!rules_el) {
+            continue;
+        }
+        if (rules_el->getType() != Element::list) {
+            WARN_LOG("PD_WEBHOOK: " + name + " " + sections[i] + " is not a list, filter ignored");
+            return EventFilter();
+        }
+        for (const auto& rule_el : rules_el->listValue()) {
+            EventFilter::Rule rule;
+            std::string error;
+            if (!parseFilterRule(rule_el, rule, error)) {
+                WARN_LOG("PD_WEBHOOK: Invalid " + name + " " + sections[i] + " rule (" + error +
+                         "), filter ignored");
+                return EventFilter();
+            }
+            rules[i].push_back(rule);
+        }
+    }
+    return EventFilter(rules[0], rules[1]);
+}
+
+// "webhook-fields" or "netbox-fields": a list of member names; unknown names are skipped
+static uint32_t
+parseFields(const ConstElementPtr& fields_el, const std::string& name,
+            bool (*parse)(const std::string&, uint32_t&), uint32_t all) {
+    if (fields_el->getType() != Element::list) {
+        WARN_LOG("PD_WEBHOOK: " + name + " is not a list, ignored");
+        return all;
+    }
+    uint32_t fields = 0;
+    for (const auto& item : fields_el->listValue()) {
+        uint32_t field = 0;
+        if (item->getType() != Element::string || !parse(item->stringValue(), field)) {
+            WARN_LOG("PD_WEBHOOK: Unknown " + name + " entry " + item->str() + ", ignored");
+            continue;
+        }
+        fields |= field;
+    }
+    return fields;
+}
+
+// A non-negative number, integer or real; false for anything else
+static bool
+numberValue(const ConstElementPtr& el, double& value) {
+    if (el->getType() == Element::real) {
+        value = el->doubleValue();
+    } else if (el->getType() == Element::integer) {
+        value = static_cast<double>(el->intValue());
+    } else {
+        return false;
+    }
+    return value >= 0.0;
+}
+
+// "netbox-backends": a list of {"name", "url", "token", ...}. A list with a
+// malformed backend is ignored as a whole, leaving netbox-url in charge.
+static bool
+parseNetBoxBackends(const ConstElementPtr& backends_el, std::vector<WebhookConfig::NetBoxBackendConfig>& backends) {
+    if (backends_el->getType() != Element::list) {
+        WARN_LOG("PD_WEBHOOK: netbox-backends is not a list, ignored");
+        return false;
+    }
+    bool primary = false;
+    for (const auto& backend_el : backends_el->listValue()) {
+        WebhookConfig::NetBoxBackendConfig backend;
+        std::string error;
+        auto required = [&backend_el, &error](const char* key, std::string& value) {
+            ConstElementPtr el = backend_el->get(key);
+            if (!el || el->getType() != Element::string || el->stringValue().empty()) {
+                error = std::string("missing ") + key;
+                return false;
+            }
+            value = el->stringValue();
+            return true;
+        };
+        if (backend_el->getType() != Element::map) {
+            error = "not a map";
+        } else if (required("name", backend.name) && required("url", backend.url) &&
+                   required("token", backend.token)) {
+            for (const auto& member : backend_el->mapValue()) {
+                const std::string& key = member.first;
+                const ConstElementPtr& value = member.second;
+                double number = 0.0;
+                if (key == "name" || key == "url" || key == "token") {
+                    continue;
+                } else if (key == "mirror" && value->getType() == Element::boolean) {
+                    backend.mirror = value->boolValue();
+                } else if (key == "weight" && value->getType() == Element::integer && value->intValue() > 0 &&
+                           value->intValue() <= 1000) {
+                    backend.weight = static_cast<unsigned>(value->intValue());
+                } else if (key == "rate-limit" && numberValue(value, number)) {
+                    backend.rate_limit = number;
+                } else if (key == "rate-burst" && numberValue(value, number)) {
+                    backend.rate_burst = number;
+                } else if (key == "max-in-flight" && value->getType() == Element::integer && value->intValue() > 0) {
+                    backend.max_in_flight = static_cast<size_t>(value->intValue());
+                } else if (key == "queue-size" && value->getType() == Element::integer && value->intValue() > 0) {
+                    backend.queue_size = static_cast<size_t>(value->intValue());
+                } else {
+                    error = "invalid " + key;
+                    break;
+                }
+            }
+        }
+        for (const auto& other : backends) {
+            if (error.empty() && other.name == backend.name) {
+                error = "duplicate name";
+            }
+        }
+        if (error.empty() && backends.size() >= NetBoxRouter::kMaxBackends) {
+            error = "too many backends";
+        }
+        if (!error.empty()) {
+            WARN_LOG("PD_WEBHOOK: Invalid netbox-backends entry " + backend_el->str() + " (" + error +
+                     "), netbox-backends ignored");
+            backends.clear();
+            return false;
+        }
+        primary = primary || !backend.mirror;
+        backends.push_back(backend);
+    }
+    if (!primary) {
+        WARN_LOG("PD_WEBHOOK: netbox-backends has no backend that is not a mirror, ignored");
+        backends.clear();
+        return false;
+    }
+    return true;
+}
+
+// "netbox-routes": a list of {"backend": name, conditions...}, with the
+// conditions of an event filter rule that do not depend on the event type.
+// A list with a malformed route is ignored as a whole: every prefix is hashed.
+static void
+parseNetBoxRoutes(const ConstElementPtr& routes_el, const std::vector<WebhookConfig::NetBoxBackendConfig>& backends,
+                  std::vector<NetBoxRouter::Route>& routes) {
+    if (routes_el->getType() != Element::list) {
+        WARN_LOG("PD_WEBHOOK: netbox-routes is not a list, ignored");
+        return;
+    }
+    for (const auto& route_el : routes_el->listValue()) {
+        NetBoxRouter::Route route;
+        route.backend = backends.size();
+        std::string error;
+        ConstElementPtr backend_el = route_el->getType() == Element::map ? route_el->get("backend") : ConstElementPtr();
+        for (size_t b = 0; backend_el && backend_el->getType() == Element::string && b < backends.size(); ++b) {
+            if (backends[b].name == backend_el->stringValue() && !backends[b].mirror) {
+                route.backend = b;
+            }
+        }
+        if (route.backend == backends.size()) {
+            error = "no backend, an unknown one or a mirror";
+        } else {
+            ElementPtr conditions = Element::createMap();
+            for (const auto& member : route_el->mapValue()) {
+                if (member.first != "backend") {
+                    conditions->set(member.first, member.second);
+                }
+            }
+            if (parseFilterRule(conditions, route.rule, error) && (route.rule.events || route.rule.msg_types)) {
+                error = "events and msg-types cannot route";
+            }
+        }
+        if (!error.empty()) {
+            WARN_LOG("PD_WEBHOOK: Invalid netbox-routes entry " + route_el->str() + " (" + error +
+                     "), netbox-routes ignored");
+            routes.clear();
+            return;
+        }
+        routes.push_back(route);
+    }
+}
+
+// Hook callout: leases6_committed
+extern "C" {
+
+int
+leases6_committed(CalloutHandle& handle) {
+    ScopedLatency timer(g_stats.callout_committed);
+    try {
+        samplePacketLog();
+        // Always log that hook was called
+        DEBUG_LOG("PD_WEBHOOK: leases6_committed called");
+        
+        if (!g_cfg.enabled) {
+            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
+            return (0);
+        }
+
+        Pkt6Ptr query6;
+        Pkt6Ptr response6;
+        Lease6CollectionPtr leases6;
+        Lease6CollectionPtr deleted_leases6;
+
+        handle.getArgument("query6", query6);
+        handle.getArgument("response6", response6);
+        handle.getArgument("leases6", leases6);
+        handle.getArgument("deleted_leases6", deleted_leases6);
+
+        if (!query6 || !response6 || !leases6) {
+            return (0);
+        }
+
+        // Trigger on REQUEST, RENEW (for testing with short leases), and SOLICIT+Rapid Commit.
+        uint8_t msg_type = query6->getType();
+        bool is_request = (msg_type == DHCPV6_REQUEST);
+        bool is_renew = (msg_type == DHCPV6_RENEW);
+
+        bool is_rapid_commit =
+            (msg_type == DHCPV6_SOLICIT) &&
+            (query6->getOption(D6O_RAPID_COMMIT) != nullptr);
+
+        if (!is_request && !is_renew && !is_rapid_commit) {
+            DEBUG_LOG("PD_WEBHOOK: Skipping message type: " << static_cast<unsigned int>(msg_type) << " (REQUEST=3, SOLICIT=1, RENEW=5, RELAY_FORW=12, RELAY_REPL=13)");
+            return (0);
+        }
+
+        // Dump relay information for debugging
+        if (debugLogEnabled()) {
+            dumpRelayInfo(query6);
+        }
+        
+        RelayContext relay(query6);
+        notifyPdAssigned(query6, response6, leases6, relay);
+
+    } catch (...) {
+        // Do not throw into Kea; errors are silently ignored here.
+    }
+
+    return (0);
+}
+
+// Hook callout: lease6_expire
+int
+lease6_expire(CalloutHandle& handle) {
+    ScopedLatency timer(g_stats.callout_expire);
+    try {
+        samplePacketLog();
+        // Always log that hook was called
+        DEBUG_LOG("PD_WEBHOOK: lease6_expire called");
+
+        if (!g_cfg.enabled) {
+            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
+            return (0);
+        }
+
+        Lease6Ptr lease;
+        handle.getArgument("lease6", lease);
+
+        if (!lease) {
+            DEBUG_LOG("PD_WEBHOOK: No lease provided, returning");
+            return (0);
+        }
+
+        DEBUG_LOG("PD_WEBHOOK: Processing expired lease: " << lease->addr_.toText() << "/" << lease->prefixlen_
+                  << " type: " << static_cast<int>(lease->type_));
+
+        if (lease->type_ == Lease::TYPE_PD) {
+            notifyPdExpired(lease);
+        }
+
+    } catch (...) {
+        // Do not throw into Kea; errors are silently ignored here.
+    }
+
+    return (0);
+}
+
+// Queue a PD lease recovery event
+static void notifyPdRecovered(const Lease6Ptr& lease) {
+    if (!lease || lease->type_ != Lease::TYPE_PD) {
+        return;
+    }
+
+    // Re-activate in NetBox (update status to "active")
+    g_stats.received_recover.add();
+    uint8_t sinks = eventSinks({PdEventType::RECOVERED, 0, lease->subnet_id_, lease->prefixlen_, nullptr});
+    if (sinks != 0) {
+        dispatchEvent(makeLeaseEvent(PdEventType::RECOVERED, lease, sinks));
+    }
+}
+
+// Hook callout: lease6_recover
+int
+lease6_recover(CalloutHandle& handle) {
+    ScopedLatency timer(g_stats.callout_recover);
+    try {
+        samplePacketLog();
+        // Always log that hook was called
+        DEBUG_LOG("PD_WEBHOOK: lease6_recover called");
+
+        if (!g_cfg.enabled) {
+            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
+            return (0);
+        }
+
+        Lease6Ptr lease;
+        handle.getArgument("lease6", lease);
+
+        if (!lease) {
+            DEBUG_LOG("PD_WEBHOOK: No lease provided, returning");
+            return (0);
+        }
+
+        DEBUG_LOG("PD_WEBHOOK: Processing recovered lease: " << lease->addr_.toText() << "/" << lease->prefixlen_
+                  << " type: " << static_cast<int>(lease->type_));
+
+        if (lease->type_ == Lease::TYPE_PD) {
+            notifyPdRecovered(lease);
+        }
+
+    } catch (...) {
+        // Do not throw into Kea; errors are silently ignored here.
+    }
+
+    return (0);
+}
+
+// Current value of every statistic published to Kea's StatsMgr
+static std::vector<std::pair<const char*, int64_t>>
+statValues() {
+    DispatchQueue::Stats queue_stats{};
+    if (g_queue) {
+        queue_stats = g_queue->getStats();
+    }
+    uint64_t suppressed = g_renewal_filter ? g_renewal_filter->getStats().suppressed : 0;
+    RetryPolicy::Stats retry_stats{};
+    if (g_retry_policy) {
+        retry_stats = g_retry_policy->getStats();
+    }
+    CircuitBreaker::Stats netbox_breaker{};
+    CircuitBreaker::Stats webhook_breaker{};
+    if (g_netbox_breaker) {
+        netbox_breaker = g_netbox_breaker->getStats();
+        webhook_breaker = g_webhook_breaker->getStats();
+    }
+    Reconciler::Stats reconcile_stats{};
+    if (g_reconciler) {
+        reconcile_stats = g_reconciler->getStats();
+    }
+    PrefixTable::Stats table_stats{};
+    if (g_prefix_table) {
+        table_stats = g_prefix_table->getStats();
+    }
+
+    std::vector<std::pair<const char*, int64_t>> values;
+    auto add = [&values](const char* name, uint64_t value) {
+        values.emplace_back(name, static_cast<int64_t>(value));
+    };
+    add("pd-webhook.events-received-leases6-committed", g_stats.received_committed.value());
+    add("pd-webhook.events-received-lease6-expire", g_stats.received_expire.value());
+    add("pd-webhook.events-received-lease6-recover", g_stats.received_recover.value());
+    add("pd-webhook.events-sent", g_stats.sent.value());
+    add("pd-webhook.events-failed", g_stats.failed.value());
+    add("pd-webhook.events-suppressed", suppressed);
+    add("pd-webhook.events-coalesced", queue_stats.coalesced + g_sweep_coalesced.load(std::memory_order_relaxed));
+    add("pd-webhook.events-dropped", queue_stats.dropped_oldest + queue_stats.dropped_newest + queue_stats.shed);
+    add("pd-webhook.events-filtered", g_stats.filtered.value());
+    add("pd-webhook.events-filtered-netbox", g_stats.filtered_netbox.value());
+    add("pd-webhook.events-filtered-webhook", g_stats.filtered_webhook.value());
+    uint64_t shed_netbox = g_netbox_rate ? g_netbox_rate->getStats().shed : 0;
+    for (const auto& backend : g_backends) {
+        shed_netbox += backend->rate ? backend->rate->getStats().shed : 0;
+    }
+    add("pd-webhook.events-shed-netbox", shed_netbox);
+    add("pd-webhook.events-shed-webhook", g_webhook_rate ? g_webhook_rate->getStats().shed : 0);
+    add("pd-webhook.requests-retried", retry_stats.retries);
+    add("pd-webhook.requests-recovered", retry_stats.recovered);
+    add("pd-webhook.requests-exhausted", retry_stats.exhausted);
+    // Breaker states as numbers: 0 closed, 1 open, 2 half-open
+    add("pd-webhook.netbox-breaker-state", static_cast<uint64_t>(netbox_breaker.state));
+    add("pd-webhook.netbox-breaker-opened", netbox_breaker.opened);
+    add("pd-webhook.netbox-breaker-rejected", netbox_breaker.rejected);
+    add("pd-webhook.webhook-breaker-state", static_cast<uint64_t>(webhook_breaker.state));
+    add("pd-webhook.webhook-breaker-opened", webhook_breaker.opened);
+    add("pd-webhook.webhook-breaker-rejected", webhook_breaker.rejected);
+    add("pd-webhook.queue-depth", queue_stats.depth);
+    add("pd-webhook.errors", g_errors.getStats().total);
+    add("pd-webhook.reconcile-runs", reconcile_stats.runs);
+    add("pd-webhook.reconcile-writes", reconcile_stats.created + reconcile_stats.updated + reconcile_stats.deprecated);
+    add("pd-webhook.state-table-entries", table_stats.entries);
+    add("pd-webhook.state-table-bytes", table_stats.memory_bytes);
+    add("pd-webhook.expire-batches", g_expire_sweep ? g_expire_sweep->batches() : 0);
+    add("pd-webhook.webhook-batches", g_webhook_batcher ? g_webhook_batcher->batches() : 0);
+    return values;
+}
+
+// Publisher of statValues() to StatsMgr, every "stats-interval-ms"
+static std::thread g_stats_thread;
+static std::mutex g_stats_mutex;
+static std::condition_variable g_stats_cv;
+static bool g_stats_stop{false};
+
+static void
+publishStats() {
+    isc::stats::StatsMgr& mgr = isc::stats::StatsMgr::instance();
+    for (const auto& value : statValues()) {
+        mgr.setValue(value.first, value.second);
+    }
+}
+
+static void
+runStatsPublisher() {
+    std::unique_lock<std::mutex> lock(g_stats_mutex);
+    while (!g_stats_stop) {
+        g_stats_cv.wait_for(lock, std::chrono::milliseconds(g_cfg.stats_interval_ms));
+        if (g_stats_stop) {
+            break;
+        }
+        lock.unlock();
+        publishStats();
+        lock.lock();
+    }
+}
+
+// Percentiles of one histogram for pd-webhook-stats-get
+static ElementPtr
+latencyElement(const LatencyHistogram& histogram) {
+    LatencyHistogram::Snapshot snap = histogram.snapshot();
+    ElementPtr result = Element::createMap();
+    result->set("count", Element::create(static_cast<int64_t>(snap.count)));
+    result->set("mean-us", Element::create(static_cast<int64_t>(snap.mean())));
+    result->set("p50-us", Element::create(static_cast<int64_t>(snap.percentile(50.0))));
+    result->set("p90-us", Element::create(static_cast<int64_t>(snap.percentile(90.0))));
+    result->set("p99-us", Element::create(static_cast<int64_t>(snap.percentile(99.0))));
+    result->set("p999-us", Element::create(static_cast<int64_t>(snap.percentile(99.9))));
+    result->set("max-us", Element::create(static_cast<int64_t>(snap.max_us)));
+    return result;
+}
+
+// Command callout: pd-webhook-stats-get. Reports the counters published to
+// StatsMgr, current rather than as of the last publish, and latency percentiles.
+int
+pd_webhook_stats_get(CalloutHandle& handle) {
+    ElementPtr counters = Element::createMap();
+    for (const auto& value : statValues()) {
+        counters->set(value.first, Element::create(value.second));
+    }
+
+    ElementPtr latency = Element::createMap();
+    latency->set("callout-leases6-committed", latencyElement(g_stats.callout_committed));
+    latency->set("callout-lease6-expire", latencyElement(g_stats.callout_expire));
+    latency->set("callout-lease6-recover", latencyElement(g_stats.callout_recover));
+    for (size_t i = 0; i < kNetBoxOps; ++i) {
+        latency->set(std::string("netbox-") + kNetBoxOpNames[i], latencyElement(g_stats.netbox[i]));
+    }
+
+    ElementPtr args = Element::createMap();
+    args->set("counters", counters);
+    args->set("latency", latency);
+
+    if (!g_backends.empty()) {
+        ElementPtr backends = Element::createMap();
+        for (const auto& backend : g_backends) {
+            WorkLane::Stats lane_stats = backend->lane->getStats();
+            ElementPtr item = Element::createMap();
+            item->set("mirror", Element::create(backend->mirror));
+            item->set("sent", Element::create(static_cast<int64_t>(backend->sent.value())));
+            item->set("failed", Element::create(static_cast<int64_t>(backend->failed.value())));
+            item->set("queued", Element::create(static_cast<int64_t>(lane_stats.depth)));
+            item->set("rejected", Element::create(static_cast<int64_t>(lane_stats.rejected)));
+            item->set("breaker", Element::create(CircuitBreaker::stateName(backend->breaker->getStats().state)));
+            backends->set(backend->name, item);
+        }
+        args->set("netbox-backends", backends);
+    }
+
+    handle.setArgument("response", isc::config::createAnswer(isc::config::CONTROL_RESULT_SUCCESS, args));
+    return (0);
+}
+
+// Command callout: pd-webhook-errors-get. Reports the error counters and the
+// most recent errors, newest first.
+int
+pd_webhook_errors_get(CalloutHandle& handle) {
+    ErrorTracker::Stats stats = g_errors.getStats();
+
+    ElementPtr counts = Element::createMap();
+    for (size_t i = 1; i < ErrorTracker::kCodes; ++i) {
+        counts->set(ErrorTracker::codeName(static_cast<ErrorCode>(i)),
+                    Element::create(static_cast<int64_t>(stats.counts[i])));
+    }
+
+    ElementPtr recent = Element::createList();
+    for (const ErrorTracker::Entry& entry : g_errors.recent()) {
+        time_t seconds = static_cast<time_t>(entry.time_ms / 1000);
+        struct tm tm_utc;
+        gmtime_r(&seconds, &tm_utc);
+        char stamp[40];
+        size_t len = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+        snprintf(stamp + len, sizeof(stamp) - len, ".%03dZ", static_cast<int>(entry.time_ms % 1000));
+
+        ElementPtr item = Element::createMap();
+        item->set("timestamp", Element::create(std::string(stamp)));
+        item->set("code", Element::create(ErrorTracker::codeName(entry.code)));
+        item->set("endpoint", Element::create(entry.endpoint ? entry.endpoint : ""));
+        recent->add(item);
+    }
+
+    ElementPtr args = Element::createMap();
+    args->set("total", Element::create(static_cast<int64_t>(stats.total)));
+    args->set("dropped", Element::create(static_cast<int64_t>(stats.dropped)));
+    args->set("counts", counts);
+    args->set("recent", recent);
+
+    handle.setArgument("response", isc::config::createAnswer(isc::config::CONTROL_RESULT_SUCCESS, args));
+    return (0);
+}
+
+// Reconciler settings shared by g_reconciler and the backends' reconcilers
+static Reconciler::Config
+reconcileConfig() {
+    Reconciler::Config reconcile;
+    reconcile.interval = std::chrono::seconds(g_cfg.reconcile_interval_sec);
+    reconcile.lease_page_size = g_cfg.reconcile_lease_page_size;
+    reconcile.netbox_page_size = g_cfg.reconcile_netbox_page_size;
+    reconcile.netbox_filter = g_cfg.reconcile_filter;
+    reconcile.max_writes_per_sec = g_cfg.reconcile_max_writes_per_sec;
+    reconcile.leasetime_tolerance = g_cfg.reconcile_leasetime_tolerance >= 0.0 ?
+                                    g_cfg.reconcile_leasetime_tolerance : g_cfg.renew_suppress_fraction;
+    reconcile.in_flight = [](const PrefixKey& prefix) {
+        bool in_flight = false;
+        g_prefix_table->modify(prefix, [&in_flight](PrefixTable::Entry& entry) {
+            in_flight = (entry.flags & (PrefixTable::PENDING | PrefixTable::BUSY | PrefixTable::SWEPT)) != 0;
+        });
+        return in_flight;
+    };
+    return reconcile;
+}
+
+// A reconciled prefix must be pushed in full on its next assignment
+static void
+forgetPush(const PdAssignmentData& data) {
+    if (g_renewal_filter) {
+        g_renewal_filter->forget(data.prefix);
+    }
+}
+
+// Build g_backends and g_router from "netbox-backends"; called in load()
+// after the pool, the transport and the retry policy exist
+static void
+createNetBoxBackends() {
+    size_t threads = g_cfg.netbox_backend_threads > 0 ? g_cfg.netbox_backend_threads :
+                     std::max<size_t>(1, g_cfg.sender_threads);
+    std::vector<NetBoxRouter::Backend> ring;
+    for (const auto& cfg : g_cfg.netbox_backends) {
+        std::unique_ptr<NetBoxBackend> backend(new NetBoxBackend());
+        NetBoxBackend* b = backend.get();
+        b->name = cfg.name;
+        b->endpoint = backendEndpoint(cfg.name);
+        b->mirror = cfg.mirror;
+        if (g_cfg.prefix_cache_size > 0) {
+            b->ids.reset(new PrefixTable(g_cfg.prefix_cache_size));
+        }
+        b->breaker.reset(new CircuitBreaker(g_cfg.breaker_failure_threshold,
+                                            std::chrono::milliseconds(g_cfg.breaker_cooldown_ms)));
+        double rate = cfg.rate_limit >= 0.0 ? cfg.rate_limit : g_cfg.netbox_rate_limit;
+        double burst = cfg.rate_burst > 0.0 ? cfg.rate_burst :
+                       cfg.rate_limit < 0.0 && g_cfg.netbox_rate_burst > 0.0 ? g_cfg.netbox_rate_burst : rate;
+        if (rate > 0.0) {
+            b->rate.reset(new TokenBucket(rate, burst));
+        }
+        size_t in_flight = cfg.max_in_flight > 0 ? cfg.max_in_flight : g_cfg.max_in_flight;
+        b->limiter.reset(new InflightLimiter(in_flight * g_cfg.bulk_max_items));
+
+        HttpNetBoxClient::Config netbox;
+        netbox.url = cfg.url;
+        netbox.headers = g_pool->addNetBoxHeaders(cfg.token);
+        netbox.timeout_ms = g_cfg.timeout_ms;
+        netbox.json_encoder = g_cfg.json_encoder;
+        netbox.fields = g_cfg.netbox_fields;
+        netbox.endpoint = b->endpoint;
+        netbox.prefix_table = b->ids.get();
+        netbox.prefix_cache_ttl = g_cfg.prefix_cache_ttl;
+        netbox.warmup_filter = g_cfg.cache_warmup_filter;
+        netbox.warmup_page_size = g_cfg.cache_warmup_page_size;
+        netbox.bulk_max_items = g_cfg.bulk_max_items;
+        netbox.bulk_max_delay_ms = g_cfg.bulk_max_delay_ms;
+        netbox.lookup_max_items = g_cfg.lookup_max_items;
+        netbox.lookup_max_delay_ms = g_cfg.lookup_max_delay_ms;
+        b->client.reset(new HttpNetBoxClient(netbox, [b](HttpRequest&& request, HttpCompletion done) {
+            sendBackendHttp(*b, std::move(request), std::move(done));
+        }, &g_errors, g_stats.netbox));
+        b->lane.reset(new WorkLane(cfg.queue_size > 0 ? cfg.queue_size : g_cfg.queue_size, threads));
+
+        NetBoxRouter::Backend placement;
+        placement.name = cfg.name;
+        placement.weight = cfg.weight;
+        placement.mirror = cfg.mirror;
+        ring.push_back(placement);
+        g_backends.push_back(std::move(backend));
+    }
+    g_router.reset(new NetBoxRouter(ring, g_cfg.netbox_routes));
+}
+
+// Library load hook: read configuration parameters.
+int
+load(LibraryHandle& handle) {
+    // Default.
+    g_cfg = WebhookConfig();
+
+    // Library parameters from kea config: hooks-libraries[].parameters
+    ConstElementPtr params = handle.getParameters();
+    if (params && params->getType() == Element::map) {
+        // Webhook configuration
+        ConstElementPtr url_el = params->get("webhook-url");
+        if (url_el && url_el->getType() == Element::string) {
+            g_cfg.url = url_el->stringValue();
+        }
+
+        ConstElementPtr timeout_el = params->get("timeout-ms");
+        if (timeout_el && timeout_el->getType() == Element::integer) {
+            long t = static_cast<long>(timeout_el->intValue());
+            if (t > 0) {
+                g_cfg.timeout_ms = t;
+            }
+        }
+        
+        ConstElementPtr debug_el = params->get("debug");
+        if (debug_el && debug_el->getType() == Element::boolean) {
+            g_cfg.debug = debug_el->boolValue();
+        }
+
+        ConstElementPtr log_level_el = params->get("log-level");
+        if (log_level_el && log_level_el->getType() == Element::string) {
+            const std::string& level = log_level_el->stringValue();
+            if (level == "error") {
+                g_cfg.log_level = LogLevel::ERROR;
+            } else if (level == "warning") {
+                g_cfg.log_level = LogLevel::WARNING;
+            } else if (level == "info") {
+                g_cfg.log_level = LogLevel::INFO;
+            } else if (level == "debug") {
+                g_cfg.log_level = LogLevel::DEBUG;
+            } else {
+                WARN_LOG("PD_WEBHOOK: Unknown log-level '" + level + "', using warning");
+            }
+        }
+        if (g_cfg.debug) {
+            g_cfg.log_level = LogLevel::DEBUG;
+        }
+
+        ConstElementPtr log_sample_el = params->get("log-sample-rate");
+        if (log_sample_el && log_sample_el->getType() == Element::integer && log_sample_el->intValue() > 0) {
+            g_cfg.log_sample_rate = static_cast<unsigned>(log_sample_el->intValue());
+        }
+
+        // Applied right away so the rest of load() logs at the configured level.
+        setLogLevel(g_cfg.log_level, g_cfg.log_sample_rate);
+
+        // NetBox configuration
+        ConstElementPtr netbox_url_el = params->get("netbox-url");
+        if (netbox_url_el && netbox_url_el->getType() == Element::string) {
+            g_cfg.netbox_url = netbox_url_el->stringValue();
+        }
+
+        ConstElementPtr netbox_token_el = params->get("netbox-token");
+        if (netbox_token_el && netbox_token_el->getType() == Element::string) {
+            g_cfg.netbox_token = netbox_token_el->stringValue();
+        }
+
+        ConstElementPtr netbox_client_el = params->get("netbox-client");
+        if (netbox_client_el && netbox_client_el->getType() == Element::string) {
+            std::string client = netbox_client_el->stringValue();
+            if (client == "null") {
+                g_cfg.null_netbox = true;
+            } else if (client != "http") {
+                WARN_LOG("PD_WEBHOOK: Unknown netbox-client '" + client + "', using http");
+            }
+        }
+
+        ConstElementPtr netbox_backends_el = params->get("netbox-backends");
+        if (netbox_backends_el && parseNetBoxBackends(netbox_backends_el, g_cfg.netbox_backends)) {
+            ConstElementPtr netbox_routes_el = params->get("netbox-routes");
+            if (netbox_routes_el) {
+                parseNetBoxRoutes(netbox_routes_el, g_cfg.netbox_backends, g_cfg.netbox_routes);
+            }
+        }
+
+        ConstElementPtr backend_threads_el = params->get("netbox-backend-threads");
+        if (backend_threads_el && backend_threads_el->getType() == Element::integer) {
+            int64_t n = backend_threads_el->intValue();
+            if (n > 0) {
+                g_cfg.netbox_backend_threads = static_cast<size_t>(n);
+            }
+        }
+
+        // Dispatch queue configuration
+        ConstElementPtr queue_size_el = params->get("queue-size");
+        if (queue_size_el && queue_size_el->getType() == Element::integer) {
+            int64_t n = queue_size_el->intValue();
+            if (n > 0) {
+                g_cfg.queue_size = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr threads_el = params->get("sender-threads");
+        if (threads_el && threads_el->getType() == Element::integer) {
+            int64_t n = threads_el->intValue();
+            if (n >= 0) {
+                g_cfg.sender_threads = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr overflow_el = params->get("queue-overflow");
+        if (overflow_el && overflow_el->getType() == Element::string) {
+            std::string policy = overflow_el->stringValue();
+            if (policy == "drop-newest") {
+                g_cfg.queue_overflow = DispatchQueue::OverflowPolicy::DROP_NEWEST;
+            } else if (policy == "drop-oldest") {
+                g_cfg.queue_overflow = DispatchQueue::OverflowPolicy::DROP_OLDEST;
+            } else {
+                WARN_LOG("PD_WEBHOOK: Unknown queue-overflow policy '" + policy + "', using drop-oldest");
+            }
+        }
+
+        ConstElementPtr ring_el = params->get("intake-ring-size");
+        if (ring_el && ring_el->getType() == Element::integer) {
+            int64_t n = ring_el->intValue();
+            if (n >= 0) {
+                g_cfg.intake_ring_size = static_cast<size_t>(n);
+            }
+        }
+
+        // HTTP engine configuration
+        ConstElementPtr engine_el = params->get("http-engine");
+        if (engine_el && engine_el->getType() == Element::string) {
+            std::string engine = engine_el->stringValue();
+            if (engine == "multi") {
+                g_cfg.multi_engine = true;
+            } else if (engine != "easy") {
+                WARN_LOG("PD_WEBHOOK: Unknown http-engine '" + engine + "', using easy");
+            }
+        }
+
+        ConstElementPtr engine_threads_el = params->get("engine-threads");
+        if (engine_threads_el && engine_threads_el->getType() == Element::integer) {
+            int64_t n = engine_threads_el->intValue();
+            if (n > 0) {
+                g_cfg.engine_threads = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr in_flight_el = params->get("max-in-flight");
+        if (in_flight_el && in_flight_el->getType() == Element::integer) {
+            int64_t n = in_flight_el->intValue();
+            if (n > 0) {
+                g_cfg.max_in_flight = static_cast<size_t>(n);
+            }
+        }
+
+        // Outbound rate limits
+        ConstElementPtr netbox_rate_limit_el = params->get("netbox-rate-limit");
+        if (netbox_rate_limit_el && (netbox_rate_limit_el->getType() == Element::real || netbox_rate_limit_el->getType() == Element::integer)) {
+            double r = netbox_rate_limit_el->getType() == Element::real ?
+                netbox_rate_limit_el->doubleValue() : static_cast<double>(netbox_rate_limit_el->intValue());
+            if (r >= 0.0) {
+                g_cfg.netbox_rate_limit = r;
+            } else {
+                WARN_LOG("PD_WEBHOOK: netbox-rate-limit must not be negative, ignoring");
+            }
+        }
+
+        ConstElementPtr netbox_rate_burst_el = params->get("netbox-rate-burst");
+        if (netbox_rate_burst_el && (netbox_rate_burst_el->getType() == Element::real || netbox_rate_burst_el->getType() == Element::integer)) {
+            double r = netbox_rate_burst_el->getType() == Element::real ?
+                netbox_rate_burst_el->doubleValue() : static_cast<double>(netbox_rate_burst_el->intValue());
+            if (r >= 0.0) {
+                g_cfg.netbox_rate_burst = r;
+            } else {
+                WARN_LOG("PD_WEBHOOK: netbox-rate-burst must not be negative, ignoring");
+            }
+        }
+
+        ConstElementPtr webhook_rate_limit_el = params->get("webhook-rate-limit");
+        if (webhook_rate_limit_el && (webhook_rate_limit_el->getType() == Element::real || webhook_rate_limit_el->getType() == Element::integer)) {
+            double r = webhook_rate_limit_el->getType() == Element::real ?
+                webhook_rate_limit_el->doubleValue() : static_cast<double>(webhook_rate_limit_el->intValue());
+            if (r >= 0.0) {
+                g_cfg.webhook_rate_limit = r;
+            } else {
+                WARN_LOG("PD_WEBHOOK: webhook-rate-limit must not be negative, ignoring");
+            }
+        }
+
+        ConstElementPtr webhook_rate_burst_el = params->get("webhook-rate-burst");
+        if (webhook_rate_burst_el && (webhook_rate_burst_el->getType() == Element::real || webhook_rate_burst_el->getType() == Element::integer)) {
+            double r = webhook_rate_burst_el->getType() == Element::real ?
+                webhook_rate_burst_el->doubleValue() : static_cast<double>(webhook_rate_burst_el->intValue());
+            if (r >= 0.0) {
+                g_cfg.webhook_rate_burst = r;
+            } else {
+                WARN_LOG("PD_WEBHOOK: webhook-rate-burst must not be negative, ignoring");
+            }
+        }
+
+        ConstElementPtr max_wait_el = params->get("low-priority-max-wait-ms");
+        if (max_wait_el && max_wait_el->getType() == Element::integer) {
+            int64_t t = max_wait_el->intValue();
+            if (t >= 0) {
+                g_cfg.low_priority_max_wait_ms = static_cast<long>(t);
+            }
+        }
+
+        ConstElementPtr http2_el = params->get("http2");
+        if (http2_el && http2_el->getType() == Element::boolean) {
+            g_cfg.http2 = http2_el->boolValue();
+        }
+
+        // Prefix ID cache configuration
+        ConstElementPtr cache_size_el = params->get("prefix-cache-size");
+        if (cache_size_el && cache_size_el->getType() == Element::integer) {
+            int64_t n = cache_size_el->intValue();
+            if (n >= 0) {
+                g_cfg.prefix_cache_size = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr suppress_el = params->get("renew-suppress-fraction");
+        if (suppress_el && (suppress_el->getType() == Element::real ||
+                            suppress_el->getType() == Element::integer)) {
+            double f = suppress_el->getType() == Element::real ?
+                suppress_el->doubleValue() : static_cast<double>(suppress_el->intValue());
+            if (f >= 0.0 && f < 1.0) {
+                g_cfg.renew_suppress_fraction = f;
+            } else {
+                WARN_LOG("PD_WEBHOOK: renew-suppress-fraction must be in [0, 1), ignoring");
+            }
+        }
+
+        ConstElementPtr cache_ttl_el = params->get("prefix-cache-ttl");
+        if (cache_ttl_el && cache_ttl_el->getType() == Element::integer) {
+            int64_t t = cache_ttl_el->intValue();
+            if (t > 0) {
+                g_cfg.prefix_cache_ttl = static_cast<long>(t);
+            }
+        }
+
+        ConstElementPtr warmup_el = params->get("cache-warmup");
+        if (warmup_el && warmup_el->getType() == Element::string) {
+            std::string mode = warmup_el->stringValue();
+            if (mode == "block") {
+                g_cfg.cache_warmup = WebhookConfig::Warmup::BLOCK;
+            } else if (mode == "background") {
+                g_cfg.cache_warmup = WebhookConfig::Warmup::BACKGROUND;
+            } else if (mode != "off") {
+                WARN_LOG("PD_WEBHOOK: Unknown cache-warmup mode '" + mode + "', using off");
+            }
+        }
+
+        ConstElementPtr warmup_filter_el = params->get("cache-warmup-filter");
+        if (warmup_filter_el && warmup_filter_el->getType() == Element::string) {
+            g_cfg.cache_warmup_filter = warmup_filter_el->stringValue();
+        }
+
+        ConstElementPtr warmup_page_el = params->get("cache-warmup-page-size");
+        if (warmup_page_el && warmup_page_el->getType() == Element::integer) {
+            int64_t n = warmup_page_el->intValue();
+            if (n > 0) {
+                g_cfg.cache_warmup_page_size = static_cast<size_t>(n);
+            }
+        }
+
+        // Reconciliation configuration
+        ConstElementPtr reconcile_interval_el = params->get("reconcile-interval-sec");
+        if (reconcile_interval_el && reconcile_interval_el->getType() == Element::integer) {
+            int64_t t = reconcile_interval_el->intValue();
+            if (t >= 0) {
+                g_cfg.reconcile_interval_sec = static_cast<long>(t);
+            }
+        }
+
+        ConstElementPtr reconcile_lease_page_el = params->get("reconcile-lease-page-size");
+        if (reconcile_lease_page_el && reconcile_lease_page_el->getType() == Element::integer) {
+            int64_t n = reconcile_lease_page_el->intValue();
+            if (n > 0) {
+                g_cfg.reconcile_lease_page_size = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr reconcile_netbox_page_el = params->get("reconcile-netbox-page-size");
+        if (reconcile_netbox_page_el && reconcile_netbox_page_el->getType() == Element::integer) {
+            int64_t n = reconcile_netbox_page_el->intValue();
+            if (n > 0) {
+                g_cfg.reconcile_netbox_page_size = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr reconcile_rate_el = params->get("reconcile-max-writes-per-sec");
+        if (reconcile_rate_el && reconcile_rate_el->getType() == Element::integer) {
+            int64_t n = reconcile_rate_el->intValue();
+            if (n >= 0) {
+                g_cfg.reconcile_max_writes_per_sec = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr reconcile_tolerance_el = params->get("reconcile-leasetime-tolerance");
+        if (reconcile_tolerance_el && (reconcile_tolerance_el->getType() == Element::real ||
+                                       reconcile_tolerance_el->getType() == Element::integer)) {
+            double f = reconcile_tolerance_el->getType() == Element::real ?
+                reconcile_tolerance_el->doubleValue() : static_cast<double>(reconcile_tolerance_el->intValue());
+            if (f >= 0.0 && f < 1.0) {
+                g_cfg.reconcile_leasetime_tolerance = f;
+            } else {
+                WARN_LOG("PD_WEBHOOK: reconcile-leasetime-tolerance must be in [0, 1), ignoring");
+            }
         }
 
-        // Trigger on REQUEST, RENEW (for testing with short leases), and SOLICIT+Rapid Commit.
-        uint8_t msg_type = query6->getType();
-        bool is_request = (msg_type == DHCPV6_REQUEST);
-        bool is_renew = (msg_type == DHCPV6_RENEW);
-
-        bool is_rapid_commit =
-            (msg_type == DHCPV6_SOLICIT) &&
-            (query6->getOption(D6O_RAPID_COMMIT) != nullptr);
+        ConstElementPtr reconcile_filter_el = params->get("reconcile-filter");
+        if (reconcile_filter_el && reconcile_filter_el->getType() == Element::string) {
+            g_cfg.reconcile_filter = reconcile_filter_el->stringValue();
+        }
 
-        if (!is_request && !is_renew && !is_rapid_commit) {
-            DEBUG_LOG("PD_WEBHOOK: Skipping message type: " << static_cast<unsigned int>(msg_type) << " (REQUEST=3, SOLICIT=1, RENEW=5, RELAY_FORW=12, RELAY_REPL=13)");
-            return (0);
+        // Bulk write configuration
+        ConstElementPtr bulk_items_el = params->get("bulk-max-items");
+        if (bulk_items_el && bulk_items_el->getType() == Element::integer) {
+            int64_t n = bulk_items_el->intValue();
+            if (n > 0) {
+                g_cfg.bulk_max_items = static_cast<size_t>(n);
+            }
         }
 
-        // Dump relay information for debugging
-        dumpRelayInfo(query6);
-        
-        notifyPdAssigned(query6, response6, leases6);
+        ConstElementPtr bulk_delay_el = params->get("bulk-max-delay-ms");
+        if (bulk_delay_el && bulk_delay_el->getType() == Element::integer) {
+            int64_t t = bulk_delay_el->intValue();
+            if (t >= 0) {
+                g_cfg.bulk_max_delay_ms = static_cast<long>(t);
+            }
+        }
 
-    } catch (...) {
-        // Do not throw into Kea; errors are silently ignored here.
-    }
+        // Retry and circuit breaker configuration
+        ConstElementPtr attempts_el = params->get("retry-max-attempts");
+        if (attempts_el && attempts_el->getType() == Element::integer) {
+            int64_t n = attempts_el->intValue();
+            if (n > 0) {
+                g_cfg.retry_max_attempts = static_cast<unsigned>(n);
+            }
+        }
 
-    return (0);
-}
+        ConstElementPtr backoff_el = params->get("retry-backoff-ms");
+        if (backoff_el && backoff_el->getType() == Element::integer) {
+            int64_t t = backoff_el->intValue();
+            if (t >= 0) {
+                g_cfg.retry_backoff_ms = static_cast<long>(t);
+            }
+        }
 
-// Hook callout: lease6_expire
-int
-lease6_expire(CalloutHandle& handle) {
-    try {
-        // Always log that hook was called
-        DEBUG_LOG("PD_WEBHOOK: lease6_expire called");
+        ConstElementPtr backoff_max_el = params->get("retry-backoff-max-ms");
+        if (backoff_max_el && backoff_max_el->getType() == Element::integer) {
+            int64_t t = backoff_max_el->intValue();
+            if (t >= 0) {
+                g_cfg.retry_backoff_max_ms = static_cast<long>(t);
+            }
+        }
 
-        if (!g_cfg.enabled) {
-            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
-            return (0);
+        ConstElementPtr jitter_el = params->get("retry-jitter");
+        if (jitter_el && (jitter_el->getType() == Element::real ||
+                          jitter_el->getType() == Element::integer)) {
+            double f = jitter_el->getType() == Element::real ?
+                jitter_el->doubleValue() : static_cast<double>(jitter_el->intValue());
+            if (f >= 0.0 && f <= 1.0) {
+                g_cfg.retry_jitter = f;
+            } else {
+                WARN_LOG("PD_WEBHOOK: retry-jitter must be in [0, 1], ignoring");
+            }
         }
 
-        Lease6Ptr lease;
-        handle.getArgument("lease6", lease);
+        ConstElementPtr threshold_el = params->get("breaker-failure-threshold");
+        if (threshold_el && threshold_el->getType() == Element::integer) {
+            int64_t n = threshold_el->intValue();
+            if (n >= 0) {
+                g_cfg.breaker_failure_threshold = static_cast<unsigned>(n);
+            }
+        }
 
-        if (!lease) {
-            DEBUG_LOG("PD_WEBHOOK: No lease provided, returning");
-            return (0);
+        ConstElementPtr cooldown_el = params->get("breaker-cooldown-ms");
+        if (cooldown_el && cooldown_el->getType() == Element::integer) {
+            int64_t t = cooldown_el->intValue();
+            if (t > 0) {
+                g_cfg.breaker_cooldown_ms = static_cast<long>(t);
+            }
         }
 
-        DEBUG_LOG("PD_WEBHOOK: Processing expired lease: " << lease->addr_.toText() << "/" << lease->prefixlen_
-                  << " type: " << static_cast<int>(lease->type_));
+        ConstElementPtr encoder_el = params->get("json-encoder");
+        if (encoder_el && encoder_el->getType() == Element::string) {
+            std::string encoder = encoder_el->stringValue();
+            if (encoder == "jsoncpp") {
+                g_cfg.json_encoder = JsonEncoder::JSONCPP;
+            } else if (encoder != "fast") {
+                WARN_LOG("PD_WEBHOOK: Unknown json-encoder '" + encoder + "', using fast");
+            }
+        }
 
-        if (lease->type_ == Lease::TYPE_PD) {
-            notifyPdExpired(lease);
+        // Webhook format and compression
+        ConstElementPtr format_el = params->get("webhook-format");
+        if (format_el && format_el->getType() == Element::string) {
+            std::string format = format_el->stringValue();
+            if (format == "ndjson") {
+                g_cfg.webhook_ndjson = true;
+            } else if (format != "json") {
+                WARN_LOG("PD_WEBHOOK: Unknown webhook-format '" + format + "', using json");
+            }
         }
 
-    } catch (...) {
-        // Do not throw into Kea; errors are silently ignored here.
-    }
+        ConstElementPtr batch_items_el = params->get("webhook-batch-max-items");
+        if (batch_items_el && batch_items_el->getType() == Element::integer) {
+            int64_t n = batch_items_el->intValue();
+            if (n > 0) {
+                g_cfg.webhook_batch_max_items = static_cast<size_t>(n);
+            }
+        }
 
-    return (0);
-}
+        ConstElementPtr batch_delay_el = params->get("webhook-batch-max-delay-ms");
+        if (batch_delay_el && batch_delay_el->getType() == Element::integer) {
+            int64_t t = batch_delay_el->intValue();
+            if (t >= 0) {
+                g_cfg.webhook_batch_max_delay_ms = static_cast<long>(t);
+            }
+        }
 
-// Notify PD lease recovery
-static void notifyPdRecovered(const Lease6Ptr& lease) {
-    if (!lease || lease->type_ != Lease::TYPE_PD) {
-        return;
-    }
+        ConstElementPtr compression_el = params->get("webhook-compression");
+        if (compression_el && compression_el->getType() == Element::string) {
+            std::string name = compression_el->stringValue();
+            Compression compression = Compression::NONE;
+            if (!parseCompression(name, compression)) {
+                WARN_LOG("PD_WEBHOOK: Unknown webhook-compression '" + name + "', sending uncompressed");
+            } else if (!compressionAvailable(compression)) {
+                WARN_LOG("PD_WEBHOOK: webhook-compression '" + name + "' is not available in this build, "
+                         "sending uncompressed");
+            } else {
+                g_cfg.webhook_compression = compression;
+            }
+        }
 
-    PdAssignmentData data;
-    data.client_duid = toHex(lease->duid_->getDuid());
-    data.prefix = lease->addr_.toText();
-    data.prefix_length = lease->prefixlen_;
-    data.iaid = lease->iaid_;
-    data.cpe_link_local = "";
-    data.router_ip = "";
-    data.router_link_addr = "";
+        // Event filters and payload members
+        ConstElementPtr webhook_filter_el = params->get("webhook-event-filter");
+        if (webhook_filter_el) {
+            g_cfg.webhook_filter = parseEventFilter(webhook_filter_el, "webhook-event-filter");
+        }
 
-    // Re-activate in NetBox (update status to "active")
-    int existing_prefix_id = findPrefixId(data.prefix, data.prefix_length);
-    if (existing_prefix_id > 0) {
-        updatePrefix(existing_prefix_id, data, lease->valid_lft_, lease->preferred_lft_, "active");
-    } else {
-        // If not found, create new prefix
-        createPrefix(data, lease->valid_lft_, lease->preferred_lft_);
-    }
-}
+        ConstElementPtr netbox_filter_el = params->get("netbox-event-filter");
+        if (netbox_filter_el) {
+            g_cfg.netbox_filter = parseEventFilter(netbox_filter_el, "netbox-event-filter");
+        }
 
-// Hook callout: lease6_recover
-int
-lease6_recover(CalloutHandle& handle) {
-    try {
-        // Always log that hook was called
-        DEBUG_LOG("PD_WEBHOOK: lease6_recover called");
+        ConstElementPtr webhook_fields_el = params->get("webhook-fields");
+        if (webhook_fields_el) {
+            g_cfg.webhook_fields = parseFields(webhook_fields_el, "webhook-fields", parseWebhookField, WF_ALL);
+        }
 
-        if (!g_cfg.enabled) {
-            DEBUG_LOG("PD_WEBHOOK: hook disabled, returning");
-            return (0);
+        ConstElementPtr netbox_fields_el = params->get("netbox-fields");
+        if (netbox_fields_el) {
+            g_cfg.netbox_fields = parseFields(netbox_fields_el, "netbox-fields", parseNetBoxField, NF_ALL);
         }
 
-        Lease6Ptr lease;
-        handle.getArgument("lease6", lease);
+        // Spool configuration
+        ConstElementPtr spool_path_el = params->get("spool-path");
+        if (spool_path_el && spool_path_el->getType() == Element::string) {
+            g_cfg.spool_path = spool_path_el->stringValue();
+        }
 
-        if (!lease) {
-            DEBUG_LOG("PD_WEBHOOK: No lease provided, returning");
-            return (0);
+        ConstElementPtr spool_size_el = params->get("spool-max-size");
+        if (spool_size_el && spool_size_el->getType() == Element::integer) {
+            int64_t n = spool_size_el->intValue();
+            if (n > 0) {
+                g_cfg.spool_max_size = static_cast<size_t>(n);
+            }
         }
 
-        DEBUG_LOG("PD_WEBHOOK: Processing recovered lease: " << lease->addr_.toText() << "/" << lease->prefixlen_
-                  << " type: " << static_cast<int>(lease->type_));
+        ConstElementPtr spool_fsync_el = params->get("spool-fsync");
+        if (spool_fsync_el && spool_fsync_el->getType() == Element::string) {
+            std::string policy = spool_fsync_el->stringValue();
+            if (policy == "none") {
+                g_cfg.spool_fsync = EventSpool::SyncPolicy::NONE;
+            } else if (policy == "always") {
+                g_cfg.spool_fsync = EventSpool::SyncPolicy::ALWAYS;
+            } else if (policy == "interval") {
+                g_cfg.spool_fsync = EventSpool::SyncPolicy::INTERVAL;
+            } else {
+                WARN_LOG("PD_WEBHOOK: Unknown spool-fsync policy '" + policy + "', using interval");
+            }
+        }
 
-        if (lease->type_ == Lease::TYPE_PD) {
-            notifyPdRecovered(lease);
+        ConstElementPtr spool_interval_el = params->get("spool-fsync-interval-ms");
+        if (spool_interval_el && spool_interval_el->getType() == Element::integer) {
+            int64_t t = spool_interval_el->intValue();
+            if (t > 0) {
+                g_cfg.spool_fsync_interval_ms = static_cast<long>(t);
+            }
         }
 
-    } catch (...) {
-        // Do not throw into Kea; errors are silently ignored here.
-    }
+        ConstElementPtr drain_el = params->get("drain-timeout-ms");
+        if (drain_el && drain_el->getType() == Element::integer) {
+            int64_t t = drain_el->intValue();
+            if (t >= 0) {
+                g_cfg.drain_timeout_ms = static_cast<long>(t);
+            }
+        }
 
-    return (0);
-}
+        // Tracing configuration
+        ConstElementPtr trace_rate_el = params->get("trace-sample-rate");
+        if (trace_rate_el && (trace_rate_el->getType() == Element::real ||
+                              trace_rate_el->getType() == Element::integer)) {
+            double f = trace_rate_el->getType() == Element::real ?
+                trace_rate_el->doubleValue() : static_cast<double>(trace_rate_el->intValue());
+            if (f >= 0.0 && f <= 1.0) {
+                g_cfg.trace_sample_rate = f;
+            } else {
+                WARN_LOG("PD_WEBHOOK: trace-sample-rate must be in [0, 1], ignoring");
+            }
+        }
 
-// Library load hook: read configuration parameters.
-int
-load(LibraryHandle& handle) {
-    // Default.
-    g_cfg = WebhookConfig();
+        ConstElementPtr trace_url_el = params->get("trace-otlp-url");
+        if (trace_url_el && trace_url_el->getType() == Element::string) {
+            g_cfg.trace_otlp_url = trace_url_el->stringValue();
+        }
 
-    // Library parameters from kea config: hooks-libraries[].parameters
-    ConstElementPtr params = handle.getParameters();
-    if (params && params->getType() == Element::map) {
-        // Webhook configuration
-        ConstElementPtr url_el = params->get("webhook-url");
-        if (url_el && url_el->getType() == Element::string) {
-            g_cfg.url = url_el->stringValue();
+        ConstElementPtr trace_service_el = params->get("trace-service-name");
+        if (trace_service_el && trace_service_el->getType() == Element::string &&
+            !trace_service_el->stringValue().empty()) {
+            g_cfg.trace_service_name = trace_service_el->stringValue();
         }
 
-        ConstElementPtr timeout_el = params->get("timeout-ms");
-        if (timeout_el && timeout_el->getType() == Element::integer) {
-            long t = static_cast<long>(timeout_el->intValue());
-            if (t > 0) {
-                g_cfg.timeout_ms = t;
+        if (g_cfg.trace_sample_rate > 0.0 && g_cfg.trace_otlp_url.empty()) {
+            WARN_LOG("PD_WEBHOOK: trace-sample-rate is set without trace-otlp-url, tracing disabled");
+            g_cfg.trace_sample_rate = 0.0;
+        }
+
+        ConstElementPtr stats_interval_el = params->get("stats-interval-ms");
+        if (stats_interval_el && stats_interval_el->getType() == Element::integer) {
+            int64_t t = stats_interval_el->intValue();
+            if (t >= 0) {
+                g_cfg.stats_interval_ms = static_cast<long>(t);
             }
         }
-        
-        ConstElementPtr debug_el = params->get("debug");
-        if (debug_el && debug_el->getType() == Element::boolean) {
-            g_cfg.debug = debug_el->boolValue();
+
+        ConstElementPtr lookup_items_el = params->get("lookup-max-items");
+        if (lookup_items_el && lookup_items_el->getType() == Element::integer) {
+            int64_t n = lookup_items_el->intValue();
+            if (n > 0) {
+                g_cfg.lookup_max_items = static_cast<size_t>(n);
+            }
         }
 
-        // NetBox configuration
-        ConstElementPtr netbox_url_el = params->get("netbox-url");
-        if (netbox_url_el && netbox_url_el->getType() == Element::string) {
-            g_cfg.netbox_url = netbox_url_el->stringValue();
+        ConstElementPtr lookup_delay_el = params->get("lookup-max-delay-ms");
+        if (lookup_delay_el && lookup_delay_el->getType() == Element::integer) {
+            int64_t t = lookup_delay_el->intValue();
+            if (t >= 0) {
+                g_cfg.lookup_max_delay_ms = static_cast<long>(t);
+            }
         }
 
-        ConstElementPtr netbox_token_el = params->get("netbox-token");
-        if (netbox_token_el && netbox_token_el->getType() == Element::string) {
-            g_cfg.netbox_token = netbox_token_el->stringValue();
+        // Expiry sweep configuration
+        ConstElementPtr expire_items_el = params->get("expire-batch-max-items");
+        if (expire_items_el && expire_items_el->getType() == Element::integer) {
+            int64_t n = expire_items_el->intValue();
+            if (n > 0) {
+                g_cfg.expire_batch_max_items = static_cast<size_t>(n);
+            }
+        }
+
+        ConstElementPtr expire_idle_el = params->get("expire-batch-idle-ms");
+        if (expire_idle_el && expire_idle_el->getType() == Element::integer) {
+            int64_t t = expire_idle_el->intValue();
+            if (t >= 0) {
+                g_cfg.expire_batch_idle_ms = static_cast<long>(t);
+            }
         }
     }
 
     g_cfg.enabled = !g_cfg.url.empty();
-    g_cfg.netbox_enabled = !g_cfg.netbox_url.empty() && !g_cfg.netbox_token.empty();
+    if (g_cfg.null_netbox) {
+        g_cfg.netbox_backends.clear();
+    }
+    g_cfg.netbox_enabled = g_cfg.null_netbox || !g_cfg.netbox_backends.empty() ||
+                           (!g_cfg.netbox_url.empty() && !g_cfg.netbox_token.empty());
 
     // Initialize libcurl once.
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
+    handle.registerCommandCallout("pd-webhook-errors-get", pd_webhook_errors_get);
+    handle.registerCommandCallout("pd-webhook-stats-get", pd_webhook_stats_get);
+
+    // Handles are reused across requests to keep connections alive.
+    g_pool.reset(new CurlPool());
+    g_pool->setNetBoxToken(g_cfg.netbox_token);
+    g_pool->setWebhookContent(g_cfg.webhook_ndjson ? "application/x-ndjson" : "application/json",
+                              compressionName(g_cfg.webhook_compression));
+
+    if (g_cfg.multi_engine) {
+        MultiTransport* multi = new MultiTransport(*g_pool, g_cfg.engine_threads,
+                                                   static_cast<long>(g_cfg.max_in_flight), g_cfg.http2);
+        g_transport.reset(multi);
+        multi->start();
+    } else {
+        g_transport.reset(new EasyTransport(*g_pool));
+    }
+    if (g_cfg.trace_sample_rate > 0.0) {
+        Tracer::Config trace;
+        trace.sample_rate = g_cfg.trace_sample_rate;
+        trace.service_name = g_cfg.trace_service_name;
+        g_tracer.reset(new Tracer(trace, exportTraces));
+    }
+
+    // A bulk request carries up to bulk-max-items transactions, so admit that
+    // many more for the same number of requests in flight.
+    g_netbox_limiter.reset(new InflightLimiter(g_cfg.max_in_flight * g_cfg.bulk_max_items));
+
+    g_retry_policy.reset(new RetryPolicy(g_cfg.retry_max_attempts,
+                                         std::chrono::milliseconds(g_cfg.retry_backoff_ms),
+                                         std::chrono::milliseconds(g_cfg.retry_backoff_max_ms),
+                                         g_cfg.retry_jitter));
+    if (g_cfg.retry_max_attempts > 1) {
+        g_retry_scheduler.reset(new RetryScheduler());
+        g_retry_scheduler->start();
+    }
+    g_netbox_breaker.reset(new CircuitBreaker(g_cfg.breaker_failure_threshold,
+                                              std::chrono::milliseconds(g_cfg.breaker_cooldown_ms)));
+    g_webhook_breaker.reset(new CircuitBreaker(g_cfg.breaker_failure_threshold,
+                                               std::chrono::milliseconds(g_cfg.breaker_cooldown_ms)));
+    g_webhook_limiter.reset(new InflightLimiter(g_cfg.max_in_flight));
+    if (g_cfg.netbox_rate_limit > 0.0 && g_cfg.netbox_backends.empty()) {
+        double burst = g_cfg.netbox_rate_burst > 0.0 ? g_cfg.netbox_rate_burst : g_cfg.netbox_rate_limit;
+        g_netbox_rate.reset(new TokenBucket(g_cfg.netbox_rate_limit, burst));
+    }
+    if (g_cfg.webhook_rate_limit > 0.0) {
+        double burst = g_cfg.webhook_rate_burst > 0.0 ? g_cfg.webhook_rate_burst : g_cfg.webhook_rate_limit;
+        g_webhook_rate.reset(new TokenBucket(g_cfg.webhook_rate_limit, burst));
+    }
+
+    // Room for every cached prefix plus a full queue of others.
+    size_t table_entries = g_cfg.prefix_cache_size > 0 ? g_cfg.prefix_cache_size : 100000;
+    g_prefix_table.reset(new PrefixTable(table_entries + g_cfg.queue_size));
+
+    if (g_cfg.null_netbox) {
+        g_netbox.reset(new NullNetBoxClient());
+    } else if (!g_cfg.netbox_backends.empty()) {
+        createNetBoxBackends();
+    } else if (g_cfg.netbox_enabled) {
+        HttpNetBoxClient::Config netbox;
+        netbox.url = g_cfg.netbox_url;
+        netbox.headers = g_pool->netboxHeaders();
+        netbox.timeout_ms = g_cfg.timeout_ms;
+        netbox.json_encoder = g_cfg.json_encoder;
+        netbox.fields = g_cfg.netbox_fields;
+        netbox.prefix_table = g_cfg.prefix_cache_size > 0 ? g_prefix_table.get() : nullptr;
+        netbox.prefix_cache_ttl = g_cfg.prefix_cache_ttl;
+        netbox.warmup_filter = g_cfg.cache_warmup_filter;
+        netbox.warmup_page_size = g_cfg.cache_warmup_page_size;
+        netbox.bulk_max_items = g_cfg.bulk_max_items;
+        netbox.bulk_max_delay_ms = g_cfg.bulk_max_delay_ms;
+        netbox.lookup_max_items = g_cfg.lookup_max_items;
+        netbox.lookup_max_delay_ms = g_cfg.lookup_max_delay_ms;
+        g_netbox.reset(new HttpNetBoxClient(netbox, sendNetBoxHttp, &g_errors, g_stats.netbox));
+    }
+
+    // Fill the cache before the first renewals arrive, or alongside them.
+    g_warmup_stop = false;
+    if (g_netbox && g_cfg.cache_warmup == WebhookConfig::Warmup::BLOCK) {
+        g_netbox->warmCache(g_warmup_stop);
+    } else if (g_netbox && g_cfg.cache_warmup == WebhookConfig::Warmup::BACKGROUND && g_cfg.prefix_cache_size > 0) {
+        g_warmup_thread = std::thread([] { g_netbox->warmCache(g_warmup_stop); });
+    } else if (!g_backends.empty() && g_cfg.cache_warmup == WebhookConfig::Warmup::BLOCK) {
+        for (const auto& backend : g_backends) {
+            backend->client->warmCache(g_warmup_stop);
+        }
+    } else if (!g_backends.empty() && g_cfg.cache_warmup == WebhookConfig::Warmup::BACKGROUND &&
+               g_cfg.prefix_cache_size > 0) {
+        g_warmup_thread = std::thread([] {
+            for (const auto& backend : g_backends) {
+                backend->client->warmCache(g_warmup_stop);
+            }
+        });
+    }
+
+    if (g_cfg.renew_suppress_fraction > 0.0) {
+        g_renewal_filter.reset(new RenewalFilter(g_cfg.renew_suppress_fraction, *g_prefix_table));
+    }
+
+    if (!g_cfg.spool_path.empty()) {
+        std::string spool_error;
+        g_spool.reset(new EventSpool(g_cfg.spool_path, g_cfg.spool_max_size, g_cfg.spool_fsync,
+                                     std::chrono::milliseconds(g_cfg.spool_fsync_interval_ms)));
+        if (!g_spool->open(spool_error)) {
+            ERROR_LOG(ErrorCode::SPOOL_FAILED, "spool", "PD_WEBHOOK: Event spool disabled: " + spool_error);
+            g_spool.reset();
+        }
+    }
+
+    // Start the sender threads; with zero threads events are delivered inline.
+    if (g_cfg.sender_threads > 0) {
+        g_queue.reset(new DispatchQueue(*g_prefix_table, g_cfg.queue_size, g_cfg.sender_threads,
+                                        g_cfg.queue_overflow, deliverEvent, g_cfg.intake_ring_size));
+        g_queue->start();
+    }
+
+    // NDJSON batches go out at webhook-batch-max-items or after webhook-batch-max-delay-ms.
+    if (g_cfg.webhook_ndjson) {
+        g_webhook_batcher.reset(new Batcher<WebhookLine>(g_cfg.webhook_batch_max_items,
+                                                         std::chrono::milliseconds(g_cfg.webhook_batch_max_delay_ms),
+                                                         postWebhookLines));
+        g_webhook_batcher->start();
+    }
+
+    // Sweeps end when lease6_expire has been quiet for expire-batch-idle-ms.
+    if (g_cfg.expire_batch_max_items > 1) {
+        g_expire_sweep.reset(new Batcher<PdEvent>(g_cfg.expire_batch_max_items,
+                                                  std::chrono::milliseconds(g_cfg.expire_batch_idle_ms),
+                                                  deliverExpiredBatch, true));
+        g_expire_sweep->start();
+    }
+
+    g_accepting = true;
+
+    // Replay what the previous run left undelivered.
+    if (g_spool) {
+        std::vector<PdEvent> backlog = g_spool->takeBacklog();
+        if (!backlog.empty()) {
+            DEBUG_LOG("PD_WEBHOOK: Replaying " << backlog.size() << " spooled events");
+        }
+        for (PdEvent& ev : backlog) {
+            // Records do not keep the sinks; the filters may also have changed.
+            ev.sinks = eventSinks(EventFilter::inputFor(ev));
+            if (ev.sinks == 0) {
+                g_spool->complete(ev.spool_seq);
+                continue;
+            }
+            dispatchEvent(std::move(ev));
+        }
+    }
+
+    // Repairs whatever the event path missed, on its own thread.
+    if (g_netbox && g_cfg.reconcile_interval_sec > 0) {
+        g_reconciler.reset(new Reconciler(reconcileConfig(), *g_netbox, forgetPush));
+        g_reconciler->start();
+    }
+
+    // One reconciler per backend, over the leases routed to it. Leases in the
+    // database carry no relay link-address, so with link-prefix routes only
+    // the mirrors, which hold every lease, can be reconciled.
+    if (!g_backends.empty() && g_cfg.reconcile_interval_sec > 0) {
+        if (g_router->hasLinkRoutes()) {
+            WARN_LOG("PD_WEBHOOK: netbox-routes test relay-link-prefix, only mirrors are reconciled");
+        }
+        for (size_t b = 0; b < g_backends.size(); ++b) {
+            NetBoxBackend& backend = *g_backends[b];
+            if (g_router->hasLinkRoutes() && !backend.mirror) {
+                continue;
+            }
+            Reconciler::Config reconcile = reconcileConfig();
+            if (!backend.mirror) {
+                reconcile.lease_filter = [b](const PrefixKey& prefix, uint32_t subnet_id) {
+                    return ((g_router->targets(subnet_id, prefix, nullptr, false) >> b) & 1) != 0;
+                };
+            }
+            backend.reconciler.reset(new Reconciler(reconcile, *backend.client, forgetPush));
+            backend.reconciler->start();
+        }
+    }
+
+    if (g_cfg.stats_interval_ms > 0) {
+        g_stats_stop = false;
+        publishStats();
+        g_stats_thread = std::thread(runStatsPublisher);
+    }
+
     return (0);
 }
 
+// Wait until no events are queued and, with in_flight, none are being
+// delivered either; false if the deadline came first
+static bool
+waitForDrain(std::chrono::steady_clock::time_point deadline, bool in_flight) {
+    for (;;) {
+        DispatchQueue::Stats stats{};
+        if (g_queue) {
+            stats = g_queue->getStats();
+        }
+        if (stats.depth == 0 &&
+            (!in_flight || (stats.active == 0 && g_deliveries.load(std::memory_order_acquire) == 0))) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
 // Library unload hook.
 int
 unload() {
+    // The publisher reads the components torn down below.
+    if (g_stats_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(g_stats_mutex);
+            g_stats_stop = true;
+        }
+        g_stats_cv.notify_all();
+        g_stats_thread.join();
+    }
+    for (const auto& value : statValues()) {
+        isc::stats::StatsMgr::instance().del(value.first);
+    }
+
+    // Drain: take no new events, then give the queued and in-flight ones
+    // until drain-timeout-ms to finish. The warm-up and reconciler are not
+    // events and stop first: the warm-up after the page it is waiting for, a
+    // pass once its current request completes.
+    auto drain_start = std::chrono::steady_clock::now();
+    auto drain_deadline = drain_start + std::chrono::milliseconds(g_cfg.drain_timeout_ms);
+    uint64_t sent_before = g_stats.sent.value();
+    uint64_t failed_before = g_stats.failed.value();
+    g_accepting = false;
+
+    g_warmup_stop = true;
+    if (g_warmup_thread.joinable()) {
+        g_warmup_thread.join();
+    }
+    if (g_reconciler) {
+        g_reconciler->stop();
+    }
+    for (const auto& backend : g_backends) {
+        if (backend->reconciler) {
+            backend->reconciler->stop();
+        }
+    }
+
+    // The sweep being collected feeds the queue and the NDJSON batch.
+    if (g_expire_sweep) {
+        g_expire_sweep->stop();
+    }
+    waitForDrain(drain_deadline, false);
+
+    // Nothing is left to join the batches, so send them now, then wait for the
+    // requests still in flight.
+    if (g_webhook_batcher) {
+        g_webhook_batcher->stop();
+    }
+    if (g_netbox) {
+        g_netbox->flush();
+    }
+    for (const auto& backend : g_backends) {
+        backend->client->flush();
+    }
+    bool drained = waitForDrain(drain_deadline, true);
+    size_t in_flight = g_deliveries.load();
+    uint64_t sent = g_stats.sent.value();
+    uint64_t failed = g_stats.failed.value();
+    auto drain_elapsed = std::chrono::steady_clock::now() - drain_start;
+
+    // Export the spans of the drained events while the transport still runs.
+    if (g_tracer) {
+        g_tracer->stop();
+    }
+
+    // Unblock sender threads waiting for an in-flight slot or a token.
+    if (g_netbox_limiter) {
+        g_netbox_limiter->close();
+        g_webhook_limiter->close();
+    }
+    if (g_netbox_rate) {
+        g_netbox_rate->close();
+    }
+    if (g_webhook_rate) {
+        g_webhook_rate->close();
+    }
+    for (const auto& backend : g_backends) {
+        backend->limiter->close();
+        if (backend->rate) {
+            backend->rate->close();
+        }
+    }
+
+    size_t discarded = g_queue ? g_queue->stop() : 0;
+
+    // Backend work not started yet fails, keeping its events in the spool.
+    for (const auto& backend : g_backends) {
+        backend->lane->stop();
+    }
+
+    // Retries still waiting for their backoff complete with their last failure.
+    if (g_retry_scheduler) {
+        g_retry_scheduler->stop();
+    }
+
+    // Outstanding asynchronous requests complete with an error here; their
+    // completions still reach the queue, so it is destroyed afterwards.
+    if (g_transport) {
+        g_transport->stop();
+        g_transport.reset();
+    }
+
+    // Events that failed or did not finish in time stay in the spool for the next load.
+    uint64_t left = discarded + in_flight + g_refused.load() + (failed - failed_before);
+    INFO_LOG("PD_WEBHOOK: Drain " << (drained ? "completed" : "timed out") << " after "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(drain_elapsed).count()
+              << " ms: drained=" << sent - sent_before
+              << " spooled=" << (g_spool ? left : 0)
+              << " dropped=" << (g_spool ? 0 : left));
+    g_refused = 0;
+
+    if (g_queue) {
+        DispatchQueue::Stats stats = g_queue->getStats();
+        INFO_LOG("PD_WEBHOOK: Dispatch queue stopped: enqueued=" << stats.enqueued
+                  << " delivered=" << stats.delivered
+                  << " coalesced=" << stats.coalesced
+                  << " dropped_oldest=" << stats.dropped_oldest
+                  << " dropped_newest=" << stats.dropped_newest
+                  << " shed=" << stats.shed
+                  << " discarded=" << discarded
+                  << " intake_batches=" << stats.intake_batches
+                  << " ring_full=" << stats.ring_full);
+        g_queue.reset();
+    }
+
+    // The export completions ran when the transport stopped.
+    if (g_tracer) {
+        Tracer::Stats trace_stats = g_tracer->getStats();
+        INFO_LOG("PD_WEBHOOK: Tracing: traces=" << trace_stats.traces
+                  << " spans=" << trace_stats.spans
+                  << " dropped=" << trace_stats.dropped
+                  << " batches=" << trace_stats.batches);
+        g_tracer.reset();
+    }
+
+    if (g_webhook_batcher) {
+        INFO_LOG("PD_WEBHOOK: Webhook batches: batches=" << g_webhook_batcher->batches()
+                  << " events=" << g_webhook_batcher->items());
+        g_webhook_batcher.reset();
+    }
+    if (g_cfg.webhook_compression != Compression::NONE) {
+        INFO_LOG("PD_WEBHOOK: Webhook compression: encoding=" << compressionName(g_cfg.webhook_compression)
+                  << " raw_bytes=" << g_webhook_raw_bytes.load()
+                  << " sent_bytes=" << g_webhook_sent_bytes.load());
+    }
+    g_webhook_raw_bytes = 0;
+    g_webhook_sent_bytes = 0;
+
+    if (g_expire_sweep) {
+        INFO_LOG("PD_WEBHOOK: Expiry sweeps: batches=" << g_expire_sweep->batches()
+                  << " expirations=" << g_expire_sweep->items());
+        g_expire_sweep.reset();
+    }
+
+    // Records of events that were not delivered stay pending for the next load.
+    if (g_spool) {
+        EventSpool::Stats spool_stats = g_spool->getStats();
+        INFO_LOG("PD_WEBHOOK: Event spool: appended=" << spool_stats.appended
+                  << " completed=" << spool_stats.completed
+                  << " superseded=" << spool_stats.superseded
+                  << " overwritten=" << spool_stats.overwritten
+                  << " unspoolable=" << spool_stats.unspoolable
+                  << " replayed=" << spool_stats.replayed
+                  << " pending=" << spool_stats.pending);
+        g_spool->close();
+        g_spool.reset();
+    }
+
+    g_netbox_limiter.reset();
+    g_webhook_limiter.reset();
+
+    if (g_netbox_rate) {
+        TokenBucket::Stats rate_stats = g_netbox_rate->getStats();
+        INFO_LOG("PD_WEBHOOK: NetBox rate limit: granted=" << rate_stats.granted
+                  << " delayed=" << rate_stats.delayed
+                  << " shed=" << rate_stats.shed);
+        g_netbox_rate.reset();
+    }
+    if (g_webhook_rate) {
+        TokenBucket::Stats rate_stats = g_webhook_rate->getStats();
+        INFO_LOG("PD_WEBHOOK: Webhook rate limit: granted=" << rate_stats.granted
+                  << " delayed=" << rate_stats.delayed
+                  << " shed=" << rate_stats.shed);
+        g_webhook_rate.reset();
+    }
+
+    if (g_retry_policy) {
+        RetryPolicy::Stats retry_stats = g_retry_policy->getStats();
+        INFO_LOG("PD_WEBHOOK: Retries: retries=" << retry_stats.retries
+                  << " recovered=" << retry_stats.recovered
+                  << " exhausted=" << retry_stats.exhausted);
+        g_retry_scheduler.reset();
+        g_retry_policy.reset();
+    }
+
+    if (g_netbox_breaker) {
+        CircuitBreaker::Stats netbox_stats = g_netbox_breaker->getStats();
+        CircuitBreaker::Stats webhook_stats = g_webhook_breaker->getStats();
+        INFO_LOG("PD_WEBHOOK: NetBox breaker: state=" << CircuitBreaker::stateName(netbox_stats.state)
+                  << " failures=" << netbox_stats.failures
+                  << " opened=" << netbox_stats.opened
+                  << " rejected=" << netbox_stats.rejected);
+        INFO_LOG("PD_WEBHOOK: Webhook breaker: state=" << CircuitBreaker::stateName(webhook_stats.state)
+                  << " failures=" << webhook_stats.failures
+                  << " opened=" << webhook_stats.opened
+                  << " rejected=" << webhook_stats.rejected);
+        g_netbox_breaker.reset();
+        g_webhook_breaker.reset();
+    }
+
+    if (g_reconciler) {
+        Reconciler::Stats reconcile_stats = g_reconciler->getStats();
+        INFO_LOG("PD_WEBHOOK: Reconciler: runs=" << reconcile_stats.runs
+                  << " failed=" << reconcile_stats.failed_runs
+                  << " created=" << reconcile_stats.created
+                  << " updated=" << reconcile_stats.updated
+                  << " deprecated=" << reconcile_stats.deprecated
+                  << " superseded=" << reconcile_stats.superseded
+                  << " rejected=" << reconcile_stats.rejected);
+        g_reconciler.reset();
+    }
+
+    if (g_netbox) {
+        INetBoxClient::Stats netbox_stats = g_netbox->getStats();
+        if (netbox_stats.lookup_batches > 0) {
+            INFO_LOG("PD_WEBHOOK: Bulk lookups: batches=" << netbox_stats.lookup_batches
+                      << " items=" << netbox_stats.lookup_items);
+        }
+        if (netbox_stats.write_batches > 0) {
+            INFO_LOG("PD_WEBHOOK: Bulk writes: batches=" << netbox_stats.write_batches
+                      << " items=" << netbox_stats.write_items);
+        }
+        if (netbox_stats.cached) {
+            INFO_LOG("PD_WEBHOOK: Prefix cache: hits=" << netbox_stats.cache.hits
+                      << " misses=" << netbox_stats.cache.misses
+                      << " evictions=" << netbox_stats.cache.evictions
+                      << " invalidations=" << netbox_stats.cache.invalidations
+                      << " size=" << netbox_stats.cache.size);
+        }
+        g_netbox.reset();
+    }
+
+    // The transport is gone, so no completion refers to a backend any more.
+    for (const auto& backend : g_backends) {
+        WorkLane::Stats lane_stats = backend->lane->getStats();
+        CircuitBreaker::Stats breaker_stats = backend->breaker->getStats();
+        TokenBucket::Stats rate_stats{};
+        if (backend->rate) {
+            rate_stats = backend->rate->getStats();
+        }
+        INFO_LOG("PD_WEBHOOK: NetBox backend " << backend->name << (backend->mirror ? " (mirror)" : "")
+                  << ": sent=" << backend->sent.value()
+                  << " failed=" << backend->failed.value()
+                  << " rejected=" << lane_stats.rejected
+                  << " discarded=" << lane_stats.discarded
+                  << " shed=" << rate_stats.shed
+                  << " breaker=" << CircuitBreaker::stateName(breaker_stats.state)
+                  << " opened=" << breaker_stats.opened);
+        if (backend->reconciler) {
+            Reconciler::Stats reconcile_stats = backend->reconciler->getStats();
+            INFO_LOG("PD_WEBHOOK: Reconciler of " << backend->name << ": runs=" << reconcile_stats.runs
+                      << " failed=" << reconcile_stats.failed_runs
+                      << " created=" << reconcile_stats.created
+                      << " updated=" << reconcile_stats.updated
+                      << " deprecated=" << reconcile_stats.deprecated
+                      << " superseded=" << reconcile_stats.superseded
+                      << " rejected=" << reconcile_stats.rejected);
+        }
+        INetBoxClient::Stats netbox_stats = backend->client->getStats();
+        if (netbox_stats.cached) {
+            INFO_LOG("PD_WEBHOOK: Prefix cache of " << backend->name << ": hits=" << netbox_stats.cache.hits
+                      << " misses=" << netbox_stats.cache.misses
+                      << " size=" << netbox_stats.cache.size);
+        }
+    }
+    g_backends.clear();
+    g_router.reset();
+
+    if (g_renewal_filter) {
+        RenewalFilter::Stats filter_stats = g_renewal_filter->getStats();
+        INFO_LOG("PD_WEBHOOK: Renewal filter: suppressed=" << filter_stats.suppressed
+                  << " passed=" << filter_stats.passed
+                  << " size=" << filter_stats.size);
+        g_renewal_filter.reset();
+    }
+
+    // Last, after everything that keeps state in it.
+    if (g_prefix_table) {
+        PrefixTable::Stats table_stats = g_prefix_table->getStats();
+        INFO_LOG("PD_WEBHOOK: State table: entries=" << table_stats.entries
+                  << " slots=" << table_stats.slots
+                  << " bytes=" << table_stats.memory_bytes
+                  << " evictions=" << table_stats.evictions);
+        g_prefix_table.reset();
+    }
+    g_pool.reset();
     curl_global_cleanup();
     g_cfg = WebhookConfig();
     return (0);
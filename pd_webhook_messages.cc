@@ -0,0 +1,25 @@
+// File created from pd_webhook_messages.mes
+
+#include <cstddef>
+#include <log/message_types.h>
+#include <log/message_initializer.h>
+
+extern const isc::log::MessageID PD_WEBHOOK_DEBUG = "PD_WEBHOOK_DEBUG";
+extern const isc::log::MessageID PD_WEBHOOK_ERROR = "PD_WEBHOOK_ERROR";
+extern const isc::log::MessageID PD_WEBHOOK_INFO = "PD_WEBHOOK_INFO";
+extern const isc::log::MessageID PD_WEBHOOK_WARNING = "PD_WEBHOOK_WARNING";
+
+namespace {
+
+const char* values[] = {
+    "PD_WEBHOOK_DEBUG", "%1",
+    "PD_WEBHOOK_ERROR", "%1",
+    "PD_WEBHOOK_INFO", "%1",
+    "PD_WEBHOOK_WARNING", "%1",
+    NULL
+};
+
+const isc::log::MessageInitializer initializer(values);
+
+} // Anonymous namespace
+
@@ -0,0 +1,13 @@
+// File created from pd_webhook_messages.mes
+
+#ifndef PD_WEBHOOK_MESSAGES_H
+#define PD_WEBHOOK_MESSAGES_H
+
+#include <log/message_types.h>
+
+extern const isc::log::MessageID PD_WEBHOOK_DEBUG;
+extern const isc::log::MessageID PD_WEBHOOK_ERROR;
+extern const isc::log::MessageID PD_WEBHOOK_INFO;
+extern const isc::log::MessageID PD_WEBHOOK_WARNING;
+
+#endif // PD_WEBHOOK_MESSAGES_H
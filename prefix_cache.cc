@@ -0,0 +1,57 @@
+#include "prefix_cache.h"
+
+PrefixIdCache::PrefixIdCache(PrefixTable& table, std::chrono::seconds ttl)
+    : table_(table), ttl_(static_cast<uint32_t>(ttl.count() > 0 ? ttl.count() : 1)) {
+}
+
+int
+PrefixIdCache::get(const PrefixKey& prefix) {
+    int id = -1;
+    uint32_t now = table_.now();
+    table_.modify(prefix, [&id, now](PrefixTable::Entry& entry) {
+        if (!(entry.flags & PrefixTable::HAS_ID)) {
+            return;
+        }
+        if (now >= entry.id_expires) {
+            entry.flags &= ~PrefixTable::HAS_ID;
+            return;
+        }
+        id = entry.netbox_id;
+    });
+
+    (id > 0 ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void
+PrefixIdCache::put(const PrefixKey& prefix, int id) {
+    if (id <= 0) {
+        return;
+    }
+
+    uint32_t expires = table_.now() + ttl_;
+    table_.update(prefix, [id, expires](PrefixTable::Entry& entry) {
+        entry.flags |= PrefixTable::HAS_ID;
+        entry.netbox_id = id;
+        entry.id_expires = expires;
+    });
+}
+
+void
+PrefixIdCache::invalidate(const PrefixKey& prefix) {
+    bool invalidated = false;
+    table_.modify(prefix, [&invalidated](PrefixTable::Entry& entry) {
+        invalidated = (entry.flags & PrefixTable::HAS_ID) != 0;
+        entry.flags &= ~PrefixTable::HAS_ID;
+    });
+    if (invalidated) {
+        invalidations_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PrefixIdCache::Stats
+PrefixIdCache::getStats() const {
+    PrefixTable::Stats table = table_.getStats();
+    return Stats{hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed), table.evictions,
+                 invalidations_.load(std::memory_order_relaxed), table.ids};
+}
@@ -0,0 +1,49 @@
+#ifndef PREFIX_CACHE_H
+#define PREFIX_CACHE_H
+
+#include "prefix_table.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Map from (prefix, prefix length) to NetBox prefix ID, kept in the shared
+// PrefixTable.
+//
+// Filled from lookup and create responses so renewals can PATCH the known ID
+// without searching for it first. Entries expire after the TTL; when the table
+// is full it evicts the IDs closest to expiring.
+class PrefixIdCache {
+public:
+    // Snapshot of the cache counters
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;          // State table evictions, of any kind
+        uint64_t invalidations;
+        size_t size;
+    };
+
+    PrefixIdCache(PrefixTable& table, std::chrono::seconds ttl);
+
+    // Return the cached ID, or -1 if unknown or expired
+    int get(const PrefixKey& prefix);
+
+    void put(const PrefixKey& prefix, int id);
+
+    // Forget an ID that NetBox no longer knows (e.g. PATCH returned 404)
+    void invalidate(const PrefixKey& prefix);
+
+    Stats getStats() const;
+
+private:
+    PrefixTable& table_;
+    const uint32_t ttl_;             // Seconds
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> invalidations_{0};
+};
+
+#endif // PREFIX_CACHE_H
@@ -0,0 +1,195 @@
+#include "prefix_table.h"
+
+#include <algorithm>
+
+static_assert(sizeof(PrefixTable::Entry) == 48, "PrefixTable::Entry should stay compact");
+
+// Slots a shard starts with once it gets its first entry
+static const size_t kInitialSlots = 16;
+
+// Entries considered, and slots scanned at most, when choosing what to evict
+static const size_t kEvictionCandidates = 8;
+static const size_t kEvictionScan = 64;
+
+// Each shard may hold its share of max_entries plus some slack for uneven hashing
+PrefixTable::PrefixTable(size_t max_entries)
+    : shard_limit_(std::max(kInitialSlots, max_entries / kShards * 5 / 4 + 1)),
+      epoch_(std::chrono::steady_clock::now()),
+      shards_(new Shard[kShards]) {
+}
+
+uint64_t
+PrefixTable::hash(const PrefixKey& key) {
+    uint64_t a;
+    uint64_t b;
+    std::memcpy(&a, key.addr, sizeof(a));
+    std::memcpy(&b, key.addr + sizeof(a), sizeof(b));
+    uint64_t h = a * 0x9e3779b97f4a7c15ULL ^ (b + key.length) * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+uint32_t
+PrefixTable::now() const {
+    auto elapsed = std::chrono::steady_clock::now() - epoch_;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(elapsed).count()) + 1;
+}
+
+PrefixTable::Entry*
+PrefixTable::find(Shard& shard, const PrefixKey& key, uint64_t h) {
+    if (shard.slots.empty()) {
+        return nullptr;
+    }
+    size_t mask = shard.slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        Entry& entry = shard.slots[i];
+        if (entry.key.length == 0) {
+            return nullptr;
+        }
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+}
+
+PrefixTable::Entry*
+PrefixTable::insert(Shard& shard, const PrefixKey& key, uint64_t h) {
+    if (shard.size >= shard_limit_ && !evict(shard, h)) {
+        return nullptr;
+    }
+    // Keep the load factor at or below 3/4.
+    if ((shard.size + 1) * 4 > shard.slots.size() * 3) {
+        grow(shard);
+    }
+
+    size_t mask = shard.slots.size() - 1;
+    size_t i = h & mask;
+    while (shard.slots[i].key.length != 0) {
+        i = (i + 1) & mask;
+    }
+    Entry& entry = shard.slots[i];
+    entry = Entry();
+    entry.key = key;
+    ++shard.size;
+    entries_.fetch_add(1, std::memory_order_relaxed);
+    return &entry;
+}
+
+// Backward-shift deletion: move later members of the probe run into the gap
+// unless that would put them before their home slot.
+void
+PrefixTable::erase(Shard& shard, Entry* entry) {
+    size_t mask = shard.slots.size() - 1;
+    size_t gap = static_cast<size_t>(entry - shard.slots.data());
+    for (size_t j = (gap + 1) & mask;; j = (j + 1) & mask) {
+        Entry& next = shard.slots[j];
+        if (next.key.length == 0) {
+            break;
+        }
+        size_t home = hash(next.key) & mask;
+        bool stays = gap <= j ? (gap < home && home <= j) : (gap < home || home <= j);
+        if (!stays) {
+            shard.slots[gap] = next;
+            gap = j;
+        }
+    }
+    shard.slots[gap] = Entry();
+    --shard.size;
+    entries_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Account for the flags fn changed, and drop the entry if nothing is left in it
+void
+PrefixTable::finish(Shard& shard, Entry* entry, uint8_t old_flags) {
+    uint8_t changed = old_flags ^ entry->flags;
+    if (changed & HAS_ID) {
+        (entry->flags & HAS_ID) ? ids_.fetch_add(1, std::memory_order_relaxed) :
+                                  ids_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (changed & HAS_PUSH) {
+        (entry->flags & HAS_PUSH) ? pushes_.fetch_add(1, std::memory_order_relaxed) :
+                                    pushes_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (entry->flags == 0) {
+        erase(shard, entry);
+    }
+}
+
+// Make room in a full shard. Among the first few entries of the probe window
+// the cheapest to lose goes: one whose lease has run out, then one with only a
+// renewal fingerprint, then the cached ID closest to expiring. Queued, swept
+// or in-flight prefixes stay.
+bool
+PrefixTable::evict(Shard& shard, uint64_t h) {
+    if (shard.slots.empty()) {
+        return false;
+    }
+
+    size_t mask = shard.slots.size() - 1;
+    int64_t wall = static_cast<int64_t>(time(nullptr));
+    Entry* victim = nullptr;
+    uint32_t victim_score = 0;
+    size_t candidates = 0;
+    for (size_t n = 0, i = h & mask; n < kEvictionScan && n <= mask && candidates < kEvictionCandidates;
+         ++n, i = (i + 1) & mask) {
+        Entry& entry = shard.slots[i];
+        if (entry.key.length == 0 || (entry.flags & (PENDING | BUSY | SWEPT))) {
+            continue;
+        }
+        ++candidates;
+        uint32_t score = (entry.flags & HAS_ID) ? entry.id_expires : 0;
+        if ((entry.flags & HAS_PUSH) && entry.pushed_expires_at >= wall) {
+            score = std::max<uint32_t>(score, 1);
+        }
+        if (!victim || score < victim_score) {
+            victim = &entry;
+            victim_score = score;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+
+    if (victim->flags & HAS_ID) {
+        ids_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (victim->flags & HAS_PUSH) {
+        pushes_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    erase(shard, victim);
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void
+PrefixTable::grow(Shard& shard) {
+    size_t size = shard.slots.empty() ? kInitialSlots : shard.slots.size() * 2;
+    std::vector<Entry> slots(size);
+    size_t mask = size - 1;
+    for (const Entry& entry : shard.slots) {
+        if (entry.key.length == 0) {
+            continue;
+        }
+        size_t i = hash(entry.key) & mask;
+        while (slots[i].key.length != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = entry;
+    }
+    slots_.fetch_add(size - shard.slots.size(), std::memory_order_relaxed);
+    shard.slots.swap(slots);
+}
+
+PrefixTable::Stats
+PrefixTable::getStats() const {
+    Stats stats;
+    stats.entries = entries_.load(std::memory_order_relaxed);
+    stats.ids = ids_.load(std::memory_order_relaxed);
+    stats.pushes = pushes_.load(std::memory_order_relaxed);
+    stats.slots = slots_.load(std::memory_order_relaxed);
+    stats.memory_bytes = stats.slots * sizeof(Entry) + kShards * sizeof(Shard) + sizeof(*this);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    return stats;
+}
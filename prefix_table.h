@@ -0,0 +1,140 @@
+#ifndef PREFIX_TABLE_H
+#define PREFIX_TABLE_H
+
+#include "pd_address.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Per-prefix state shared by the prefix ID cache, the renewal filter and the
+// dispatch queue.
+//
+// Open addressing with linear probing over fixed-size 48-byte entries, split
+// into shards that each have their own lock and grow independently; deletion
+// shifts entries back, so lookups never walk tombstones. Once the table holds
+// max_entries, an insert evicts the entry in its probe window with the
+// soonest-expiring state; entries with queued, swept or in-flight events are
+// never evicted.
+class PrefixTable {
+public:
+    enum Flags : uint8_t {
+        HAS_ID = 1,                  // netbox_id and id_expires are set
+        HAS_PUSH = 2,                // fingerprint and pushed_expires_at are set
+        PENDING = 4,                 // pending holds a queued event
+        BUSY = 8,                    // An event for the prefix is being delivered
+        SWEPT = 16                   // An expiration is held in the expiry sweep
+    };
+
+    struct Entry {
+        uint64_t fingerprint;        // Last assignment pushed to NetBox
+        int64_t pushed_expires_at;   // Lease expiry written with it
+        PrefixKey key;
+        uint8_t flags;
+        int32_t netbox_id;
+        uint32_t id_expires;         // On the table clock, see now()
+        uint32_t pending;            // Dispatch queue slot
+    };
+
+    // Snapshot of the table
+    struct Stats {
+        size_t entries;
+        size_t ids;                  // Entries with HAS_ID
+        size_t pushes;               // Entries with HAS_PUSH
+        size_t slots;                // Allocated slots, used or not
+        size_t memory_bytes;
+        uint64_t evictions;
+    };
+
+    explicit PrefixTable(size_t max_entries);
+
+    PrefixTable(const PrefixTable&) = delete;
+    PrefixTable& operator=(const PrefixTable&) = delete;
+
+    // Run fn(Entry&) on the entry for key under its shard lock, creating a
+    // zeroed entry first if there is none. An entry fn leaves without flags
+    // is removed. False if the table is full and nothing could be evicted.
+    template <typename Fn>
+    bool update(const PrefixKey& key, Fn fn);
+
+    // As update(), but only for an existing entry; false if there is none
+    template <typename Fn>
+    bool modify(const PrefixKey& key, Fn fn);
+
+    // Seconds since the table was created, for expiries that need no wall clock
+    uint32_t now() const;
+
+    Stats getStats() const;
+
+private:
+    static const size_t kShards = 64;
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> slots;    // Power-of-two size
+        size_t size{0};
+    };
+
+    static uint64_t hash(const PrefixKey& key);
+
+    Shard& shardFor(uint64_t h) { return shards_[h >> 58]; }
+    Entry* find(Shard& shard, const PrefixKey& key, uint64_t h);
+    Entry* insert(Shard& shard, const PrefixKey& key, uint64_t h);
+    void erase(Shard& shard, Entry* entry);
+    void finish(Shard& shard, Entry* entry, uint8_t old_flags);
+    bool evict(Shard& shard, uint64_t h);
+    void grow(Shard& shard);
+
+    const size_t shard_limit_;
+    const std::chrono::steady_clock::time_point epoch_;
+    std::unique_ptr<Shard[]> shards_;
+
+    std::atomic<size_t> entries_{0};
+    std::atomic<size_t> ids_{0};
+    std::atomic<size_t> pushes_{0};
+    std::atomic<size_t> slots_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+template <typename Fn>
+bool
+PrefixTable::update(const PrefixKey& key, Fn fn) {
+    uint64_t h = hash(key);
+    Shard& shard = shardFor(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry* entry = find(shard, key, h);
+    if (!entry) {
+        entry = insert(shard, key, h);
+        if (!entry) {
+            return false;
+        }
+    }
+    uint8_t old_flags = entry->flags;
+    fn(*entry);
+    finish(shard, entry, old_flags);
+    return true;
+}
+
+template <typename Fn>
+bool
+PrefixTable::modify(const PrefixKey& key, Fn fn) {
+    uint64_t h = hash(key);
+    Shard& shard = shardFor(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry* entry = find(shard, key, h);
+    if (!entry) {
+        return false;
+    }
+    uint8_t old_flags = entry->flags;
+    fn(*entry);
+    finish(shard, entry, old_flags);
+    return true;
+}
+
+#endif // PREFIX_TABLE_H
@@ -0,0 +1,83 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate > 0.0 ? rate : 1.0), burst_(burst >= 1.0 ? burst : 1.0), tokens_(burst_),
+      updated_(Clock::now()) {
+}
+
+void
+TokenBucket::refill(Clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - updated_;
+    tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+    updated_ = now;
+}
+
+TokenBucket::Admission
+TokenBucket::acquire(bool low_priority, std::chrono::milliseconds max_wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Clock::time_point deadline = Clock::now() + max_wait;
+    bool waited = false;
+    if (!low_priority) {
+        ++high_waiting_;
+    }
+
+    for (;;) {
+        if (closed_) {
+            if (!low_priority) {
+                --high_waiting_;
+            }
+            return Admission::CLOSED;
+        }
+
+        Clock::time_point now = Clock::now();
+        refill(now);
+        if (tokens_ >= 1.0 && (!low_priority || high_waiting_ == 0)) {
+            tokens_ -= 1.0;
+            ++granted_;
+            if (waited) {
+                ++delayed_;
+            }
+            // Low-priority waiters held back by this caller may go next.
+            if (!low_priority && --high_waiting_ == 0) {
+                cv_.notify_all();
+            }
+            return Admission::GRANTED;
+        }
+
+        if (low_priority && now >= deadline) {
+            ++shed_;
+            return Admission::SHED;
+        }
+
+        // Sleep until the next token is due; a token taken meanwhile just means another round.
+        // A low-priority caller held back by a high-priority one waits for its notification.
+        waited = true;
+        if (tokens_ >= 1.0) {
+            cv_.wait_until(lock, deadline);
+            continue;
+        }
+        auto missing = std::chrono::duration<double>((1.0 - tokens_) / rate_);
+        Clock::time_point wake = now + std::chrono::duration_cast<Clock::duration>(missing);
+        if (low_priority) {
+            wake = std::min(wake, deadline);
+        }
+        cv_.wait_until(lock, wake);
+    }
+}
+
+void
+TokenBucket::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+TokenBucket::Stats
+TokenBucket::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{granted_, delayed_, shed_};
+}
@@ -0,0 +1,62 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Token bucket pacing the events sent to one endpoint.
+//
+// Tokens accrue at the configured rate up to the burst size; every event
+// takes one. High-priority callers wait as long as it takes. Low-priority
+// callers only get a token while no high-priority caller is waiting, and give
+// up after max_wait, so under sustained overload renewals are shed while new
+// assignments and expirations keep the budget.
+class TokenBucket {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Admission {
+        GRANTED,
+        SHED,                        // Low priority, no token within max_wait
+        CLOSED
+    };
+
+    // Snapshot of the bucket counters
+    struct Stats {
+        uint64_t granted;
+        uint64_t delayed;            // Granted after waiting for a token
+        uint64_t shed;
+    };
+
+    // rate in tokens per second; a burst below 1 is raised to 1
+    TokenBucket(double rate, double burst);
+
+    // Take a token; max_wait only applies to low-priority callers
+    Admission acquire(bool low_priority, std::chrono::milliseconds max_wait);
+
+    // Wake all waiters and refuse further tokens
+    void close();
+
+    Stats getStats() const;
+
+private:
+    void refill(Clock::time_point now);
+
+    const double rate_;
+    const double burst_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    double tokens_;
+    Clock::time_point updated_;
+    unsigned high_waiting_{0};
+    bool closed_{false};
+
+    uint64_t granted_{0};
+    uint64_t delayed_{0};
+    uint64_t shed_{0};
+};
+
+#endif // RATE_LIMITER_H
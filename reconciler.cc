@@ -0,0 +1,310 @@
+#include <asiolink/io_address.h>
+#include <dhcpsrv/lease.h>
+#include <dhcpsrv/lease_mgr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
+
+#include "reconciler.h"
+
+#include "pd_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <exception>
+#include <utility>
+
+using namespace isc::asiolink;
+using namespace isc::dhcp;
+
+// Drift always tolerated on top of the configured fraction, in seconds
+static const long long kLeasetimeSlack = 60;
+
+// Largest bulk request sent per step
+static const size_t kMaxChunk = 100;
+
+Reconciler::Reconciler(const Config& config, INetBoxClient& netbox, WriteCallback on_write)
+    : config_(config), netbox_(netbox), on_write_(std::move(on_write)) {
+}
+
+Reconciler::~Reconciler() {
+    stop();
+}
+
+void
+Reconciler::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    stop_.store(false);
+    thread_ = std::thread([this] { run(); });
+}
+
+void
+Reconciler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_.store(true);
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+Reconciler::Stats
+Reconciler::getStats() const {
+    Stats stats;
+    stats.runs = runs_.load(std::memory_order_relaxed);
+    stats.failed_runs = failed_runs_.load(std::memory_order_relaxed);
+    stats.created = created_.load(std::memory_order_relaxed);
+    stats.updated = updated_.load(std::memory_order_relaxed);
+    stats.deprecated = deprecated_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.superseded = superseded_.load(std::memory_order_relaxed);
+    stats.last_leases = last_leases_.load(std::memory_order_relaxed);
+    stats.last_prefixes = last_prefixes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Wait for duration or until stop(); false once stopping
+bool
+Reconciler::sleepFor(std::chrono::steady_clock::duration duration) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, duration, [this] { return stop_.load(); });
+}
+
+void
+Reconciler::run() {
+    while (sleepFor(config_.interval)) {
+        ++runs_;
+        bool ok = false;
+        try {
+            ok = reconcile();
+        } catch (const std::exception& e) {
+            PD_LOG_ERROR("PD_WEBHOOK: Reconciliation failed: " << e.what());
+        }
+        if (!ok && !stop_.load()) {
+            ++failed_runs_;
+        }
+    }
+}
+
+// NetBox is listed before the leases: a prefix assigned in between is then
+// only missing from the NetBox side and gets created, never deprecated.
+bool
+Reconciler::loadPrefixes(std::vector<PrefixEntry>& prefixes) {
+    std::vector<NetBoxResponse::Item> items;
+    if (!netbox_.listPrefixes(config_.netbox_filter, config_.netbox_page_size, stop_, items)) {
+        return false;
+    }
+
+    prefixes.reserve(items.size());
+    for (NetBoxResponse::Item& item : items) {
+        PrefixEntry entry;
+        if (item.id <= 0 || !PrefixKey::fromCidr(item.prefix, entry.key)) {
+            continue;
+        }
+        entry.item = std::move(item);
+        prefixes.push_back(std::move(entry));
+    }
+    return true;
+}
+
+// Page through all IPv6 leases by address and keep the active PD leases.
+// Kea has no PD-only paged query, so other lease types are skipped here.
+bool
+Reconciler::loadLeases(std::vector<LeaseEntry>& leases) {
+    if (!LeaseMgrFactory::haveInstance()) {
+        PD_LOG_WARN("PD_WEBHOOK: Reconciliation skipped, no lease database");
+        return false;
+    }
+
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    IOAddress lower_bound = IOAddress::IPV6_ZERO_ADDRESS();
+    time_t now = time(nullptr);
+    for (;;) {
+        if (stop_.load()) {
+            return false;
+        }
+
+        Lease6Collection page = lease_mgr.getLeases6(lower_bound, LeasePageSize(config_.lease_page_size));
+        for (const Lease6Ptr& lease : page) {
+            if (!lease || lease->type_ != Lease::TYPE_PD || lease->state_ != Lease::STATE_DEFAULT) {
+                continue;
+            }
+            time_t expires_at = lease->cltt_ + lease->valid_lft_;
+            if (expires_at <= now) {
+                continue;
+            }
+
+            std::vector<uint8_t> bytes = lease->addr_.toBytes();
+            if (bytes.size() != 16) {
+                continue;
+            }
+            LeaseEntry entry;
+            std::memcpy(entry.data.prefix.addr, bytes.data(), 16);
+            entry.data.prefix.length = lease->prefixlen_;
+            if (config_.lease_filter && !config_.lease_filter(entry.data.prefix, lease->subnet_id_)) {
+                continue;
+            }
+            if (lease->duid_) {
+                const std::vector<uint8_t>& duid = lease->duid_->getDuid();
+                entry.data.client_duid.assign(duid.data(), duid.size());
+            }
+            entry.data.iaid = lease->iaid_;
+            entry.expires_at = expires_at;
+            entry.valid_lft = lease->valid_lft_;
+            leases.push_back(std::move(entry));
+        }
+
+        if (page.size() < config_.lease_page_size) {
+            return true;
+        }
+        lower_bound = page.back()->addr_;
+    }
+}
+
+bool
+Reconciler::needsUpdate(const LeaseEntry& lease, const NetBoxResponse::Item& item) const {
+    Duid duid;
+    if (item.status != "active" || !Duid::fromHex(item.client_duid, duid) || !(duid == lease.data.client_duid)) {
+        return true;
+    }
+    long long allowed = static_cast<long long>(config_.leasetime_tolerance * lease.valid_lft) + kLeasetimeSlack;
+    return std::llabs(item.leasetime - static_cast<long long>(lease.expires_at)) > allowed;
+}
+
+// Whether a write planned from the listings still holds: no event for its
+// prefix is on its way, and the lease database still has the lease it was
+// planned from or, for a deprecation, no active lease for the prefix
+bool
+Reconciler::stillCurrent(const INetBoxClient::PrefixWrite& write, time_t now) const {
+    if (config_.in_flight && config_.in_flight(write.data.prefix)) {
+        return false;
+    }
+    if (!LeaseMgrFactory::haveInstance()) {
+        return false;
+    }
+    Lease6Ptr lease = LeaseMgrFactory::instance().getLease6(Lease::TYPE_PD,
+                                                             IOAddress::fromBytes(AF_INET6, write.data.prefix.addr));
+    bool active = lease && lease->state_ == Lease::STATE_DEFAULT && lease->prefixlen_ == write.data.prefix.length &&
+                  static_cast<time_t>(lease->cltt_ + lease->valid_lft_) > now &&
+                  (!config_.lease_filter || config_.lease_filter(write.data.prefix, lease->subnet_id_));
+    if (write.op == NetBoxOp::DEPRECATE) {
+        return !active;
+    }
+    return active && static_cast<time_t>(lease->cltt_ + lease->valid_lft_) == write.expires_at;
+}
+
+// Send the writes in bulk chunks, pacing them to max_writes_per_sec
+void
+Reconciler::send(std::vector<INetBoxClient::PrefixWrite>& writes) {
+    size_t rate = config_.max_writes_per_sec;
+    size_t chunk = rate > 0 ? std::min(rate, kMaxChunk) : kMaxChunk;
+    std::chrono::steady_clock::duration pace = rate > 0 ?
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(
+            static_cast<double>(chunk) / static_cast<double>(rate))) :
+        std::chrono::steady_clock::duration::zero();
+
+    for (size_t begin = 0; begin < writes.size(); begin += chunk) {
+        auto started = std::chrono::steady_clock::now();
+        size_t end = std::min(begin + chunk, writes.size());
+        std::vector<INetBoxClient::PrefixWrite> part(std::make_move_iterator(writes.begin() + begin),
+                                                     std::make_move_iterator(writes.begin() + end));
+        time_t now = time(nullptr);
+        size_t planned = part.size();
+        part.erase(std::remove_if(part.begin(), part.end(),
+                                  [this, now](const INetBoxClient::PrefixWrite& write) {
+                                      return !stillCurrent(write, now);
+                                  }),
+                   part.end());
+        superseded_ += planned - part.size();
+        size_t accepted = part.empty() ? 0 : netbox_.applyWrites(part);
+        rejected_ += part.size() - accepted;
+        for (const INetBoxClient::PrefixWrite& write : part) {
+            switch (write.op) {
+            case NetBoxOp::CREATE:
+                ++created_;
+                break;
+            case NetBoxOp::UPDATE:
+                ++updated_;
+                break;
+            default:
+                ++deprecated_;
+                break;
+            }
+            if (on_write_) {
+                on_write_(write.data);
+            }
+        }
+
+        if (end < writes.size() && !sleepFor(pace - (std::chrono::steady_clock::now() - started))) {
+            return;
+        }
+    }
+}
+
+// One pass: list both sides, merge-join them by prefix and write the differences
+bool
+Reconciler::reconcile() {
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<PrefixEntry> prefixes;
+    if (!loadPrefixes(prefixes)) {
+        return false;
+    }
+    std::vector<LeaseEntry> leases;
+    if (!loadLeases(leases)) {
+        return false;
+    }
+    last_prefixes_.store(prefixes.size(), std::memory_order_relaxed);
+    last_leases_.store(leases.size(), std::memory_order_relaxed);
+
+    std::sort(prefixes.begin(), prefixes.end(),
+              [](const PrefixEntry& a, const PrefixEntry& b) { return a.key < b.key; });
+    std::sort(leases.begin(), leases.end(),
+              [](const LeaseEntry& a, const LeaseEntry& b) { return a.data.prefix < b.data.prefix; });
+
+    std::vector<INetBoxClient::PrefixWrite> writes;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < leases.size() || j < prefixes.size()) {
+        if (j == prefixes.size() || (i < leases.size() && leases[i].data.prefix < prefixes[j].key)) {
+            writes.push_back(INetBoxClient::PrefixWrite{NetBoxOp::CREATE, -1, leases[i].data, leases[i].expires_at});
+            ++i;
+            continue;
+        }
+
+        if (i == leases.size() || prefixes[j].key < leases[i].data.prefix) {
+            const NetBoxResponse::Item& item = prefixes[j].item;
+            if (item.status == "active") {
+                INetBoxClient::PrefixWrite write{NetBoxOp::DEPRECATE, item.id, PdAssignmentData{}, 0};
+                write.data.prefix = prefixes[j].key;
+                writes.push_back(std::move(write));
+            }
+            ++j;
+            continue;
+        }
+
+        if (needsUpdate(leases[i], prefixes[j].item)) {
+            writes.push_back(INetBoxClient::PrefixWrite{NetBoxOp::UPDATE, prefixes[j].item.id, leases[i].data,
+                                                        leases[i].expires_at});
+        }
+        // Duplicate NetBox entries for the same prefix are left alone
+        const PrefixKey& matched = leases[i].data.prefix;
+        ++i;
+        while (j < prefixes.size() && prefixes[j].key == matched) {
+            ++j;
+        }
+    }
+
+    uint64_t rejected = rejected_.load();
+    uint64_t superseded = superseded_.load();
+    send(writes);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    PD_LOG_INFO("PD_WEBHOOK: Reconciled " << leases.size() << " leases with " << prefixes.size()
+                << " NetBox prefixes in " << elapsed.count() << " ms: " << writes.size() << " writes, "
+                << (superseded_.load() - superseded) << " superseded, "
+                << (rejected_.load() - rejected) << " rejected");
+    return !stop_.load();
+}
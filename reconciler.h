@@ -0,0 +1,122 @@
+#ifndef RECONCILER_H
+#define RECONCILER_H
+
+#include "netbox_client.h"
+#include "netbox_response.h"
+#include "pd_types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Periodic repair of NetBox from Kea's lease database.
+//
+// Events lost to timeouts, full queues or restarts leave NetBox behind the
+// leases Kea holds. Every interval, on its own thread, the reconciler pages
+// through the hook-managed prefixes in NetBox and then through the PD leases
+// in the lease database, sorts both by prefix and merge-joins them. Only what
+// differs is written, as bulk requests of at most max_writes_per_sec prefixes
+// per second:
+//   - an active lease without a NetBox prefix is created
+//   - an active lease whose prefix is not active, names another DUID or has a
+//     lease time off by more than the tolerance is updated
+//   - an active NetBox prefix without an active lease is deprecated
+// Before each bulk request its writes are checked again: one for a prefix with
+// an event on its way, or whose lease changed since the pass listed it, is
+// dropped, as that event carries the newer state.
+class Reconciler {
+public:
+    struct Config {
+        std::chrono::seconds interval{3600};
+        size_t lease_page_size{1000};
+        size_t netbox_page_size{1000};
+        std::string netbox_filter;       // Selects the prefixes the hook manages
+        size_t max_writes_per_sec{100};  // 0 = unlimited
+        double leasetime_tolerance{0.0}; // Allowed lease time drift, as a fraction of valid_lft
+        // Selects the leases this NetBox holds, by prefix and subnet ID; unset for all
+        std::function<bool(const PrefixKey&, uint32_t)> lease_filter;
+        // Whether an event for a prefix is queued, being delivered or held in
+        // the expiry sweep; unset for none
+        std::function<bool(const PrefixKey&)> in_flight;
+    };
+
+    // Called for every prefix a pass wrote, so delivery state can be dropped
+    typedef std::function<void(const PdAssignmentData&)> WriteCallback;
+
+    // Snapshot of the reconciler counters
+    struct Stats {
+        uint64_t runs;
+        uint64_t failed_runs;        // Passes abandoned on a listing error
+        uint64_t created;            // Writes sent, by kind
+        uint64_t updated;
+        uint64_t deprecated;
+        uint64_t rejected;           // Writes NetBox did not accept
+        uint64_t superseded;         // Writes dropped before sending for a newer event
+        size_t last_leases;          // Sizes of the two sides in the last pass
+        size_t last_prefixes;
+    };
+
+    Reconciler(const Config& config, INetBoxClient& netbox, WriteCallback on_write);
+    ~Reconciler();
+
+    Reconciler(const Reconciler&) = delete;
+    Reconciler& operator=(const Reconciler&) = delete;
+
+    // Start the reconciler thread; the first pass runs one interval from now
+    void start();
+
+    // Stop the thread, abandoning a pass in progress
+    void stop();
+
+    Stats getStats() const;
+
+private:
+    struct LeaseEntry {
+        PdAssignmentData data;       // data.prefix is the join key
+        time_t expires_at;
+        uint32_t valid_lft;
+    };
+
+    struct PrefixEntry {
+        PrefixKey key;
+        NetBoxResponse::Item item;
+    };
+
+    void run();
+    bool reconcile();
+    bool loadPrefixes(std::vector<PrefixEntry>& prefixes);
+    bool loadLeases(std::vector<LeaseEntry>& leases);
+    bool needsUpdate(const LeaseEntry& lease, const NetBoxResponse::Item& item) const;
+    bool stillCurrent(const INetBoxClient::PrefixWrite& write, time_t now) const;
+    void send(std::vector<INetBoxClient::PrefixWrite>& writes);
+    bool sleepFor(std::chrono::steady_clock::duration duration);
+
+    const Config config_;
+    INetBoxClient& netbox_;
+    const WriteCallback on_write_;
+
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::mutex mutex_;               // Guards the wake-up wait
+    std::condition_variable cv_;
+
+    std::atomic<uint64_t> runs_{0};
+    std::atomic<uint64_t> failed_runs_{0};
+    std::atomic<uint64_t> created_{0};
+    std::atomic<uint64_t> updated_{0};
+    std::atomic<uint64_t> deprecated_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> superseded_{0};
+    std::atomic<size_t> last_leases_{0};
+    std::atomic<size_t> last_prefixes_{0};
+};
+
+#endif // RECONCILER_H
@@ -0,0 +1,63 @@
+#include "renewal_filter.h"
+
+#include <cstdlib>
+#include <functional>
+#include <string_view>
+
+RenewalFilter::RenewalFilter(double drift_fraction, PrefixTable& table)
+    : drift_fraction_(drift_fraction), table_(table) {
+}
+
+uint64_t
+RenewalFilter::fingerprint(const PdAssignmentData& data) {
+    std::hash<std::string_view> hasher;
+    auto bytes = [&hasher](const uint8_t* p, size_t len) {
+        return hasher(std::string_view(reinterpret_cast<const char*>(p), len));
+    };
+    auto address = [&bytes](const Ip6Address& addr) { return addr.present ? bytes(addr.bytes, 16) : size_t(0); };
+
+    uint64_t h = bytes(data.client_duid.bytes, data.client_duid.length);
+    auto mix = [&h](uint64_t v) { h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+    mix(data.iaid);
+    mix(address(data.cpe_link_local));
+    mix(address(data.router_ip));
+    mix(address(data.router_link_addr));
+    return h;
+}
+
+bool
+RenewalFilter::suppress(const PdAssignmentData& data, time_t expires_at, uint32_t valid_lft) {
+    bool suppressed = false;
+    uint64_t fp = fingerprint(data);
+    double allowed = drift_fraction_ * static_cast<double>(valid_lft);
+    table_.modify(data.prefix, [&suppressed, fp, expires_at, allowed](PrefixTable::Entry& entry) {
+        suppressed = (entry.flags & PrefixTable::HAS_PUSH) && entry.fingerprint == fp &&
+            std::llabs(static_cast<long long>(expires_at - entry.pushed_expires_at)) <= allowed;
+    });
+
+    (suppressed ? suppressed_ : passed_).fetch_add(1, std::memory_order_relaxed);
+    return suppressed;
+}
+
+void
+RenewalFilter::record(const PdAssignmentData& data, time_t expires_at) {
+    uint64_t fp = fingerprint(data);
+    table_.update(data.prefix, [fp, expires_at](PrefixTable::Entry& entry) {
+        entry.flags |= PrefixTable::HAS_PUSH;
+        entry.fingerprint = fp;
+        entry.pushed_expires_at = expires_at;
+    });
+}
+
+void
+RenewalFilter::forget(const PrefixKey& prefix) {
+    table_.modify(prefix, [](PrefixTable::Entry& entry) {
+        entry.flags &= ~PrefixTable::HAS_PUSH;
+    });
+}
+
+RenewalFilter::Stats
+RenewalFilter::getStats() const {
+    return Stats{suppressed_.load(std::memory_order_relaxed), passed_.load(std::memory_order_relaxed),
+                 table_.getStats().pushes};
+}
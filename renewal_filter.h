@@ -0,0 +1,51 @@
+#ifndef RENEWAL_FILTER_H
+#define RENEWAL_FILTER_H
+
+#include "pd_types.h"
+#include "prefix_table.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Change detection for prefix updates sent to NetBox.
+//
+// Remembers a fingerprint of the last assignment pushed for each prefix and the
+// expiry written with it, in the shared PrefixTable. A renewal that carries
+// the same DUID, IAID and relay fields is suppressed unless its expiry moved
+// by more than a fraction of the valid lifetime from the one NetBox already
+// has. The fingerprint is taken over the raw bytes of those fields.
+class RenewalFilter {
+public:
+    // Snapshot of the filter counters
+    struct Stats {
+        uint64_t suppressed;
+        uint64_t passed;
+        size_t size;
+    };
+
+    RenewalFilter(double drift_fraction, PrefixTable& table);
+
+    // True if the update can be skipped
+    bool suppress(const PdAssignmentData& data, time_t expires_at, uint32_t valid_lft);
+
+    // Record a successful push
+    void record(const PdAssignmentData& data, time_t expires_at);
+
+    // Forget a prefix so the next update is always sent
+    void forget(const PrefixKey& prefix);
+
+    Stats getStats() const;
+
+private:
+    static uint64_t fingerprint(const PdAssignmentData& data);
+
+    const double drift_fraction_;
+    PrefixTable& table_;
+
+    std::atomic<uint64_t> suppressed_{0};
+    std::atomic<uint64_t> passed_{0};
+};
+
+#endif // RENEWAL_FILTER_H
@@ -0,0 +1,131 @@
+#include "retry_policy.h"
+
+#include <random>
+#include <utility>
+
+RetryPolicy::RetryPolicy(unsigned max_attempts, std::chrono::milliseconds base, std::chrono::milliseconds cap,
+                         double jitter)
+    : max_attempts_(max_attempts > 0 ? max_attempts : 1), base_(base), cap_(cap < base ? base : cap),
+      jitter_(jitter < 0.0 ? 0.0 : (jitter > 1.0 ? 1.0 : jitter)) {
+}
+
+bool
+RetryPolicy::shouldRetry(unsigned attempts) const {
+    return attempts < max_attempts_;
+}
+
+std::chrono::milliseconds
+RetryPolicy::backoff(unsigned attempts) const {
+    long long wait = base_.count();
+    for (unsigned i = 1; i < attempts && wait < cap_.count(); ++i) {
+        wait *= 2;
+    }
+    if (wait > cap_.count()) {
+        wait = cap_.count();
+    }
+
+    if (jitter_ > 0.0 && wait > 0) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        std::uniform_real_distribution<double> dist(0.0, jitter_);
+        wait -= static_cast<long long>(dist(rng) * static_cast<double>(wait));
+    }
+    return std::chrono::milliseconds(wait);
+}
+
+RetryPolicy::Stats
+RetryPolicy::getStats() const {
+    Stats stats;
+    stats.retries = retries_.load(std::memory_order_relaxed);
+    stats.recovered = recovered_.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+RetryScheduler::RetryScheduler() {
+}
+
+RetryScheduler::~RetryScheduler() {
+    stop();
+}
+
+void
+RetryScheduler::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+        stopping_ = false;
+        thread_ = std::thread(&RetryScheduler::run, this);
+    }
+}
+
+void
+RetryScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // Cancelled tasks may schedule again; those are cancelled right away.
+    for (;;) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (entries_.empty()) {
+                break;
+            }
+            task = std::move(const_cast<Entry&>(entries_.top()).task);
+            entries_.pop();
+        }
+        task(false);
+    }
+}
+
+void
+RetryScheduler::schedule(std::chrono::milliseconds delay, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            entries_.push(Entry{Clock::now() + delay, next_seq_++, std::move(task)});
+            task = nullptr;
+        }
+    }
+    if (task) {
+        task(false);
+        return;
+    }
+    cv_.notify_one();
+}
+
+// Timer thread body: wait for the earliest task and run it outside the lock
+void
+RetryScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (stopping_) {
+            return;
+        }
+        if (entries_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+
+        Clock::time_point due = entries_.top().due;
+        if (Clock::now() < due) {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+
+        Task task = std::move(const_cast<Entry&>(entries_.top()).task);
+        entries_.pop();
+        lock.unlock();
+        try {
+            task(true);
+        } catch (...) {
+            // A failing retry must not take the timer thread down.
+        }
+        lock.lock();
+    }
+}
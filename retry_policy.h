@@ -0,0 +1,98 @@
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// How many times a failed request is attempted and how long to wait in between.
+//
+// The wait before attempt n+1 is base * 2^(n-1), capped, and then shortened by
+// a random amount of up to jitter * wait so that clients that failed together
+// do not retry together.
+class RetryPolicy {
+public:
+    // Snapshot of the retry counters
+    struct Stats {
+        uint64_t retries;            // Attempts scheduled after a failure
+        uint64_t recovered;          // Requests that succeeded on a retry
+        uint64_t exhausted;          // Requests that failed every attempt
+    };
+
+    RetryPolicy(unsigned max_attempts, std::chrono::milliseconds base, std::chrono::milliseconds cap,
+                double jitter);
+
+    // True if another attempt may follow the given number of attempts made
+    bool shouldRetry(unsigned attempts) const;
+
+    // Wait before the attempt following the given number of attempts made
+    std::chrono::milliseconds backoff(unsigned attempts) const;
+
+    void recordRetry() { retries_.fetch_add(1, std::memory_order_relaxed); }
+    void recordRecovered() { recovered_.fetch_add(1, std::memory_order_relaxed); }
+    void recordExhausted() { exhausted_.fetch_add(1, std::memory_order_relaxed); }
+
+    Stats getStats() const;
+
+private:
+    const unsigned max_attempts_;
+    const std::chrono::milliseconds base_;
+    const std::chrono::milliseconds cap_;
+    const double jitter_;
+
+    std::atomic<uint64_t> retries_{0};
+    std::atomic<uint64_t> recovered_{0};
+    std::atomic<uint64_t> exhausted_{0};
+};
+
+// Runs delayed retries on a single timer thread.
+//
+// A task receives true when it is due, or false if the scheduler is stopped
+// first, so every scheduled task is called exactly once.
+class RetryScheduler {
+public:
+    typedef std::function<void(bool)> Task;
+
+    RetryScheduler();
+    ~RetryScheduler();
+
+    RetryScheduler(const RetryScheduler&) = delete;
+    RetryScheduler& operator=(const RetryScheduler&) = delete;
+
+    void start();
+
+    // Stop the thread and cancel the tasks still waiting
+    void stop();
+
+    void schedule(std::chrono::milliseconds delay, Task task);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        Clock::time_point due;
+        uint64_t seq;                // Keeps tasks with the same due time in order
+        Task task;
+
+        bool operator>(const Entry& other) const {
+            return due != other.due ? due > other.due : seq > other.seq;
+        }
+    };
+
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> entries_;
+    uint64_t next_seq_{0};
+    std::thread thread_;
+    bool stopping_{false};
+};
+
+#endif // RETRY_POLICY_H
@@ -0,0 +1,35 @@
+#ifndef TRACE_CONTEXT_H
+#define TRACE_CONTEXT_H
+
+#include <cstdint>
+
+// Trace an event belongs to, carried by value with the event and its requests.
+// All zero for events that were not sampled, which is what nearly every event is.
+struct TraceContext {
+    uint64_t trace_hi{0};            // 128-bit trace ID
+    uint64_t trace_lo{0};
+    uint64_t span_id{0};             // Parent of the spans recorded under this context
+    uint64_t start_ns{0};            // Unix time the root span started
+    uint64_t queued_ns{0};           // Unix time the event entered the queue
+
+    bool sampled() const { return (trace_hi | trace_lo) != 0; }
+};
+
+// Trace of the work running on this thread; requests submitted while it is
+// set are traced with it
+extern thread_local TraceContext t_trace;
+
+// Makes a trace current for the lifetime of the scope
+class TraceScope {
+public:
+    explicit TraceScope(const TraceContext& trace) : saved_(t_trace) { t_trace = trace; }
+    ~TraceScope() { t_trace = saved_; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceContext saved_;
+};
+
+#endif // TRACE_CONTEXT_H
@@ -0,0 +1,272 @@
+#include "tracer.h"
+
+#include "json_writer.h"
+
+#include <chrono>
+#include <limits>
+#include <random>
+#include <utility>
+
+thread_local TraceContext t_trace;
+
+namespace {
+
+// xorshift64*, seeded once per thread; good enough for sampling and IDs
+uint64_t
+nextRandom() {
+    static thread_local uint64_t state = 0;
+    if (state == 0) {
+        std::random_device device;
+        state = (static_cast<uint64_t>(device()) << 32) ^ device() ^
+                reinterpret_cast<uintptr_t>(&state);
+        if (state == 0) {
+            state = 0x9e3779b97f4a7c15ULL;
+        }
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+uint64_t
+nonZeroRandom() {
+    uint64_t value;
+    do {
+        value = nextRandom();
+    } while (value == 0);
+    return value;
+}
+
+uint64_t
+sampleThreshold(double rate) {
+    if (rate >= 1.0) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    if (rate <= 0.0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(rate * 18446744073709551616.0);
+}
+
+void
+appendId(JsonWriter& writer, uint64_t value) {
+    static const char hex[] = "0123456789abcdef";
+    char text[16];
+    for (int i = 15; i >= 0; --i) {
+        text[i] = hex[value & 0x0f];
+        value >>= 4;
+    }
+    writer.appendPlain(text, sizeof(text));
+}
+
+// OTLP/JSON carries 64-bit integers as strings
+void
+writeUint64(JsonWriter& writer, uint64_t value) {
+    writer.beginString();
+    writer.appendString(value);
+    writer.endString();
+}
+
+void
+writeSpan(JsonWriter& writer, const Span& span) {
+    writer.beginObject();
+    writer.key("traceId");
+    writer.beginString();
+    appendId(writer, span.trace_hi);
+    appendId(writer, span.trace_lo);
+    writer.endString();
+    writer.key("spanId");
+    writer.beginString();
+    appendId(writer, span.span_id);
+    writer.endString();
+    if (span.parent_id != 0) {
+        writer.key("parentSpanId");
+        writer.beginString();
+        appendId(writer, span.parent_id);
+        writer.endString();
+    }
+    writer.key("name");
+    writer.value(span.name);
+    writer.key("kind");
+    writer.value(span.client ? 3 : 1);
+    writer.key("startTimeUnixNano");
+    writeUint64(writer, span.start_ns);
+    writer.key("endTimeUnixNano");
+    writeUint64(writer, span.end_ns);
+
+    if (!span.attributes.empty()) {
+        writer.key("attributes");
+        writer.beginArray();
+        for (const SpanAttribute& attribute : span.attributes) {
+            writer.beginObject();
+            writer.key("key");
+            writer.value(attribute.key);
+            writer.key("value");
+            writer.beginObject();
+            if (attribute.is_int) {
+                writer.key("intValue");
+                writer.beginString();
+                writer.appendString(attribute.int_value);
+                writer.endString();
+            } else {
+                writer.key("stringValue");
+                writer.value(attribute.string_value);
+            }
+            writer.endObject();
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+
+    if (span.error) {
+        writer.key("status");
+        writer.beginObject();
+        writer.key("code");
+        writer.value(2);
+        writer.endObject();
+    }
+    writer.endObject();
+}
+
+} // namespace
+
+std::string
+buildOtlpTraces(const std::vector<Span>& spans, const std::string& service_name) {
+    std::string body;
+    body.reserve(128 + spans.size() * 256);
+    JsonWriter writer(body);
+    writer.beginObject();
+    writer.key("resourceSpans");
+    writer.beginArray();
+    writer.beginObject();
+
+    writer.key("resource");
+    writer.beginObject();
+    writer.key("attributes");
+    writer.beginArray();
+    writer.beginObject();
+    writer.key("key");
+    writer.value("service.name");
+    writer.key("value");
+    writer.beginObject();
+    writer.key("stringValue");
+    writer.value(service_name);
+    writer.endObject();
+    writer.endObject();
+    writer.endArray();
+    writer.endObject();
+
+    writer.key("scopeSpans");
+    writer.beginArray();
+    writer.beginObject();
+    writer.key("scope");
+    writer.beginObject();
+    writer.key("name");
+    writer.value("pd_webhook");
+    writer.endObject();
+    writer.key("spans");
+    writer.beginArray();
+    for (const Span& span : spans) {
+        writeSpan(writer, span);
+    }
+    writer.endArray();
+    writer.endObject();
+    writer.endArray();
+
+    writer.endObject();
+    writer.endArray();
+    writer.endObject();
+    return body;
+}
+
+Tracer::Tracer(const Config& config, Exporter exporter)
+    : config_(config), threshold_(sampleThreshold(config.sample_rate)), exporter_(std::move(exporter)) {
+    batcher_.reset(new Batcher<Span>(config_.batch_max_items, std::chrono::milliseconds(config_.batch_max_delay_ms),
+                                     [this](std::vector<Span>&& batch) {
+        exportBatch(std::move(batch));
+    }));
+    batcher_->start();
+}
+
+Tracer::~Tracer() {
+    stop();
+}
+
+bool
+Tracer::startTrace(TraceContext& trace) {
+    if (threshold_ == 0 || (nextRandom() >= threshold_ && threshold_ != std::numeric_limits<uint64_t>::max())) {
+        return false;
+    }
+    trace.trace_hi = nonZeroRandom();
+    trace.trace_lo = nextRandom();
+    trace.span_id = nonZeroRandom();
+    trace.start_ns = nowNs();
+    trace.queued_ns = 0;
+    traces_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t
+Tracer::newSpanId() {
+    return nonZeroRandom();
+}
+
+uint64_t
+Tracer::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+Span
+Tracer::childSpan(const TraceContext& trace, const char* name, uint64_t start_ns, uint64_t end_ns) {
+    Span span;
+    span.trace_hi = trace.trace_hi;
+    span.trace_lo = trace.trace_lo;
+    span.span_id = newSpanId();
+    span.parent_id = trace.span_id;
+    span.name = name;
+    span.start_ns = start_ns;
+    span.end_ns = end_ns;
+    return span;
+}
+
+void
+Tracer::record(Span&& span) {
+    if (stopped_.load(std::memory_order_relaxed)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (queued_.fetch_add(1, std::memory_order_relaxed) >= config_.max_queued_spans) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    batcher_->add(std::move(span));
+}
+
+void
+Tracer::exportBatch(std::vector<Span>&& batch) {
+    size_t count = batch.size();
+    queued_.fetch_sub(count, std::memory_order_relaxed);
+    exporter_(buildOtlpTraces(batch, config_.service_name), [this, count](bool ok) {
+        (ok ? spans_ : dropped_).fetch_add(count, std::memory_order_relaxed);
+    });
+}
+
+void
+Tracer::stop() {
+    if (!stopped_.exchange(true)) {
+        batcher_->stop();
+    }
+}
+
+Tracer::Stats
+Tracer::getStats() const {
+    Stats stats;
+    stats.traces = traces_.load(std::memory_order_relaxed);
+    stats.spans = spans_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.batches = batcher_->batches();
+    return stats;
+}
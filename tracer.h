@@ -0,0 +1,117 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "batcher.h"
+#include "trace_context.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One attribute of a span: a string, or an integer when is_int is set
+struct SpanAttribute {
+    const char* key;                 // String literal
+    std::string string_value;
+    int64_t int_value;
+    bool is_int;
+};
+
+// A finished span, waiting to be exported
+struct Span {
+    uint64_t trace_hi{0};
+    uint64_t trace_lo{0};
+    uint64_t span_id{0};
+    uint64_t parent_id{0};           // 0 for the root span of a trace
+    const char* name{""};            // String literal
+    bool client{false};              // An outbound request (OTLP kind CLIENT), otherwise INTERNAL
+    bool error{false};
+    uint64_t start_ns{0};            // Unix time
+    uint64_t end_ns{0};
+    std::vector<SpanAttribute> attributes;
+
+    void attribute(const char* key, std::string value) {
+        attributes.push_back(SpanAttribute{key, std::move(value), 0, false});
+    }
+
+    void attribute(const char* key, int64_t value) {
+        attributes.push_back(SpanAttribute{key, std::string(), value, true});
+    }
+};
+
+// Sampled tracing of events through the hook, exported as OTLP/HTTP JSON.
+//
+// The sampling decision is one step of a thread-local random generator, so
+// leaving it on at a low rate costs nothing measurable on events that are
+// not sampled. Spans of sampled events are collected by a batcher and handed
+// to the exporter as one ExportTraceServiceRequest body per batch. Spans are
+// dropped, and counted, when more than max_queued_spans wait for export or
+// once the tracer has stopped; tracing never holds up delivery.
+class Tracer {
+public:
+    struct Config {
+        double sample_rate{0.0};     // Fraction of events traced, in (0, 1]
+        std::string service_name{"kea-pd-webhook"};
+        size_t batch_max_items{512};
+        long batch_max_delay_ms{1000};
+        size_t max_queued_spans{16384};
+    };
+
+    // Snapshot of the tracer counters
+    struct Stats {
+        uint64_t traces;             // Events sampled
+        uint64_t spans;              // Spans accepted by the exporter
+        uint64_t dropped;            // Spans discarded: queue full, stopped or export failed
+        uint64_t batches;            // Export requests
+    };
+
+    // Sends one OTLP body; done tells whether the collector accepted it
+    typedef std::function<void(std::string&&, std::function<void(bool)>)> Exporter;
+
+    Tracer(const Config& config, Exporter exporter);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Sampling decision for a new event. When sampled, fills trace with a new
+    // trace ID and root span ID starting now, and returns true.
+    bool startTrace(TraceContext& trace);
+
+    static uint64_t newSpanId();
+
+    // Current Unix time in nanoseconds
+    static uint64_t nowNs();
+
+    // A span under trace, parented to its current span; fill in the rest and record() it
+    static Span childSpan(const TraceContext& trace, const char* name, uint64_t start_ns, uint64_t end_ns);
+
+    void record(Span&& span);
+
+    // Export what is collected; later spans are dropped
+    void stop();
+
+    Stats getStats() const;
+
+private:
+    void exportBatch(std::vector<Span>&& batch);
+
+    const Config config_;
+    const uint64_t threshold_;       // Sample when a random 64-bit value is below it
+    const Exporter exporter_;
+    std::unique_ptr<Batcher<Span>> batcher_;
+
+    std::atomic<bool> stopped_{false};
+    std::atomic<size_t> queued_{0};
+    std::atomic<uint64_t> traces_{0};
+    std::atomic<uint64_t> spans_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// OTLP/HTTP JSON body (ExportTraceServiceRequest) for a batch of spans
+std::string buildOtlpTraces(const std::vector<Span>& spans, const std::string& service_name);
+
+#endif // TRACER_H
@@ -0,0 +1,90 @@
+#include "work_lane.h"
+
+#include <utility>
+
+WorkLane::WorkLane(size_t capacity, size_t threads) : capacity_(capacity > 0 ? capacity : 1) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkLane::run, this);
+    }
+}
+
+WorkLane::~WorkLane() {
+    stop();
+}
+
+bool
+WorkLane::post(Task&& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || tasks_.size() >= capacity_) {
+            ++rejected_;
+            return false;
+        }
+        tasks_.push_back(std::move(task));
+        ++posted_;
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void
+WorkLane::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        Task task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        try {
+            task(true);
+        } catch (...) {
+            // A failing task must not take the lane thread down.
+        }
+        lock.lock();
+    }
+}
+
+void
+WorkLane::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+
+    std::deque<Task> rest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rest.swap(tasks_);
+        discarded_ += rest.size();
+    }
+    for (Task& task : rest) {
+        try {
+            task(false);
+        } catch (...) {
+        }
+    }
+}
+
+WorkLane::Stats
+WorkLane::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.posted = posted_;
+    stats.rejected = rejected_;
+    stats.discarded = discarded_;
+    stats.depth = tasks_.size();
+    return stats;
+}
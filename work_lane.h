@@ -0,0 +1,63 @@
+#ifndef WORK_LANE_H
+#define WORK_LANE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded queue of work run on the lane's own threads.
+//
+// Gives one NetBox backend somewhere to wait for its rate limit, its
+// in-flight slots and, with the easy engine, its requests, so a slow backend
+// holds up nothing but its own lane. Every task runs exactly once: with true
+// on a lane thread, or with false when the lane stops before it got to it.
+class WorkLane {
+public:
+    typedef std::function<void(bool)> Task;
+
+    // Snapshot of the lane counters
+    struct Stats {
+        uint64_t posted;
+        uint64_t rejected;           // Refused because the lane was full or stopped
+        uint64_t discarded;          // Still queued when the lane stopped
+        size_t depth;
+    };
+
+    WorkLane(size_t capacity, size_t threads);
+    ~WorkLane();
+
+    WorkLane(const WorkLane&) = delete;
+    WorkLane& operator=(const WorkLane&) = delete;
+
+    // Queue a task; false, without running it, if the lane is full or stopped
+    bool post(Task&& task);
+
+    // Join the threads once their current tasks are done, then run what is
+    // still queued with false
+    void stop();
+
+    Stats getStats() const;
+
+private:
+    void run();
+
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    bool stopping_{false};
+    std::vector<std::thread> threads_;
+
+    uint64_t posted_{0};
+    uint64_t rejected_{0};
+    uint64_t discarded_{0};
+};
+
+#endif // WORK_LANE_H